@@ -170,6 +170,8 @@ namespace atlas {
     template<typename U> class Safe_Poly;
     template<typename C> class PolEntry;
     template<typename U> class SafePolEntry;
+    template<typename C> class Packed_Poly;
+    template<typename C> class Packed_Poly_pool;
     using Degree = unsigned int; // exponent range; not stored.
   }
   using polynomials::Polynomial;
@@ -426,11 +428,12 @@ namespace atlas {
   }
   namespace kl {
     struct Poly_hash_export;
+    struct Fill_stats;
     class KL_table;
     using KLCoeff = unsigned int;
     using KLPol = polynomials::Safe_Poly<KLCoeff>;
-    using KLStore = std::vector<KLPol>;
-    using KLPolRef = KLStore::const_reference;
+    using KLStore = polynomials::Packed_Poly_pool<KLCoeff>; // compact storage
+    using KLPolRef = polynomials::Packed_Poly<KLCoeff>; // |KLStore| view
     using KLIndex = unsigned int; // $<2^{32}$ distinct polynomials for $E_8$!
     using MuCoeff = KLCoeff;
   }
@@ -0,0 +1,228 @@
+/*
+  This is klbench.cpp
+
+  A benchmark driver for the computation of Kazhdan-Lusztig-Vogan polynomials
+
+  Part of the Atlas of Lie Groups and Representations
+
+  For license information see the LICENSE file
+*/
+
+/*
+  This program builds a fixed catalogue of blocks, in each case for the
+  quasisplit real form of a simply connected group and the quasisplit form of
+  its dual, and times separately the construction of the two KGB sets, of the
+  block, of the KL tables, and of the W-graph. Each block is handled in a
+  separate (forked) process, so that the reported peak resident size measures
+  that computation alone. Results are written as tab-separated lines, preceded
+  by one header line, so that they are easily compared between builds.
+
+  Usage: klbench [-j threads] [-o file] [name...]
+
+  Without names, the whole catalogue is run (in order of increasing size);
+  otherwise only the named entries. As for the KL computation itself, "-j 0"
+  uses as many threads as the hardware supports. Timings are only meaningful
+  for optimised builds, so do "make optimize=true bench".
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "lietype.h"
+#include "prerootdata.h"
+#include "innerclass.h"
+#include "realredgp.h"
+#include "kgb.h"
+#include "blocks.h"
+#include "kl.h"
+#include "wgraph.h"
+#include "error.h"
+
+namespace atlas {
+
+namespace {
+
+struct bench_entry
+{
+  const char* name; // used to select entries and to label output lines
+  lietype::TypeLetter type; unsigned int rank;
+  lietype::TypeLetter inner; // inner class letter, as in Fokko's "type" command
+};
+
+const bench_entry catalogue[] = {
+  { "F4_split",        'F', 4, 's' },
+  { "SO5_5",           'D', 5, 's' },
+  { "E6_split",        'E', 6, 's' },
+  { "E6_quasisplit",   'E', 6, 'c' }, // E6(2); Fokko's 'u' is 's' for E6
+  { "E7_split",        'E', 7, 's' },
+};
+
+typedef std::chrono::steady_clock clock_type;
+
+double seconds_since (clock_type::time_point& start) // and restart the clock
+{
+  auto now = clock_type::now();
+  double result = std::chrono::duration<double>(now-start).count();
+  start = now;
+  return result;
+}
+
+void print_header (std::ostream& out)
+{
+  out << "block\tsize\tkgb_s\tblock_s\tkl_s\twgraph_s"
+	 "\tpolys\tpol_bytes\tmat_bytes\tmu_entries\tpeak_rss_kb\n";
+}
+
+// do the computation for |e|, and write one result line to |out|
+void run (const bench_entry& e, unsigned int n_threads, std::ostream& out)
+{
+  LieType lt; lt.push_back(lietype::SimpleLieType(e.type,e.rank));
+  lietype::InnerClassType ict; ict.push_back(e.inner);
+
+  InnerClass G(PreRootDatum(lt,false),lietype::involution(lt,ict));
+  InnerClass dG(G,tags::DualTag());
+
+  auto start = clock_type::now();
+  RealReductiveGroup G_R(G,G.quasisplit());
+  RealReductiveGroup dG_R(dG,dG.quasisplit());
+  G_R.kgb(); dG_R.kgb(); // force construction of both KGB sets
+  double kgb_time = seconds_since(start);
+
+  Block block = Block::build(G_R,dG_R);
+  double block_time = seconds_since(start);
+
+  const kl::KL_table& kl_tab = block.kl_tab(nullptr,0,false,n_threads);
+  double kl_time = seconds_since(start);
+
+  wgraph::WGraph wg = kl::wGraph(kl_tab);
+  double wgraph_time = seconds_since(start);
+
+  size_t mu_entries=0;
+  for (BlockElt y=0; y<kl_tab.size(); ++y)
+    mu_entries += kl_tab.mu_column(y).size();
+
+  struct rusage usage;
+  long peak = getrusage(RUSAGE_SELF,&usage)==0 ? usage.ru_maxrss : -1;
+
+  out << e.name << '\t' << block.size() << std::fixed << std::setprecision(3)
+      << '\t' << kgb_time << '\t' << block_time
+      << '\t' << kl_time  << '\t' << wgraph_time
+      << '\t' << kl_tab.pol_store().size()
+      << '\t' << kl_tab.pol_store().memory()
+      << '\t' << kl_tab.column_memory().first
+      << '\t' << mu_entries
+      << '\t' << peak << std::endl;
+} // |run|
+
+} // |namespace|
+
+} // |namespace atlas|
+
+int main(int argc, char* argv[])
+{
+  using namespace atlas;
+
+  unsigned int n_threads = 1;
+  const char* out_name = nullptr;
+  std::vector<const bench_entry*> selected;
+
+  for (int i=1; i<argc; ++i)
+    if (std::strcmp(argv[i],"-j")==0 and i+1<argc)
+    {
+      const char* arg = argv[++i]; char* end;
+      unsigned long n = std::strtoul(arg,&end,10);
+      if (*arg<'0' or *arg>'9' or *end!='\0' or n>=1024)
+      {
+	std::cerr << "klbench: number of threads should be from 0 to 1023, not '"
+		  << arg << "'" << std::endl;
+	return 1;
+      }
+      n_threads = n;
+    }
+    else if (std::strcmp(argv[i],"-o")==0 and i+1<argc)
+      out_name = argv[++i];
+    else
+    {
+      const bench_entry* p = nullptr;
+      for (const auto& e : catalogue)
+	if (std::strcmp(argv[i],e.name)==0)
+	  p = &e;
+      if (p==nullptr)
+      {
+	std::cerr << "klbench: unknown block '" << argv[i] << "'; choose from";
+	for (const auto& e : catalogue)
+	  std::cerr << ' ' << e.name;
+	std::cerr << std::endl;
+	return 1;
+      }
+      selected.push_back(p);
+    }
+
+  if (selected.empty())
+    for (const auto& e : catalogue)
+      selected.push_back(&e);
+
+  std::ofstream file;
+  if (out_name!=nullptr)
+  {
+    file.open(out_name);
+    if (not file)
+    {
+      std::cerr << "klbench: cannot open " << out_name << std::endl;
+      return 1;
+    }
+  }
+  std::ostream& out = out_name==nullptr ? std::cout : file;
+
+  print_header(out);
+  out.flush(); // nothing may remain buffered when we fork
+
+  int status = 0;
+  for (const bench_entry* p : selected)
+  {
+    std::cerr << "klbench: " << p->name << std::endl;
+    pid_t pid = fork();
+    if (pid<0)
+    {
+      std::cerr << "klbench: fork failed" << std::endl;
+      return 1;
+    }
+    if (pid==0) // child: compute, report, and leave without further ado
+    {
+      try
+      {
+	run(*p,n_threads,out);
+	out.flush();
+	_exit(0);
+      }
+      catch (error::MemoryOverflow& e)
+      {
+	std::cerr << "klbench: " << p->name << ": memory overflow" << std::endl;
+      }
+      catch (std::exception& e)
+      {
+	std::cerr << "klbench: " << p->name << ": " << e.what() << std::endl;
+      }
+      _exit(1);
+    }
+
+    int child_status;
+    if (waitpid(pid,&child_status,0)<0 or not WIFEXITED(child_status)
+	or WEXITSTATUS(child_status)!=0)
+      status = 1; // record failure, but go on with the other blocks
+  }
+
+  return status;
+}
@@ -316,6 +316,24 @@ weyl::Generator Block_base::firstStrictGoodDescent(BlockElt z) const
   return rank(); // signal nothing was found
 }
 
+size_t Block_base::memory() const
+{
+  size_t result = info.capacity()*sizeof(EltInfo)
+    + data.capacity()*sizeof(std::vector<block_fields>)
+    + partial_Hasse_diagram.capacity()*sizeof(std::unique_ptr<BlockEltList>);
+  for (const auto& row : data)
+    result += row.capacity()*sizeof(block_fields);
+  for (const auto& ptr : partial_Hasse_diagram)
+    if (ptr!=nullptr)
+      result += sizeof(BlockEltList)+ptr->capacity()*sizeof(BlockElt);
+  if (kl_tab_ptr!=nullptr)
+    result += kl_tab_ptr->memory();
+  return result; // a full Bruhat order, rarely computed, is not counted
+}
+
+size_t Block_base::fill_count() const
+{ return kl_tab_ptr==nullptr ? 0 : 1+kl_tab_ptr->stats().columns; }
+
 // translation functor from regular to singular $\gamma$ might kill $J_{reg}$
 // this depends on the simple coroots for the integral system that vanish on
 // the infinitesimal character $\gamma$, namely they make the element zero if
@@ -391,11 +409,24 @@ void Block_base::fill_Bruhat()
 
 // computes and stores the KL polynomials
 void Block_base::fill_kl_tab(BlockElt limit,
-			     KL_hash_Table* pol_hash, bool verbose)
+			     KL_hash_Table* pol_hash, bool verbose,
+			     unsigned int n_threads)
+{
+  kl_tab_object(pol_hash).fill(limit,verbose,n_threads); // extend tables
+}
+
+kl::KL_table& Block_base::kl_tab_column (KL_hash_Table* pol_hash, BlockElt y)
+{
+  kl::KL_table& result = kl_tab_object(pol_hash);
+  result.fill_column(y); // compute what is needed for column |y|
+  return result;
+}
+
+kl::KL_table& Block_base::kl_tab_object (KL_hash_Table* pol_hash)
 {
   if (kl_tab_ptr.get()==nullptr) // do this only the first time
     kl_tab_ptr.reset(new kl::KL_table(*this,pol_hash));
-  kl_tab_ptr->fill(limit,verbose); // extend tables to contain |last_y|
+  return *kl_tab_ptr;
 }
 
 // free function
@@ -1299,6 +1330,22 @@ repr::StandardRepr common_block::sr (BlockElt z,const RatWeight& gamma) const
   return rc.sr_gamma(x(z),lambda_rho,gamma);
 }
 
+size_t common_block::memory() const
+{
+  size_t result = Block_base::memory()
+    + z_pool.capacity()*sizeof(repr::Repr_mod_entry)
+    + srm_hash.capacity()*sizeof(BlockElt);
+  if (extended!=nullptr)
+    result += extended->memory();
+  return result;
+}
+
+size_t common_block::fill_count() const
+{
+  return Block_base::fill_count()
+    + (extended==nullptr ? 0 : 1+extended->fill_count());
+}
+
 ext_gens common_block::fold_orbits(const WeightInvolution& delta) const
 {
   return rootdata::fold_orbits(integral_sys.pre_root_datum(),delta);
@@ -173,6 +173,11 @@ public:
   weyl::Generator firstStrictDescent(BlockElt z) const;
   weyl::Generator firstStrictGoodDescent(BlockElt z) const;
 
+  // bytes used by the block and its tables, except for shared polynomials
+  virtual size_t memory() const;
+  // changes whenever the KL tables grow; unlike |memory| it is cheap to compute
+  virtual size_t fill_count() const;
+
   bool survives(BlockElt z, RankFlags singular) const;
     // whether $J(z_{reg})$ survives tr. functor with |singular| singular coroots
   containers::sl_list<BlockElt>
@@ -192,14 +197,20 @@ public:
   BruhatOrder& bruhatOrder() { fill_Bruhat(); return *d_bruhat; }
   BruhatOrder&& Bruhat_order() && { fill_Bruhat(); return std::move(*d_bruhat); }
   kl::KL_table& kl_tab
-    (KL_hash_Table* pol_hash, BlockElt limit=0, bool verbose=false)
-  { fill_kl_tab(limit,pol_hash,verbose); return *kl_tab_ptr; }
+    (KL_hash_Table* pol_hash, BlockElt limit=0, bool verbose=false,
+     unsigned int n_threads=1)
+  { fill_kl_tab(limit,pol_hash,verbose,n_threads); return *kl_tab_ptr; }
+  // the same, but only computing column |y| and the columns it depends on
+  kl::KL_table& kl_tab_column (KL_hash_Table* pol_hash, BlockElt y);
+  // the table object, created if necessary but without computing anything
+  kl::KL_table& kl_tab_object (KL_hash_Table* pol_hash);
 
  protected:
   void set_Bruhat_covered (BlockElt z, BlockEltList&& covered);
  private:
   void fill_Bruhat();
-  void fill_kl_tab(BlockElt limit, KL_hash_Table* pol_hash, bool verbose);
+  void fill_kl_tab(BlockElt limit, KL_hash_Table* pol_hash, bool verbose,
+		   unsigned int n_threads);
 
 }; // |class Block_base|
 
@@ -408,6 +419,8 @@ class common_block : public Block_base
   // virtual methods
   virtual KGBElt max_x() const { return highest_x; } // might not be final |x|
   virtual KGBElt max_y() const { return highest_y; }
+  virtual size_t memory() const; // includes |srm_hash| and |*extended|
+  virtual size_t fill_count() const; // includes that of |*extended|
 
   virtual std::ostream& print // defined in block_io.cpp
     (std::ostream& strm, BlockElt z,bool as_invol_expr,RankFlags singular) const;
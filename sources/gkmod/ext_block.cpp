@@ -1896,14 +1896,29 @@ ext_block::first_descent_among(RankFlags singular_orbits, BlockElt y) const
 }
 
 const ext_kl::KL_table& ext_block::kl_table
-  (BlockElt limit, ext_KL_hash_Table* pol_hash)
+  (BlockElt limit, ext_KL_hash_Table* pol_hash, unsigned int n_threads)
 {
   if (KL_ptr==nullptr)
     KL_ptr.reset(new ext_kl::KL_table(*this,pol_hash));
-  KL_ptr->fill_columns(limit);
+  KL_ptr->fill_columns(limit,n_threads);
   return *KL_ptr;
 }
 
+size_t ext_block::memory() const
+{
+  size_t result = info.capacity()*sizeof(elt_info)
+    + data.capacity()*sizeof(std::vector<block_fields>)
+    + l_start.capacity()*sizeof(BlockElt);
+  for (const auto& row : data)
+    result += row.capacity()*sizeof(block_fields);
+  if (KL_ptr!=nullptr)
+    result += KL_ptr->memory();
+  return result;
+}
+
+size_t ext_block::fill_count() const
+{ return KL_ptr==nullptr ? 0 : 1+KL_ptr->stats().columns; }
+
 void ext_block::swallow // integrate older partial block, using |embed| mapping
   (ext_block&& sub, const BlockEltList& embed)
 {
@@ -156,7 +156,7 @@ class ext_block
   void flip_edge(weyl::Generator s, BlockElt x, BlockElt y);
 
   const ext_kl::KL_table& kl_table
-    (BlockElt limit, ext_KL_hash_Table* pool=nullptr);
+    (BlockElt limit, ext_KL_hash_Table* pool=nullptr, unsigned int n_threads=1);
 
   void swallow // integrate an older partial block, with mapping of elements
     (ext_block&& sub, const BlockEltList& embed);
@@ -165,6 +165,8 @@ class ext_block
 
   size_t rank() const { return orbits.size(); }
   size_t size() const { return info.size(); }
+  size_t memory() const; // bytes used, including any KL table
+  size_t fill_count() const; // changes whenever the KL table grows
 
   const Block_base& untwisted() const // use when only the parent base is needed
     { return parent; }
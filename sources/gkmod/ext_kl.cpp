@@ -7,6 +7,9 @@
   For license information see the LICENSE file
 */
 
+#include <atomic>
+#include <thread>
+
 #include "ext_kl.h"
 #include "kl.h" // for presence of |kl::KL_table| in |check_polys|
 
@@ -99,6 +102,18 @@ unsigned int descent_table::col_size(BlockElt y) const
   return 0; // no primitives below length of |y| at all
 } // |descent_table::col_size|
 
+size_t descent_table::memory () const
+{
+  size_t result = info.capacity()*sizeof(Elt_info)
+    + prim_index.capacity()*sizeof(std::vector<unsigned int>)
+    + prim_flip.capacity()*sizeof(BitMap);
+  for (const auto& row : prim_index)
+    result += row.capacity()*sizeof(unsigned int);
+  for (const auto& flip : prim_flip)
+    result += (flip.capacity()+7)/8;
+  return result;
+}
+
 bool descent_table::prim_back_up(BlockElt& x, BlockElt y) const
 {
   RankFlags desc=descent_set(y);
@@ -123,6 +138,7 @@ KL_table::KL_table(const ext_block::ext_block& b, ext_KL_hash_Table* pol_hash)
   , own(pol_hash!=nullptr ? nullptr : new std::vector<Pol> {Pol(0),Pol(1)})
   , storage_pool(pol_hash!=nullptr ? pol_hash->pool() : *own )
   , column(b.size(),KLColumn()) // start with empty columns
+  , d_stats()
 { // ensure first two pool entries are constant polynomials $0$, and $1$
   if (pol_hash!=nullptr and pol_hash->size()<2)
   {
@@ -175,6 +191,40 @@ int KL_table::mu(short unsigned int i,BlockElt x, BlockElt y) const
   return Pxy.degree_less_than(d/=2) ? 0 : Pxy[d];
 }
 
+size_t KL_table::memory () const
+{
+  size_t result = aux.memory() + column.capacity()*sizeof(KLColumn);
+  for (const auto& col : column)
+    result += col.capacity()*sizeof(kl::KLIndex);
+  if (own!=nullptr) // then polynomials are not shared with other tables
+  { result += own->capacity()*sizeof(Pol);
+    for (const auto& pol : *own)
+      result += pol.size()*sizeof(int);
+  }
+  return result;
+}
+
+Pol KL_table::P(BlockElt x, const column_scratch& col) const
+{
+  unsigned inx=aux.x_index(x,col.y);
+  if (inx<col.pol.size())
+    return aux.flips(x,col.y) ? -col.pol[inx] : col.pol[inx];
+  else if (inx==aux.self_index(col.y)) // diagonal entries are unrecorded
+    return aux.flips(x,col.y) ? Pol(-1) : Pol(1);
+  else
+    return Pol(0); // out of bounds implies zero
+}
+
+int KL_table::mu(short unsigned int i,BlockElt x, const column_scratch& col)
+  const
+{
+  unsigned int d=l(col.y,x);
+  if (d<i or (d-=i)%2!=0)
+    return 0;
+  PolRef Pxy=P(x,col);
+  return Pxy.degree_less_than(d/=2) ? 0 : Pxy[d];
+}
+
 Pol qk_plus_1(int k)
 {
   assert(k>=1 and k<=3);
@@ -354,25 +404,26 @@ Pol KL_table::get_M(weyl::Generator s, BlockElt x, BlockElt y,
   $z$; also $x$ is known to be a descent for $s$ (unlike in the code above).
   On the other hand one is still busy computing the Hecke element $C_y$. It is
   a precondition that its coefficient $P_{x,y}$ has already been determined,
-  and stored, but $P_{x',y}$ for $x'<x$ need not be; we must therefore refrain
+  and stored in |col|, but $P_{x',y}$ for $x'<x$ need not be; we must therefore refrain
   from (implicit) references to such polynomials. Again the vector $M$ can be
   used to safely access the (complete) values $M_s(u,y)$ for all $u>x$.
 
   Comparing with the formulas above, the terms to skip are those involving
   |Cayley(s,x)| (since |s| is a descent for |x|, in fact a downward Cayley).
  */
-Pol KL_table::get_Mp(weyl::Generator s, BlockElt x, BlockElt y,
+Pol KL_table::get_Mp(weyl::Generator s, BlockElt x, const column_scratch& col,
 		     const std::vector<Pol>& M) const
 {
   const ext_block::ext_block& bl=aux.block;
+  const BlockElt y = col.y;
   const unsigned k = bl.orbit(s).length();
   if (k==1) // nothing changed for this case
-    return  Pol(l(y,x)%2==0 ? 0 : mu(1,x,y));
+    return  Pol(l(y,x)%2==0 ? 0 : mu(1,x,col));
   if (k==2)
   {
     if (l(y,x)%2!=0)
-      return q_plus_1() * Pol(mu(1,x,y));
-    int acc = mu(2,x,y);
+      return q_plus_1() * Pol(mu(1,x,col));
+    int acc = mu(2,x,col);
     for (unsigned l=bl.length(x)+1; l<bl.length(y); l+=2)
       for (BlockElt u=bl.length_first(l); u<bl.length_first(l+1); ++u)
 	if (aux.is_descent(s,u) and not M[u].isZero())
@@ -386,7 +437,7 @@ Pol KL_table::get_Mp(weyl::Generator s, BlockElt x, BlockElt y,
   assert(k==3); // this case remains
   if (l(y,x)%2==0) // now we need a multiple of $1+q$
   {
-    int acc = mu(2,x,y); // degree $1$ coefficient of |product_comp(x,s,y)|
+    int acc = mu(2,x,col); // degree $1$ coefficient of |product_comp(x,s,y)|
     for (unsigned l=bl.length(x)+1; l<bl.length(y); l+=2)
       for (BlockElt u=bl.length_first(l); u<bl.length_first(l+1); ++u)
 	if (aux.is_descent(s,u) and M[u].degree()==2)
@@ -395,8 +446,8 @@ Pol KL_table::get_Mp(weyl::Generator s, BlockElt x, BlockElt y,
   }
 
   // now we need a polynomial of the form $a+bq+aq^2$ for some $a,b$
-  int a = mu(1,x,y); // degree $2$ coefficient of |product_comp(x,s,y)|
-  int b = mu(3,x,y); // degree $0$ coefficient of |product_comp(x,s,y)|
+  int a = mu(1,x,col); // degree $2$ coefficient of |product_comp(x,s,y)|
+  int b = mu(3,x,col); // degree $0$ coefficient of |product_comp(x,s,y)|
   for (BlockElt u=bl.length_first(bl.length(x)+1); u<aux.length_floor(y); u++)
     if (aux.is_descent(s,u) and M[u].degree()==2-l(u,x)%2)
       b -= mu(M[u].degree(),x,u)*M[u][M[u].degree()];
@@ -425,18 +476,47 @@ Poly_hash_export KL_table::polynomial_hash_table ()
   return pol_hash!=nullptr ? Poly_hash_export(pol_hash) : Poly_hash_export(*own);
 }
 
-// ensure all columns |y<limit| are computed
-void KL_table::fill_columns(BlockElt limit)
+/*
+  Ensure all columns |y<limit| are computed.
+
+  With |n_threads>1| the missing columns of each length are computed
+  concurrently, which is possible since a column only uses columns for shorter
+  elements (and earlier values in the same column, for which each computation
+  has its own |column_scratch|). The polynomials found are entered into the
+  hash table sequentially, in the same order as a single threaded computation
+  would, so the numbering of the polynomials does not depend on |n_threads|.
+*/
+void KL_table::fill_columns(BlockElt limit, unsigned int n_threads)
 {
   auto hash_object = polynomial_hash_table();
+  kl::Hash_counting<PolHash> counting(d_stats,hash_object.ref);
   if (limit==0)
     limit=aux.block.size(); // fill whole block if no explicit stop was indicated
+  if (n_threads==0 and (n_threads=std::thread::hardware_concurrency())==0)
+    n_threads=1; // when the number of hardware threads is unknown, use one
+  auto start = kl::Fill_stats::clock::now();
+  if (n_threads>1)
+  {
+    for (BlockElt y=aux.block.length_first(1); y<limit; )
+    {
+      const auto l = aux.block.length(y);
+      const BlockElt stop = std::min(limit,aux.block.length_first(l+1));
+      fill_stratum(y,stop,n_threads,hash_object.ref,start);
+      y = stop;
+    }
+    return;
+  }
+  column_scratch col; // working storage, reused for all columns
   for (BlockElt y=aux.block.length_first(1); y<limit; ++y)
     if (column[y].size()!=aux.col_size(y))
     { assert(column[y].empty()); // there should not be partially filled columns
       try
       {
-	fill_column(y,hash_object.ref);
+	col.y=y;
+	compute_column(col);
+	store_column(col,hash_object.ref);
+	++d_stats.columns;
+	d_stats.add_time(aux.block.length(y),start);
       }
       catch(...)
       {
@@ -445,6 +525,77 @@ void KL_table::fill_columns(BlockElt limit)
     }
 }
 
+/*
+  Fill the missing columns |y| with |y_start<=y<y_limit|, all of which must
+  have the same length, using |n_threads| concurrent threads.
+
+  As in |kl::KL_table::fill_stratum|, work is handed out one column at a time
+  through an atomic counter, and at most |batch_factor*n_threads| computed
+  columns are kept before they are stored sequentially, in order of |y|. A
+  column whose computation fails is left empty, as in the sequential case.
+*/
+void KL_table::fill_stratum (BlockElt y_start, BlockElt y_limit,
+			     unsigned int n_threads, PolHash& hash,
+			     kl::Fill_stats::clock::time_point& start)
+{
+  constexpr unsigned int batch_factor = 16;
+
+  BlockEltList ys; // the columns to fill
+  for (BlockElt y=y_start; y<y_limit; ++y)
+    if (column[y].size()!=aux.col_size(y))
+    { assert(column[y].empty()); // there should not be partially filled columns
+      ys.push_back(y);
+    }
+
+  const size_t batch_size = batch_factor*n_threads;
+  std::vector<column_scratch> cols(std::min(batch_size,ys.size()));
+  std::vector<char> failed; // use |char| since |std::vector<bool>| is packed
+  for (size_t first=0; first<ys.size(); first+=batch_size)
+  {
+    const size_t stop = std::min(first+batch_size,ys.size());
+    failed.assign(stop-first,false);
+    std::atomic<size_t> next(first); // next index into |ys| to be handed out
+
+    std::vector<std::thread> threads; threads.reserve(n_threads);
+    {
+      kl::Thread_joiner joiner(threads); // join them, even if starting one throws
+      try
+      {
+	for (unsigned int t=0; t<n_threads; ++t)
+	  threads.emplace_back
+	    ([this,&ys,&cols,&failed,&next,first,stop] ()
+	     {
+	       for (size_t i; (i=next++)<stop; )
+		 try
+		 {
+		   auto& col = cols[i-first];
+		   col.y = ys[i];
+		   compute_column(col);
+		 }
+		 catch (...)
+		 {
+		   failed[i-first] = true; // drop the column, but carry on
+		 }
+	     });
+      }
+      catch (...)
+      {
+	next = stop; // make the threads that did start stop soon
+	throw; // after |joiner| has joined them
+      }
+    }
+
+    for (size_t i=first; i<stop; ++i) // store, in the sequential order
+      if (not failed[i-first])
+      {
+	store_column(cols[i-first],hash);
+	++d_stats.columns;
+      }
+  }
+  if (not ys.empty())
+    d_stats.add_time(aux.block.length(ys.front()),start);
+} // |KL_table::fill_stratum|
+
 /*
   Clear terms of degree $\geq d/2$ in $Q$ by subtracting $r^d*m$ where $m$
   is a symmetric Laurent polynomial in $r=\sqrt q$, and if $defect>0$ dividing
@@ -509,10 +660,11 @@ Pol KL_table::extract_M(Pol& Q,unsigned d,unsigned defect) const
   return M;
 } // |KL_table::extract_M|
 
-  void KL_table::fill_column(BlockElt y,PolHash& hash)
+void KL_table::compute_column(column_scratch& col) const
 {
+  const BlockElt y=col.y;
   // initialise column with dummy zero values; necessary for backwards filling
-  column[y].assign(aux.col_size(y),kl::KLIndex(0));
+  col.pol.assign(aux.col_size(y),Pol(0));
 
   weyl::Generator s;
   BlockElt sy; // gets set to unique descent for |s| of |y|, if one can be found
@@ -558,39 +710,48 @@ Pol KL_table::extract_M(Pol& Q,unsigned d,unsigned defect) const
 	  }
       } // |for(u)|
 
-    // finally copy relevant coefficients from |cy| array to |column[y]|
-    KLColumn::reverse_iterator it = column[y].rbegin();
+    // finally copy relevant coefficients from |cy| array to |col|
+    auto it = col.pol.rbegin();
     for (BlockElt x=floor_y; aux.prim_back_up(x,y); it++)
       if (aux.is_descent(s,x)) // then we computed $P(x,y)$ above
-        *it = hash.match(cy[x]*sign);
+        *it = cy[x]*sign;
       else // |s| might not be descent for |x| if it's primitive but not extremal
       { // use the double-valued ascent |s| for |x| that is descent for |y|
 	assert(has_double_image(type(s,x))); // since |s| non-good ascent
 	BlockEltPair sx = aux.block.Cayleys(s,x);
 	if (sx.first==UndefBlock) // if we cross the edge of a partial block
-	  *it=0; // then there can be no contribution form the Cayleys
+	  *it=Pol(0); // then there can be no contribution form the Cayleys
 	else
 	{
-	  IntPolEntry Q = P(sx.first,y);  // computed earlier in this loop
+	  IntPolEntry Q = P(sx.first,col);  // computed earlier in this loop
 	  if (aux.block.epsilon(s,x,sx.first)<0)
 	    Q *= -1;
 	  if (sx.second!=UndefBlock)
 	  {
 	    if (aux.block.epsilon(s,x,sx.second)>0)
-	      Q += P(sx.second,y);
+	      Q += P(sx.second,col);
 	    else
-	      Q -= P(sx.second,y);
+	      Q -= P(sx.second,col);
 	  }
-	  *it = hash.match(Q);
+	  *it = Q;
 	}
       }
-    assert(it==column[y].rend()); // check that we've traversed the column
+    assert(it==col.pol.rend()); // check that we've traversed the column
   } // end of |if (has_direct_recursion(y,s,sy))|
   else // direct recursion was not possible
-    do_new_recursion(y,hash);
+    do_new_recursion(col);
+} // |KL_table::compute_column|
+
+// enter the polynomials of |col| into |hash|, in the order they were computed
+void KL_table::store_column(const column_scratch& col,PolHash& hash)
+{
+  auto& dest = column[col.y];
+  dest.resize(col.pol.size());
+  for (size_t i=col.pol.size(); i-->0; ) // same order as |prim_back_up| loop
+    dest[i] = hash.match(col.pol[i]);
 
-  assert(check_polys(y));
- } // |KL_table::fill_column|
+  assert(check_polys(col.y));
+} // |KL_table::store_column|
 
 /*
   Basic idea for new recursion: if some $s$ is real nonparity for $y$ and a
@@ -605,8 +766,9 @@ Pol KL_table::extract_M(Pol& Q,unsigned d,unsigned defect) const
   the terms in the summation (where $u=x$ does not contribute since
   $s\notin\tau(x)$) are also known by descending induction on $x$
  */
-void KL_table::do_new_recursion(BlockElt y,PolHash& hash)
+void KL_table::do_new_recursion(column_scratch& col) const
 {
+  const BlockElt y=col.y;
   const BlockElt floor_y =aux.length_floor(y);
 
   struct non_parity_info { weyl::Generator s; std::vector<Pol> M; };
@@ -636,8 +798,8 @@ void KL_table::do_new_recursion(BlockElt y,PolHash& hash)
   }
 #endif
 
-  // for the primitive |x| we transfer to |column.back()| so |P(xx,y)| works
-  auto out_it = column[y].rbegin();
+  // for the primitive |x| we store into |col| so that |P(xx,col)| works
+  auto out_it = col.pol.rbegin();
   for (BlockElt x=floor_y; x-->0; )
   {
     if (is_primitive(x,y))
@@ -651,18 +813,18 @@ void KL_table::do_new_recursion(BlockElt y,PolHash& hash)
 	auto Pxy = Pol(0);
 	if (sx.first!=UndefBlock)
 	{ // although |P(x,y)| cannot be called yet, |P(x',y)| for |x'>x| is OK
-	  Pxy = P(sx.first,y); // computed earlier this loop
+	  Pxy = P(sx.first,col); // computed earlier this loop
 	  if (aux.block.epsilon(s,x,sx.first)<0)
 	    Pxy *= -1;
 	  if (sx.second!=UndefBlock)
 	  {
 	    if (aux.block.epsilon(s,x,sx.second)>0)
-	      Pxy += P(sx.second,y);
+	      Pxy += P(sx.second,col);
 	    else
-	      Pxy -= P(sx.second,y);
+	      Pxy -= P(sx.second,col);
 	  }
 	}
-	*out_it = hash.match(Pxy); // store result in primitive (only) case
+	*out_it = Pxy; // store result in primitive (only) case
       } // end of "then" branch for |if (not is_extremal(x,y))|
       else // |x| is extremal for |y|, so we must do real computation
       { // first seek proper |s| that is real non-parity for |y|
@@ -705,7 +867,7 @@ void KL_table::do_new_recursion(BlockElt y,PolHash& hash)
 	      BlockElt sx=aux.block.cross(s,x);
 	      // if |sx==UndefBlock| the next condition always fails
 	      if (sx<floor_y) // subtract contr. from $[T_x](T_s+1).T_{sx}=q^k$
-		Q -= aux.block.T_coef(s,x,sx)*P(sx,y); // coef is $\pm q^k$
+		Q -= aux.block.T_coef(s,x,sx)*P(sx,col); // coef is $\pm q^k$
 	    } // implicit division of $Q$ here is by |T_coef(s,x,x)==1|
 	    break;
 	  case ext_block::two_semi_imaginary:
@@ -714,7 +876,7 @@ void KL_table::do_new_recursion(BlockElt y,PolHash& hash)
 	    { // |has_defect(tsx)|
 	      BlockElt sx=aux.block.Cayley(s,x);
 	      if (sx<floor_y) // then in particular |sx!=UndefBlock|
-		Q -= aux.block.T_coef(s,x,sx)*P(sx,y); // coef is $\pm(q^k-q)$
+		Q -= aux.block.T_coef(s,x,sx)*P(sx,col); // coef is $\pm(q^k-q)$
 
 	      /* divide by |T_coef(s,x,x)==1+q|, knowing that $Q$ may be missing
 		 a term in effective degree $r^1$, from |mu(1,x,y)| that is not
@@ -736,9 +898,9 @@ void KL_table::do_new_recursion(BlockElt y,PolHash& hash)
 	      BlockEltPair sx=aux.block.Cayleys(s,x); // |UndefBlock|s are OK
 	      if (sx.first<floor_y)
 		Q -= aux.block.T_coef(s,x,sx.first) // $\pm(q^k-1)$
-		  *P(sx.first,y);
+		  *P(sx.first,col);
 	      if (sx.second<floor_y)
-		Q -= aux.block.T_coef(s,x,sx.second)*P(sx.second,y); // idem
+		Q -= aux.block.T_coef(s,x,sx.second)*P(sx.second,col); // idem
 	      Q/=2; // divide by |T_coef(s,x,x)==2|
 	    }
 	    break;
@@ -747,7 +909,7 @@ void KL_table::do_new_recursion(BlockElt y,PolHash& hash)
 	    { // |is_like_type_1(tsx)|, this used to be called the endgame case
 	      BlockElt x_prime=aux.block.Cayley(s,x);
 	      if (x_prime<floor_y)
-		Q -= aux.block.T_coef(s,x,x_prime)*P(x_prime,y); // $\pm(q^k-1)$
+		Q -= aux.block.T_coef(s,x,x_prime)*P(x_prime,col); // $\pm(q^k-1)$
 	      // implict division of $Q$ here is by |T_coef(s,x,x)==1|
 
 	      // now subtract off $P_{s\times x,y}$, easily computed on the fly
@@ -759,11 +921,11 @@ void KL_table::do_new_recursion(BlockElt y,PolHash& hash)
 	      {
 		BlockEltPair sx_up_t = aux.block.Cayleys(t,s_cross_x);
 		if (sx_up_t.first<floor_y)
-		  Q -= P(sx_up_t.first,y)
+		  Q -= P(sx_up_t.first,col)
 		      *(aux.block.epsilon(s,x,s_cross_x)
 		        *aux.block.epsilon(t,s_cross_x,sx_up_t.first));
 		if (sx_up_t.second<floor_y)
-		  Q -= P(sx_up_t.second,y)
+		  Q -= P(sx_up_t.second,col)
 		      *(aux.block.epsilon(s,x,s_cross_x)
 		        *aux.block.epsilon(t,s_cross_x,sx_up_t.second));
 	      }
@@ -771,7 +933,7 @@ void KL_table::do_new_recursion(BlockElt y,PolHash& hash)
 	      {
 		BlockElt sx_up_t=aux.block.Cayley(t,s_cross_x);
 		if (sx_up_t<floor_y)
-		  Q -= P(sx_up_t,y)
+		  Q -= P(sx_up_t,col)
 		      *(aux.block.epsilon(s,x,s_cross_x)
 		        *aux.block.epsilon(t,s_cross_x,sx_up_t));
 	      }
@@ -782,9 +944,9 @@ void KL_table::do_new_recursion(BlockElt y,PolHash& hash)
 	      BlockEltPair sx=aux.block.Cayleys(s,x);
 	      if (sx.first<floor_y)
 		Q -=
-		  aux.block.T_coef(s,x,sx.first)*P(sx.first,y); // $\pm(q^2-1)$
+		  aux.block.T_coef(s,x,sx.first)*P(sx.first,col); // $\pm(q^2-1)$
 	      if (sx.second<floor_y)
-		Q -= aux.block.T_coef(s,x,sx.second)*P(sx.second,y); // idem
+		Q -= aux.block.T_coef(s,x,sx.second)*P(sx.second,col); // idem
 	      Q/=2; // divide by |T_coef(s,x,x)==2|
 	    }
 	    break;
@@ -802,13 +964,13 @@ void KL_table::do_new_recursion(BlockElt y,PolHash& hash)
 	  } // |switch(tsx)|
 	  // now |Q| is completely computed
 	} // |if (info_ptr!=nullptr)|
-	*out_it = hash.match(Q); // extremal implies primitive: store result
+	*out_it = Q; // extremal implies primitive: store result
       } // end of |else| of |if (not is_extremal(x,y))|
       ++out_it; // output iterator advance only for primitive elements
     } // end of |if (is_primitive(x,y)|; the remainder is done is for all |x|
 
     // now if there is a defect ascent from |x|, update |M| for |mu(1,x,y)|
-    if (aux.block.l(y,x)==1+2*P(x,y).degree())
+    if (aux.block.l(y,x)==1+2*P(x,col).degree())
       for (auto& info : rn_for_y)
       {
 	const weyl::Generator s=info.s;	auto& M = info.M;
@@ -817,17 +979,17 @@ void KL_table::do_new_recursion(BlockElt y,PolHash& hash)
 	{
 	  const BlockElt sx = aux.block.Cayley(s,x);
 	  assert(sx<floor_y); // could only fail if |x| in downset, tested above
-	  int mu = P(x,y).coef(aux.block.l(y,x)/2) * aux.block.epsilon(s,x,sx);
+	  int mu = P(x,col).coef(aux.block.l(y,x)/2) * aux.block.epsilon(s,x,sx);
 	  M[sx] += Pol (M[sx].degree()==2 ? 1 : 0, mu);
 	}
       }
     // and update the entries |M[x]| for every |M| in |rn_for_y|
     for (auto& info : rn_for_y)
       if (is_descent(type(info.s,x)))
-	info.M[x] = get_Mp(info.s,x,y,info.M);
+	info.M[x] = get_Mp(info.s,x,col,info.M);
   } // |for(x)|
 
-  assert(out_it==column[y].rend()); // check that we've traversed the column
+  assert(out_it==col.pol.rend()); // check that we've traversed the column
 } // |KL_table::do_new_recursion|
 
 
@@ -904,7 +1066,8 @@ bool KL_table::check_polys(BlockElt y) const
       std::cerr << "Mismatch at (" << aux.block.z(x) << ',' << aux.block.z(y)
 		<< "): ";
       std::cerr << P(x,y) << " and "
-		<< untwisted.KL_pol(aux.block.z(x),aux.block.z(y)) << std::endl;
+		<< KLPol(untwisted.KL_pol(aux.block.z(x),aux.block.z(y)))
+		<< std::endl;
       result=false;
     }
 #endif
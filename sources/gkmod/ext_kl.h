@@ -70,6 +70,8 @@ class descent_table
   // number of primitive elements for |descent_set(y)| of length less than |y|
   unsigned int col_size(BlockElt y) const;
 
+  size_t memory () const; // bytes used by the tables
+
   bool is_extremal (BlockElt x, RankFlags descents_y) const
     { return descent_set(x).contains(descents_y); } // easy set empty
   bool is_primitive (BlockElt x, RankFlags descents_y) const
@@ -118,6 +120,8 @@ class KL_table
   enum { zero = 0, one  = 1 }; // indices of polynomials 0,1 in |storage_pool|
   // use |enum| rather than |static constxepr kl::KLIndex|: avoid any references
 
+  kl::Fill_stats d_stats; // what |fill_columns| has done so far
+
  public:
   KL_table(const ext_block::ext_block& b, ext_KL_hash_Table* poly_hash);
 
@@ -133,6 +137,7 @@ class KL_table
   unsigned l(BlockElt y, BlockElt x) const { return aux.block.l(y,x); }
 
   const std::vector<Pol>& polys() const { return storage_pool;}
+  const kl::Fill_stats& stats() const { return d_stats; }
   std::pair<kl::KLIndex,bool> KL_pol_index(BlockElt x, BlockElt y) const;
 
   // The twisted Kazhdan-Lusztig-Vogan polynomial P_{x,y}
@@ -149,13 +154,37 @@ class KL_table
   // coefficients in $P_{x,y}$ of $q^{(l(y/x)-i)/2}$ (use with i=1,2,3)
   int mu(short unsigned int i,BlockElt x, BlockElt y) const;
 
+  // bytes used, counting polynomials only if |storage_pool| is our own
+  size_t memory () const;
+
   // manipulators
-  void fill_columns(BlockElt limit=0); // do all |y<limit|; if |limit==0| do all
+  // do all |y<limit|, or all if |limit==0|; columns of equal length are
+  // computed concurrently if |n_threads!=1| (and |0| means: hardware decides)
+  void fill_columns(BlockElt limit=0, unsigned int n_threads=1);
   Poly_hash_export polynomial_hash_table ();
   void swallow (KL_table&& sub, const BlockEltList& embed);
  private:
-  using PolHash = HashTable<IntPolEntry,kl::KLIndex>;
-  void fill_column(BlockElt y,PolHash& hash);
+  using PolHash = ext_KL_hash_Table;
+
+  // the polynomials of column |y| while it is being computed, indexed as in
+  // |column[y]|; they enter the hash table only once the column is complete
+  struct column_scratch
+  {
+    BlockElt y;
+    std::vector<Pol> pol;
+  };
+
+  // $P_{x,y}$ where |y==col.y|, looking at |col| rather than at |column[y]|
+  Pol P(BlockElt x, const column_scratch& col) const;
+  // coefficients of that polynomial, as for |mu| below
+  int mu(short unsigned int i,BlockElt x, const column_scratch& col) const;
+
+  // compute column |col.y| into |col|; only reads |column| and |storage_pool|
+  void compute_column(column_scratch& col) const;
+  void store_column(const column_scratch& col,PolHash& hash);
+  void fill_stratum(BlockElt y_start, BlockElt y_limit,
+		    unsigned int n_threads, PolHash& hash,
+		    kl::Fill_stats::clock::time_point& start);
 
   // component of basis element $a_x$ in product $(T_s+1)C_{sy}$
   Pol product_comp (BlockElt x, weyl::Generator s, BlockElt sy) const;
@@ -168,13 +197,13 @@ class KL_table
 #endif
 
   // variant of above for new recursion: omit term if depending on $P_{x_s,y}$
-  Pol get_Mp(weyl::Generator s,BlockElt x, BlockElt y,
+  Pol get_Mp(weyl::Generator s,BlockElt x, const column_scratch& col,
 	     const std::vector<Pol>& Ms) const; // previous values $M(s,u,sy)$
 
   // look for a direct recursion and return whether possible
   bool has_direct_recursion(BlockElt y,weyl::Generator& s, BlockElt& sy) const;
 
-  void do_new_recursion(BlockElt y,PolHash& hash);
+  void do_new_recursion(column_scratch& col) const;
 
   bool check_polys(BlockElt y) const;
 
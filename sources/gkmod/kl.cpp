@@ -35,13 +35,21 @@
 #include <ctime>
 #include <sstream>
 #include <string>
+#include <cstdio> // for |std::rename|
 
 #include <sys/time.h>
 #include <sys/resource.h> // for getrusage in verbose
 
 #include <cassert>
 #include <stdexcept>
-
+#include <algorithm> // for |std::min|, |std::max|, |std::sort|
+#include <limits>
+#include <atomic>
+#include <exception> // for |std::exception_ptr|
+#include <thread>
+
+#include "arithmetic.h" // for |arithmetic::lcm| used in Chinese remaindering
+#include "basic_io.h"   // for checkpoint files
 #include "hashtable.h"
 #include "wgraph.h"	// for the |wGraph| function
 
@@ -82,12 +90,49 @@ namespace kl {
 // Polynomial $1.q^0$.
   const KLPol One(KLCoeff(1)); // since |Polynomial(d,1)| gives |1.q^d|.
 
+// First 4 bytes of a checkpoint file, see |KL_table::write_checkpoint|
+  const unsigned int checkpoint_magic = 0x4B4C4350;
+  const unsigned int checkpoint_version = 2; // header identifies the block
+  const unsigned int checkpoint_record_magic = 0x4B4C5243; // starts each record
+
 /*****************************************************************************
 
         Chapter I -- Public methods of the KLPolEntry and KL_table classes.
 
  *****************************************************************************/
 
+/* methods of KL_column */
+
+KL_column::KL_column (const std::vector<KLIndex>& entries)
+  : d_bits((entries.size()+63)/64,0)
+  , d_before(d_bits.size())
+  , d_nonzero()
+  , d_size(entries.size())
+{
+  for (unsigned int i=0; i<d_size; ++i)
+    if (entries[i]!=KLIndex(0))
+      d_bits[i>>6] |= std::uint64_t(1)<<(i&63);
+
+  unsigned int count=0;
+  for (unsigned int k=0; k<d_bits.size(); ++k)
+  {
+    d_before[k]=count;
+    count += bits::bitCount(d_bits[k]);
+  }
+
+  d_nonzero.reserve(count);
+  for (KLIndex entry : entries)
+    if (entry!=KLIndex(0))
+      d_nonzero.push_back(entry);
+}
+
+size_t KL_column::memory () const
+{
+  return d_bits.capacity()*sizeof(std::uint64_t)
+    + d_before.capacity()*sizeof(unsigned int)
+    + d_nonzero.capacity()*sizeof(KLIndex);
+}
+
 /* methods of KL_table */
 
 
@@ -99,10 +144,46 @@ KL_table::KL_table(const Block_base& b, KL_hash_Table* pol_hash)
   , pol_hash(pol_hash)
   , own(pol_hash!=nullptr ? nullptr : new KLStore{Zero,One})
   , storage_pool(pol_hash!=nullptr ? pol_hash->pool() : *own)
+  , d_modulus(0)
+  , checkpoint_file()
+  , checkpoint_interval(0)
+  , last_checkpoint(0)
+  , checkpoint_started(false)
+  , checkpoint_polys(0)
+  , checkpoint_columns(b.size())
+  , observer(nullptr)
+  , d_stats()
+  , demand_hash(nullptr)
+  , demand_start()
 {
   d_holes.fill();
 }
 
+KL_table::KL_table(const Block_base& b, KLCoeff modulus)
+  : klsupport::KLSupport(b)
+  , d_holes(b.size())
+  , d_KL(b.size())
+  , d_mu(b.size())
+  , pol_hash(nullptr) // a shared table would mix in exact polynomials
+  , own(new KLStore{Zero,One})
+  , storage_pool(*own)
+  , d_modulus(modulus)
+  , checkpoint_file()
+  , checkpoint_interval(0)
+  , last_checkpoint(0)
+  , checkpoint_started(false)
+  , checkpoint_polys(0)
+  , checkpoint_columns(b.size())
+  , observer(nullptr)
+  , d_stats()
+  , demand_hash(nullptr)
+  , demand_start()
+{
+  if (modulus%2==0) // this also excludes 0, for which we have another constructor
+    throw std::runtime_error("Modulus for KL computation must be odd");
+  d_holes.fill();
+}
+
 /******** copy, assignment and swap ******************************************/
 
 
@@ -179,8 +260,17 @@ Poly_hash_export KL_table::polynomial_hash_table ()
   return pol_hash!=nullptr ? Poly_hash_export(pol_hash) : Poly_hash_export(*own);
 }
 
-// Fill (or extend) the KL- and mu-lists up to |limit|
-void KL_table::fill(BlockElt limit, bool verbose)
+/*
+  Fill (or extend) the KL- and mu-lists up to |limit|.
+
+  With |n_threads>1| the columns of each length are computed concurrently by
+  that many threads (|n_threads==0| means: as many as the hardware supports).
+  This is possible since any column only uses columns for shorter elements.
+  The polynomials found are entered into the hash table sequentially, in the
+  same order as a single threaded computation would, so the resulting tables,
+  including the numbering of the polynomials, do not depend on |n_threads|.
+*/
+void KL_table::fill(BlockElt limit, bool verbose, unsigned int n_threads)
 {
   if (limit==0) // often defaulted value to indicate complete fill is requested
     limit=size();
@@ -191,16 +281,21 @@ void KL_table::fill(BlockElt limit, bool verbose)
   verbose=false; // if compiled for silence, force this variable
 #endif
 
+  if (n_threads==0 and (n_threads=std::thread::hardware_concurrency())==0)
+    n_threads=1; // when the number of hardware threads is unknown, use one
+
+  std::time(&last_checkpoint); // start counting for the first checkpoint
+
   try
   {
     if (verbose)
     {
       std::cerr << "computing Kazhdan-Lusztig polynomials ..." << std::endl;
-      verbose_fill(limit);
+      verbose_fill(limit,n_threads);
       std::cerr << "done" << std::endl;
     }
     else
-      silent_fill(limit);
+      silent_fill(limit,n_threads);
   }
   catch (std::bad_alloc&)
   { // roll back, and transform failed allocation into |error::MemoryOverflow|
@@ -210,11 +305,197 @@ void KL_table::fill(BlockElt limit, bool verbose)
       d_KL[*it].clear();
       d_mu[*it].clear();
     }
+    if (not checkpoint_file.empty())
+      try { save_checkpoint(); } // try to save the columns that were completed
+      catch (...) {} // but don't mask the original problem
     throw error::MemoryOverflow();
   }
 
 }
 
+/*
+  Compute column |y| on demand, together with exactly those columns that its
+  computation uses, as opposed to |fill(y+1)| which computes all columns |z<y|.
+  Those columns are found during the computation: whenever the recursion is
+  about to look at a column that is still a hole, |need_column| computes it
+  first (recursively, so with its own working storage). For the direct
+  recursion these are the column for the descent |sy|, and those for the
+  elements |z| with $\mu(z,sy)\neq0$ for which |s| is a descent; for the new
+  recursion those for elements $z$ with $\mu(z,y)\neq0$ (found in the down-set
+  of |y|, or while computing the column). All columns computed remain in the
+  table, so later calls (and |fill|) reuse them. Since polynomials are
+  numbered in order of discovery, the numbering will in general differ from
+  the one that |fill| produces.
+*/
+void KL_table::fill_column(BlockElt y)
+{
+  if (not d_holes.isMember(y))
+    return; // nothing to do
+
+  const auto hash_object = polynomial_hash_table();
+  Hash_counting<KL_hash_Table> counting(d_stats,hash_object.ref);
+
+  struct demand_setting // make |need_column| compute missing columns
+  {
+    KL_table& table;
+    demand_setting(KL_table& t, KL_hash_Table& hash) : table(t)
+    { table.demand_hash = &hash; table.demand_start = Fill_stats::clock::now(); }
+    ~demand_setting() { table.demand_hash = nullptr; }
+  } demand(*this,hash_object.ref);
+
+  try
+  {
+    demand_column(y);
+  }
+  catch (error::NumericOverflow& )
+  { // identify and relabel error so that atlas may catch it
+    throw std::runtime_error("Numeric overflow in KL computations");
+  }
+} // |KL_table::fill_column|
+
+/*
+  Fill the exact table up to |limit| by first filling, for each of |moduli|, a
+  table modulo that number, and then lifting the coefficients by the Chinese
+  remainder theorem. The moduli must be odd, pairwise coprime, and their
+  product must fit in an |arithmetic::Denom_t|; the result is only correct if
+  that product exceeds all coefficients, which is not (and cannot be) checked.
+
+  The modular tables all have the same shape as the exact one. We combine them
+  column by column, and enter the lifted polynomials into the hash table in
+  the order that |fill| would use, so that |storage_pool| ends up as it would
+  for a direct exact computation.
+*/
+void KL_table::fill_by_CRT (const std::vector<KLCoeff>& moduli,
+			    BlockElt limit, bool verbose, unsigned int n_threads)
+{
+  using arithmetic::Denom_t;
+  if (d_modulus!=0)
+    throw std::runtime_error("Cannot lift to a modular KL table");
+  if (moduli.empty())
+    throw std::runtime_error("No moduli given for KL computation");
+  if (limit==0)
+    limit=size();
+  if (limit<=first_hole())
+    return; // tables present already sufficiently large for |y|
+
+  // |inverse[k]| will be the inverse of |moduli[0]*...*moduli[k-1]| modulo
+  // |moduli[k]|, with which we lift to the product of moduli one at the time
+  std::vector<Denom_t> inverse; inverse.reserve(moduli.size());
+  {
+    Denom_t product=1, gcd, mult;
+    for (KLCoeff n : moduli)
+    {
+      if (n%2==0 or n==1)
+	throw std::runtime_error("Moduli for KL computation must be odd and >1");
+      if (product>std::numeric_limits<Denom_t>::max()/n)
+	throw std::runtime_error("Product of moduli too large");
+      arithmetic::lcm(product,n,gcd,mult); // |mult%n==gcd|, and |product| divides it
+      if (gcd!=1)
+	throw std::runtime_error("Moduli for KL computation must be coprime");
+      inverse.push_back(mult/product);
+      product *= n;
+    }
+  }
+
+  const auto lift = // find coefficient from its |residues| by CRT
+    [&moduli,&inverse] (const std::vector<KLCoeff>& residues) -> KLCoeff
+    {
+      Denom_t result=residues[0], product=moduli[0];
+      for (unsigned int k=1; k<moduli.size(); ++k)
+      {
+	const Denom_t n=moduli[k]; // now correct |result| modulo |n|
+	result += product*((residues[k]+n-result%n)%n*inverse[k]%n);
+	product *= n;
+      }
+      if (result>std::numeric_limits<KLCoeff>::max())
+	throw std::runtime_error("Numeric overflow in KL computations");
+      return result;
+    };
+
+  std::vector<std::unique_ptr<KL_table> > tables; tables.reserve(moduli.size());
+  for (KLCoeff n : moduli)
+  {
+    tables.emplace_back(new KL_table(block(),n));
+    tables.back()->fill(limit,verbose,n_threads);
+  }
+
+  const auto hash_object = polynomial_hash_table();
+  auto& hash = hash_object.ref;
+  Hash_counting<KL_hash_Table> counting(d_stats,hash);
+  std::vector<KLCoeff> residues(moduli.size());
+  std::vector<KLPol> col;
+  auto start = Fill_stats::clock::now();
+  for (auto it = d_holes.begin(); it() and *it<limit; ++it)
+  {
+    const BlockElt y=*it;
+    prepare_prim_index(descent_set(y)); // so looking up |KL_pol(x,y)| will be OK
+
+    col.assign(tables[0]->d_KL[y].size(),Zero);
+    for (unsigned int i=0; i<col.size(); ++i)
+    {
+      polynomials::Degree size=0; // the maximum of the sizes of the residues
+      for (const auto& t : tables)
+	size = std::max(size,t->storage_pool[t->d_KL[y][i]].size());
+      for (polynomials::Degree j=size; j-->0; )
+      {
+	for (unsigned int k=0; k<tables.size(); ++k)
+	  residues[k] = tables[k]->storage_pool[tables[k]->d_KL[y][i]].coef(j);
+	if (j+1==size) // leading coefficient, nonzero for some residue
+	  col[i] = KLPol(j,lift(residues));
+	else
+	  col[i][j] = lift(residues);
+      }
+    }
+
+    BlockEltList xs; // all |x| with nonzero $\mu(x,y)$ modulo some modulus
+    for (const auto& t : tables)
+      for (const auto& pair : t->d_mu[y])
+	xs.push_back(pair.x);
+    std::sort(xs.begin(),xs.end());
+    xs.erase(std::unique(xs.begin(),xs.end()),xs.end());
+    Mu_column& mu_col = d_mu[y];
+    mu_col.clear(); mu_col.reserve(xs.size());
+    for (BlockElt x : xs)
+    {
+      for (unsigned int k=0; k<tables.size(); ++k)
+      {
+	const auto& mc = tables[k]->d_mu[y];
+	const auto loc = std::lower_bound(mc.begin(),mc.end(),Mu_pair(x,0));
+	residues[k] = loc!=mc.end() and loc->x==x ? loc->coef : 0;
+      }
+      mu_col.emplace_back(x,lift(residues));
+    }
+
+    // the sequential |fill| used backwards order for direct recursion columns
+    store_KL_column(y,col,first_direct_recursion(y)<rank(),hash);
+    d_holes.remove(y);
+    ++d_stats.columns;
+    d_stats.add_time(length(y),start); // time for lifting only
+  }
+} // |KL_table::fill_by_CRT|
+
+std::pair<size_t,size_t> KL_table::column_memory () const
+{
+  size_t sparse=0, dense=0;
+  for (BlockElt y=0; y<size(); ++y)
+  {
+    sparse += d_KL[y].memory();
+    dense += d_KL[y].size()*sizeof(KLIndex);
+  }
+  return std::make_pair(sparse,dense);
+}
+
+size_t KL_table::memory () const
+{
+  size_t result = column_memory().first + prim_index_memory().first
+    + d_KL.capacity()*sizeof(KL_column) + d_mu.capacity()*sizeof(Mu_column);
+  for (const auto& col : d_mu)
+    result += col.capacity()*sizeof(Mu_pair);
+  if (own!=nullptr) // then polynomials are not shared with other tables
+    result += own->memory();
+  return result;
+}
+
 BitMap KL_table::prim_map (BlockElt y) const
 {
   // the vector of polynomial indices at primitive elements |x|, all with |y|
@@ -338,24 +619,116 @@ std::pair<weyl::Generator,weyl::Generator>
 inline BlockEltPair KL_table::inverse_Cayley(weyl::Generator s, BlockElt y) const
 { return block().inverseCayley(s,y); }
 
+/*
+  The arithmetic used in the recursions. The modulus is passed explicitly to
+  the |Safe_Poly| methods, so that tables computing modulo different numbers
+  (or exactly) can be filled at the same time, for instance in different threads.
+*/
+template<typename P> inline void KL_table::add
+  (KLPol& a, const P& p, polynomials::Degree d, KLCoeff c) const
+{
+  if (d_modulus!=0)
+    a.modAdd(p,d,c,d_modulus);
+  else if (c==KLCoeff(1))
+    a.safeAdd(p,d); // avoid useless multiplication by 1
+  else
+    a.safeAdd(p,d,c);
+}
+
+template<typename P> inline void KL_table::subtract
+  (KLPol& a, const P& p, polynomials::Degree d, KLCoeff c) const
+{
+  if (d_modulus!=0)
+    a.modSubtract(p,d,c,d_modulus);
+  else if (c==KLCoeff(1))
+    a.safeSubtract(p,d);
+  else
+    a.safeSubtract(p,d,c);
+}
+
+void KL_table::divide(KLPol& a, KLCoeff c) const
+{
+  if (d_modulus!=0)
+    a.modDivide(c,d_modulus);
+  else
+    a.safeDivide(c);
+}
+
+void KL_table::quotient_by_1_plus_q(KLPol& a, polynomials::Degree delta) const
+{
+  if (d_modulus!=0)
+    a.mod_quotient_by_1_plus_q(delta,d_modulus);
+  else
+    a.safe_quotient_by_1_plus_q(delta);
+}
+
 
 // private manipulators
 
+// Compute the hole |y| during |fill_column|; columns needed are done as we go
+void KL_table::demand_column(BlockElt y)
+{
+  assert(demand_hash!=nullptr and d_holes.isMember(y));
+  std::vector<KLPol> klv, col; // working storage private to this column
+  fill_KL_column(klv,col,y,*demand_hash);
+  d_holes.remove(y);
+  ++d_stats.columns;
+  d_stats.add_time(length(y),demand_start);
+}
+
 // Fill the column for |y| in the KL-table, all previous ones having been filled
 void KL_table::fill_KL_column
-  (std::vector<KLPol>& klv, BlockElt y, KL_hash_Table& hash)
+  (std::vector<KLPol>& klv, std::vector<KLPol>& col, BlockElt y,
+   KL_hash_Table& hash)
 {
   prepare_prim_index(descent_set(y)); // so looking up |KL_pol(x,y)| will be OK
+  bool backwards = compute_KL_column(klv,col,y);
+  store_KL_column(y,col,backwards,hash);
+} // |KL_table::fill_KL_column|
 
+/*
+  Compute the polynomials $P_{x,y}$ for all primitive |x| for |y|, into |col|
+  (in the order of |d_KL[y]|), and set |d_mu[y]|; the columns for elements of
+  length less than that of |y| must be complete, and |prim_index| prepared for
+  |descent_set(y)|. This touches neither the polynomial hash table nor any
+  other column than |y|, so it can be called for different |y| of the same
+  length concurrently. The return value is the order (as for |store_KL_column|)
+  in which the sequential algorithm used to intern the polynomials.
+*/
+bool KL_table::compute_KL_column
+  (std::vector<KLPol>& klv, std::vector<KLPol>& col, BlockElt y)
+{
   weyl::Generator s = first_direct_recursion(y);
   if (s<rank())  // a direct recursion was found, use it for |y|, for all |x|
   {
     recursion_column(y,s,klv); // compute $P_{x,y}$ for extremal |x| for |y|
-    complete_primitives(klv,y,hash); // add primitive |x|s; store in |d_KL|
+    complete_primitives(klv,y,col); // add primitive |x|s
+    return true;
   }
-  else // we must use an approach that distinguishes on |x| values
-    new_recursion_column(klv,y,hash); // compute and install column
-} // |KL_table::fill_KL_column|
+  // otherwise we must use an approach that distinguishes on |x| values
+  new_recursion_column(col,y); // compute column
+  return false;
+} // |KL_table::compute_KL_column|
+
+/*
+  Look up the polynomials of a computed column |col| for |y| in |hash| (which
+  may extend |storage_pool|), and record their indices in |d_KL[y]|. Since the
+  order of calls of |hash.match| determines the numbering of new polynomials,
+  it is done as the sequential algorithm did: |backwards| for direct recursion.
+*/
+void KL_table::store_KL_column
+  (BlockElt y, const std::vector<KLPol>& col, bool backwards,
+   KL_hash_Table& hash)
+{
+  std::vector<KLIndex> KL(col.size()); // slots for all pertinent elements |x|
+  if (backwards)
+    for (unsigned int i=col.size(); i-->0; )
+      KL[i] = hash.match(col[i]);
+  else
+    for (unsigned int i=0; i<col.size(); ++i)
+      KL[i] = hash.match(col[i]);
+  d_KL[y] = KL_column(KL); // store in compressed form
+} // |KL_table::store_KL_column|
 
 /*
   Put into |klv[x]| the the right-hand sides of the recursion formulae for the
@@ -382,16 +755,14 @@ void KL_table::recursion_column (BlockElt y,weyl::Generator s,
   const BlockElt sy =
     descent_value(s,y) == DescentStatus::ComplexDescent ? cross(s,y)
     : inverse_Cayley(s,y).first;  // s is real type I for y here, ignore .second
+  need_column(sy);
 
-  // make increasing list of all extremal elements shorter than |y|
-  BlockEltList extremals; extremals.reserve(col_size(y)); // more than enough
-  for (BlockElt x=0; x<length_floor(y); ++x)
-    if (is_extremal(x,desc_y))
-      extremals.push_back(x);
-
+  // the extremal elements shorter than |y| start the precomputed list for |y|
+  const BlockEltList& extremals = this->extremals(desc_y);
+  const auto extr_end = extremals.cbegin()+n_extremals(length(y),desc_y);
 
   // while more natural to do |x| descending, forward loop avoids |std:reverse|
-  for (auto it=extremals.cbegin(); it!=extremals.cend(); ++it)
+  for (auto it=extremals.cbegin(); it!=extr_end; ++it)
   { // now |x| is extremal for $y$, so $s$ is descent for $x$
     BlockElt x=*it;
     klv.push_back(Zero);
@@ -401,32 +772,32 @@ void KL_table::recursion_column (BlockElt y,weyl::Generator s,
     case DescentStatus::ImaginaryCompact:
       { // $(q+1)P_{x,sy}$
 	Pxy = KL_pol(x,sy);
-	Pxy.safeAdd(Pxy,1); // mulitply by $1+q$
+	add(Pxy,Pxy,1); // mulitply by $1+q$
       }
       break;
     case DescentStatus::ComplexDescent:
       { // $P_{sx,sy}+q.P_{x,sy}$
 	BlockElt sx = cross(s,x);
 	Pxy = KL_pol(sx,sy);
-	Pxy.safeAdd(KL_pol(x,sy),1);
+	add(Pxy,KL_pol(x,sy),1);
       }
       break;
     case DescentStatus::RealTypeI:
       { // $P_{sx.first,sy}+P_{sx.second,sy}+(q-1)P_{x,sy}$
 	BlockEltPair sx = inverse_Cayley(s,x);
 	Pxy = KL_pol(sx.first,sy);
-	Pxy.safeAdd(KL_pol(sx.second,sy));
+	add(Pxy,KL_pol(sx.second,sy));
 	KLPolRef Pxsy = KL_pol(x,sy);
-	Pxy.safeAdd(Pxsy,1);
-	Pxy.safeSubtract(Pxsy); // subtraction must be last
+	add(Pxy,Pxsy,1);
+	subtract(Pxy,Pxsy); // subtraction must be last
       }
       break;
     case DescentStatus::RealTypeII:
       { // $P_{sx,sy}+qP_{x,sy}-P_{s.x,sy}$
 	BlockElt sx = inverse_Cayley(s,x).first;
 	Pxy = KL_pol(sx,sy);
-	Pxy.safeAdd(KL_pol(x,sy),1);
-	Pxy.safeSubtract(KL_pol(cross(s,x),sy)); // subtraction must be last
+	add(Pxy,KL_pol(x,sy),1);
+	subtract(Pxy,KL_pol(cross(s,x),sy)); // subtraction must be last
       }
       break;
     default: assert(false); // this cannot happen
@@ -446,7 +817,8 @@ void KL_table::recursion_column (BlockElt y,weyl::Generator s,
 
 /*
   Subtract from all polynomials in |klv| the correcting terms in the
-  K-L recursion.
+  K-L recursion. The initial part of |extremals| consisting of elements shorter
+  than |y| corresponds to |klv|; any further elements are not looked at.
 
   When we call |mu_correction|, the polynomial |klv[x]| already contains, for
   all $x$ that are extremal for |y| (the members of |e|), the terms in $P_{x,y}$
@@ -487,6 +859,8 @@ void KL_table::mu_correction(const BlockEltList& extremals,
 
       size_t lz = length(z);
       polynomials::Degree d = (ly-lz)/2; // power of |q| used below
+      if (not extremals.empty() and length(extremals.front())<lz)
+	need_column(z); // since we shall look up |KL_pol(x,z)| below
 
       auto in_it = extremals.cbegin();
       auto out_it = klv.begin();
@@ -496,7 +870,7 @@ void KL_table::mu_correction(const BlockEltList& extremals,
 	{
 	  BlockElt x=*in_it;
 	  KLPolRef pol = KL_pol(x,z);
-	  out_it->safeSubtract(pol,d); // subtract $q^d.P_{x,z}$ from klv[x]
+	  subtract(*out_it,pol,d); // subtract $q^d.P_{x,z}$ from klv[x]
 	}
       else // (rare) case that |mu>1|
 	for (; in_it!=extremals.cend() and length(*in_it)<lz;
@@ -504,7 +878,7 @@ void KL_table::mu_correction(const BlockEltList& extremals,
 	{
 	  BlockElt x=*in_it;
 	  KLPolRef pol = KL_pol(x,z);
-	  out_it->safeSubtract(pol,d,mu); // subtract $q^d.mu.P_{x,z}$
+	  subtract(*out_it,pol,d,mu); // subtract $q^d.mu.P_{x,z}$
 	}
 
       if (is_extremal(z,desc_y)) // then handle final term |x==z|
@@ -512,7 +886,7 @@ void KL_table::mu_correction(const BlockEltList& extremals,
 	while (*in_it!=z)
 	  ++in_it,++out_it; // advance |out_it| to |klv| entry for |z|
 	assert( out_it->degree()==d and (*out_it)[d]==mu );
-	out_it->safeSubtract(KLPol(d,mu)); // subtract off the term $mu.q^d$
+	subtract(*out_it,KLPol(d,mu)); // subtract off the term $mu.q^d$
       }
 
     } // |for (it->reverse(mcol))| |if(isDescent(descentValue(s,it->x))|
@@ -521,12 +895,12 @@ void KL_table::mu_correction(const BlockEltList& extremals,
 
 /* A method that takes a row |klv| of completed KL polynomials, computed by
    |recursion_column| at |y| and extremal elements |x| listed in |ext|, and
-   transfers them to the main storage structures |d_KL|, |d_mu|. Its tasks are
+   transfers them to the full column |col| and to |d_mu|. Its tasks are
 
    - generate the list of all primitive elements for |y|, which contains |ext|
-   - for each primitive element |x|, if it is extremal just look up $P_{x,y}$
-     as |klv[x]|, if |x| is primitive but not extremal, compute that polynomial
-     (as sum of two $P_{x',y}$ in the same column); hash and store the result
+   - for each primitive element |x|, if it is extremal just take $P_{x,y}$
+     from |klv[x]|, if |x| is primitive but not extremal, compute that
+     polynomial (as sum of two $P_{x',y}$ in the same column); store the result
    - record nonzero $P_{x,y}$ as $(x,P)$ and similarly any non-zero $\mu(x,y)$
 
    For the latter point there are two categories of |x|: the extremal ones
@@ -536,24 +910,27 @@ void KL_table::mu_correction(const BlockEltList& extremals,
    of that length as well with nonzero mu), and are primitive only in the real
    type 2 case; we must treat them outside the loop over primitive elements.
  */
-void KL_table::complete_primitives(const std::vector<KLPol>& klv, BlockElt y,
-				   KL_hash_Table& hash)
+void KL_table::complete_primitives(std::vector<KLPol>& klv, BlockElt y,
+				   std::vector<KLPol>& col)
 {
-  KL_column& KL = d_KL[y]; // the column that we must write to
-  KL.resize(col_size(y)); // create slots for all pertinent elements |x|
+  col.assign(col_size(y),Zero); // create slots for all pertinent elements |x|
 
   Mu_list mu_pairs; // those |x| with |mu(x,y)>0|
   const unsigned int ly = length(y);
   const RankFlags desc_y = descent_set(y);
+  auto P_y = // look up $P_{x,y}$ in current column, as |KL_pol(x,y)| would
+    [this,&col,y,desc_y] (BlockElt x) -> const KLPol&
+    { unsigned int inx = prim_index(x,desc_y);
+      return inx<col.size() ? col[inx] : inx==self_index(y) ? One : Zero;
+    };
 
-  auto KL_it = KL.rbegin(); // prepare for writing |KL| backwards
+  auto col_it = col.rbegin(); // prepare for writing |col| backwards
   auto it = klv.rbegin(); // prepare for reading |klv| backwards
   // traverse primitives for |y| of length |y| less than |ly| backwards
-  for(BlockElt x=length_floor(y); prim_back_up(x,desc_y); ++KL_it)
+  for(BlockElt x=length_floor(y); prim_back_up(x,desc_y); ++col_it)
     if (is_extremal(x,desc_y))
     { // extremal element for |y|; use polynomial from vector passed to us
-      const KLPol& Pxy = *it++;
-      *KL_it = hash.match(Pxy);
+      KLPol& Pxy = *col_it = std::move(*it++);
       unsigned int lx = length(x);
       if (not Pxy.isZero() and ly==lx+2*Pxy.degree()+1)
 	mu_pairs.emplace_front(x,MuCoeff(Pxy[Pxy.degree()]));
@@ -563,11 +940,10 @@ void KL_table::complete_primitives(const std::vector<KLPol>& klv, BlockElt y,
       unsigned int s = ascent_descent(x,y);
       assert(descent_value(s,x)==DescentStatus::ImaginaryTypeII);
       BlockEltPair xs = cayley(s,x);
-      KLPol Pxy = KL_pol(xs.first,y); // look up P_{x',y} in current row, above
-      Pxy.safeAdd(KL_pol(xs.second,y)); // current point, and P_{x'',y} as well
-      *KL_it = hash.match(Pxy); // add poly at primitive non-extremal x
+      *col_it = P_y(xs.first); // look up P_{x',y} in current row, above
+      add(*col_it,P_y(xs.second)); // current point, and P_{x'',y} as well
     }
-  assert(KL_it==KL.rend());
+  assert(col_it==col.rend());
   assert(it==klv.rend());
 
   Mu_list downs;
@@ -585,7 +961,7 @@ void KL_table::complete_primitives(const std::vector<KLPol>& klv, BlockElt y,
 
 /*
   Compute polynomials $P_{x,y}$ for all $x$ of length less than and primitive
-  for |y|, look them up and return a vector of their indices in |storage_pool|.
+  for |y|, and leave them in |cur_col| (indexed as |d_KL[y]| will be).
 
   These KL polynomials are computed by a recursion formula designed for those
   elements |y| for which the direct recursion does not apply.
@@ -629,8 +1005,7 @@ void KL_table::complete_primitives(const std::vector<KLPol>& klv, BlockElt y,
   This code gets executed for |y| that are of minimal length, in which case
   it only contributes $P_{y,y}=1$; the |while| loop will be executed 0 times.
 */
-void KL_table::new_recursion_column
-  (std::vector<KLPol>& cur_col, BlockElt y, KL_hash_Table& hash)
+void KL_table::new_recursion_column(std::vector<KLPol>& cur_col, BlockElt y)
 {
   const unsigned int l_y = length(y);
   const auto desc_y = descent_set(y);
@@ -663,7 +1038,7 @@ void KL_table::new_recursion_column
       assert(descent_value(s,x)==DescentStatus::ImaginaryTypeII);
       BlockEltPair p = cayley(s,x);
       Pxy = KL_y(p.first);
-      Pxy.safeAdd(KL_y(p.second));
+      add(Pxy,KL_y(p.second));
       continue; // done with |x|, go on to the next
     }
 
@@ -684,17 +1059,17 @@ void KL_table::new_recursion_column
       switch (descent_value(s,x))
       {
       case DescentStatus::ComplexAscent: // use equations (3.3a)=(3.4)
-	Pxy.safeSubtract(KL_y(cross(s,x)),1); // subtract qP_{sx,y}
+	subtract(Pxy,KL_y(cross(s,x)),1); // subtract qP_{sx,y}
 	break;
 
       case DescentStatus::ImaginaryTypeII:
 	{ // use equations (3.3a)=(3.5)
 	  BlockEltPair p = cayley(s,x);
 	  KLPol sum = KL_y(p.first);
-	  sum.safeAdd(KL_y(p.second));
-	  Pxy.safeAdd(sum);
-	  Pxy.safeSubtract(sum,1); //now we've added (1-q)(P_{x',y}+P_{x'',y})
-	  Pxy.safeDivide(2);   //this could throw, but should not
+	  add(sum,KL_y(p.second));
+	  add(Pxy,sum);
+	  subtract(Pxy,sum,1); //now we've added (1-q)(P_{x',y}+P_{x'',y})
+	  divide(Pxy,2);   //this could throw, but should not
 	} // ImaginaryTypeII case
 	break;
 
@@ -703,7 +1078,7 @@ void KL_table::new_recursion_column
 	   leading (if nonzero) term to appear in addition to (3.4), giving
 	   rise to equation (3.7). Yet we can determine the quotient by q+1.
 	*/
-	Pxy.safe_quotient_by_1_plus_q(length(y)-length(x));
+	quotient_by_1_plus_q(Pxy,length(y)-length(x));
 	break;
 
       default: assert(false); //we've handled all possible NiceAscents
@@ -741,8 +1116,8 @@ void KL_table::new_recursion_column
 
 	//subtract (q-1)P_{xprime,y} from terms of expression (3.4)
 	const auto& P_xprime_y = KL_y(cayley(s,x).first);
-	Pxy.safeAdd(P_xprime_y);
-	Pxy.safeSubtract(P_xprime_y,1);
+	add(Pxy,P_xprime_y);
+	subtract(Pxy,P_xprime_y,1);
 
 	//now |Pxy| holds P_{x,y}+P_{s.x,y}
 
@@ -754,8 +1129,8 @@ void KL_table::new_recursion_column
 	  BlockEltPair sx_up_t = cayley(t,cross(s,x));
 
 	  // any |UndefBlock| component of |sx_up_t| will contribute $0$
-	  Pxy.safeSubtract(KL_y(sx_up_t.first));
-	  Pxy.safeSubtract(KL_y(sx_up_t.second));
+	  subtract(Pxy,KL_y(sx_up_t.first));
+	  subtract(Pxy,KL_y(sx_up_t.second));
 	}
 
 	if (l_y==l_x+2*Pxy.degree()+1)
@@ -767,13 +1142,7 @@ void KL_table::new_recursion_column
   } // for(BlockElt x = length_less(l_y); prim_back_up(x,desc_y); --col_it)|
   assert(col_it==cur_col.begin());
 
-  { // transcribe polynomials from |cur_col| to |d_KL[y]| and clean up
-    auto& col_y = d_KL[y];
-    col_y.reserve(height);
-    for (unsigned int i=0; i<height; ++i)
-      col_y.push_back(hash.match(cur_col[i]));
-    cur_col.clear();
-  }
+  cur_col.resize(height); // drop entries for |y| itself and for "dead ends"
 
   { // shuffle |mu_pairs| into increasing order
     Mu_list downs; // set apart initial part which is increasing
@@ -823,12 +1192,13 @@ KLPol KL_table::mu_new_formula
     // now we have a true contribution with nonzero $\mu$
     unsigned int d = (ly - lz +1)/2; // power of $q$ used in the formula
     MuCoeff mu = pair.coef;
+    need_column(z);
     KLPolRef Pxz = KL_pol(x,z); // we can look this up because $z<y$
 
     if (mu==MuCoeff(1)) // avoid useless multiplication by 1 if possible
-      pol.safeAdd(Pxz,d); // add $q^d.P_{x,z}$ to |pol|
+      add(pol,Pxz,d); // add $q^d.P_{x,z}$ to |pol|
     else // mu!=MuCoeff(1)
-      pol.safeAdd(Pxz,d,mu); // add $q^d.\mu(z,y).P_{x,z}$ to |pol|
+      add(pol,Pxz,d,mu); // add $q^d.\mu(z,y).P_{x,z}$ to |pol|
 
   } // |for (pair : mu_y)|
 
@@ -836,20 +1206,111 @@ KLPol KL_table::mu_new_formula
 } // |KL_table::muNewFormula|
 
 
-void KL_table::silent_fill(BlockElt limit)
+/*
+  Fill the columns of the holes |y| with |y_start<=y<y_limit|, all of which
+  must have the same length, using |n_threads| concurrent threads.
+
+  Work is handed out one column at a time through an atomic counter, so that
+  threads that finish early pick up remaining columns. The polynomials of at
+  most |batch_factor*n_threads| columns are kept before storing them (which
+  is done sequentially, in order of |y|) to limit memory usage; since storing
+  may extend |storage_pool|, no computation is going on while it happens.
+*/
+void KL_table::fill_stratum (BlockElt y_start, BlockElt y_limit,
+			     unsigned int n_threads, KL_hash_Table& hash)
+{
+  constexpr unsigned int batch_factor = 16;
+
+  BlockEltList ys; // the holes to fill
+  for (BlockElt y=y_start; y<y_limit; ++y)
+    if (d_holes.isMember(y))
+    {
+      ys.push_back(y);
+      prepare_prim_index(descent_set(y)); // modifies |KLSupport|, so do it now
+    }
+
+  const size_t batch_size = batch_factor*n_threads;
+  std::vector<std::vector<KLPol> > cols; cols.reserve(batch_size);
+  std::vector<char> backwards; // use |char| since |std::vector<bool>| is packed
+  for (size_t start=0; start<ys.size(); start+=batch_size)
+  {
+    const size_t stop = std::min(start+batch_size,ys.size());
+    cols.assign(stop-start,std::vector<KLPol>());
+    backwards.assign(stop-start,false);
+    std::atomic<size_t> next(start); // next index into |ys| to be handed out
+
+    std::vector<std::exception_ptr> errors(n_threads);
+    std::vector<std::thread> threads; threads.reserve(n_threads);
+    {
+      Thread_joiner joiner(threads); // join them, even if starting one throws
+      try
+      {
+	for (unsigned int t=0; t<n_threads; ++t)
+	  threads.emplace_back
+	    ([this,&ys,&cols,&backwards,&next,&errors,start,stop,t] ()
+	     {
+	       try
+	       {
+		 std::vector<KLPol> klv; // private working storage
+		 for (size_t i; (i=next++)<stop; )
+		   backwards[i-start] =
+		     compute_KL_column(klv,cols[i-start],ys[i]);
+	       }
+	       catch (...)
+	       {
+		 errors[t] = std::current_exception();
+		 next = stop; // make other threads stop as soon as possible
+	       }
+	     });
+      }
+      catch (...)
+      {
+	next = stop; // make the threads that did start stop soon
+	throw; // after |joiner| has joined them
+      }
+    }
+    for (const auto& error : errors)
+      if (error!=nullptr)
+	std::rethrow_exception(error);
+
+    for (size_t i=start; i<stop; ++i) // store, in the sequential order
+    {
+      store_KL_column(ys[i],cols[i-start],backwards[i-start],hash);
+      d_holes.remove(ys[i]);
+    }
+    d_stats.columns += stop-start;
+    report_progress();
+  }
+} // |KL_table::fill_stratum|
+
+void KL_table::silent_fill(BlockElt limit, unsigned int n_threads)
 {
   std::vector<KLPol> klv; klv.reserve(block().size()); // enough working storage
+  std::vector<KLPol> col;
 
   const auto hash_object = polynomial_hash_table();
   auto& hash = hash_object.ref;
+  Hash_counting<KL_hash_Table> counting(d_stats,hash);
+  auto start = Fill_stats::clock::now();
   try
   {
     // fill the lists
-    for (auto it = d_holes.begin(); it() and *it<limit; ++it)
-    {
-      fill_KL_column(klv,*it,hash);
-      d_holes.remove(*it);
-    }
+    if (n_threads>1)
+      for (size_t l=length(first_hole()); length_less(l)<limit; ++l)
+      {
+	fill_stratum(std::max(first_hole(),length_less(l)),
+		     std::min(limit,length_less(l+1)),n_threads,hash);
+	d_stats.add_time(l,start);
+      }
+    else
+      for (auto it = d_holes.begin(); it() and *it<limit; ++it)
+      {
+	fill_KL_column(klv,col,*it,hash);
+	d_holes.remove(*it);
+	++d_stats.columns;
+	d_stats.add_time(length(*it),start);
+	report_progress();
+      }
     // after all columns are done the hash table is freed, only the store remains
   }
   catch (error::NumericOverflow& )
@@ -859,12 +1320,14 @@ void KL_table::silent_fill(BlockElt limit)
 }
 
 // Fill the existing |KL_table| object while printing progress reports
-void KL_table::verbose_fill(BlockElt limit)
+void KL_table::verbose_fill(BlockElt limit, unsigned int n_threads)
 {
   std::vector<KLPol> klv; klv.reserve(block().size()); // enough working storage
+  std::vector<KLPol> col;
 
   const auto hash_object = polynomial_hash_table();
   auto& hash = hash_object.ref;
+  Hash_counting<KL_hash_Table> counting(d_stats,hash);
 
   size_t minLength = length(first_hole()); // length of first new |y|
   size_t maxLength = length(limit<=size() ? limit-1 : size()-1);
@@ -875,34 +1338,45 @@ void KL_table::verbose_fill(BlockElt limit)
   std::time_t time;
 
   struct rusage usage; // holds resource usage report
-  size_t storesize = 0; // previous size of |storage_pool|
-  size_t polsize = 0; // running total of sum of (polynomial degrees+1)
 
-  size_t kl_size = 0;
+  size_t kl_size = 0, kl_mem = 0; // entries, and bytes used to store them
 
   try
   {
+    auto start = Fill_stats::clock::now();
     for (size_t l=minLength; l<=maxLength; ++l) // by length for progress report
     {
       BlockElt y_start = l==minLength ? first_hole() : length_less(l);
       BlockElt y_limit = l<maxLength ? length_less(l+1) : limit;
-      for (BlockElt y=y_start; y<y_limit; ++y)
+      if (n_threads>1)
       {
-	std::cerr << y << "\r";
-
-	fill_KL_column(klv,y,hash);
-	kl_size += d_KL[y].size();
-	d_holes.remove(y);
+	fill_stratum(y_start,y_limit,n_threads,hash);
+	for (BlockElt y=y_start; y<y_limit; ++y)
+	{
+	  kl_size += d_KL[y].size();
+	  kl_mem += d_KL[y].memory();
+	}
       }
+      else
+	for (BlockElt y=y_start; y<y_limit; ++y)
+	{
+	  if (d_holes.isMember(y)) // skip any columns computed on demand
+	  {
+	    std::cerr << y << "\r";
+
+	    fill_KL_column(klv,col,y,hash);
+	    d_holes.remove(y);
+	    ++d_stats.columns;
+	    report_progress();
+	  }
+	  kl_size += d_KL[y].size();
+	  kl_mem += d_KL[y].memory();
+	}
+      d_stats.add_time(l,start);
 
       // now length |l| is completed
       size_t p_capacity // currently used memory for polynomials storage
-	= hash.capacity()*sizeof(KLIndex)
-	+ storage_pool.capacity()*sizeof(KLPol);
-      for (size_t i=storesize; i<storage_pool.size(); ++i)
-	polsize+= (storage_pool[i].degree()+1)*sizeof(KLCoeff);
-      storesize = storage_pool.size(); // avoid recounting polynomials!
-      p_capacity += polsize;
+	= hash.capacity()*sizeof(KLIndex) + storage_pool.memory();
 
       std::cerr // << "t="    << std::setw(5) << deltaTime << "s.
 	<< "l=" << std::setw(3) << l // completed length
@@ -923,8 +1397,9 @@ void KL_table::verbose_fill(BlockElt limit)
 		<< " secs, Max res size="
 		<< std::setw(5) << resident << "MB, pmem="
 		<< std::setw(6) << p_capacity/1048576 << "MB, matmem="
+		<< std::setw(6) << kl_mem/1048576 << "MB (dense "
 		<< std::setw(6) << kl_size*sizeof(KLIndex)/1048576
-		<< "MB \n";
+		<< "MB)\n";
 
     } // for (l=min_length+1; l<=max_Length; ++l)
 
@@ -934,6 +1409,9 @@ void KL_table::verbose_fill(BlockElt limit)
     std::cerr << "Total elapsed time = " << deltaTime << "s." << std::endl;
     std::cerr << storage_pool.size() << " polynomials, "
 	      << kl_size << " matrix entries."<< std::endl;
+    const auto prim_mem = prim_index_memory();
+    std::cerr << "primitive index tables: " << prim_mem.first/1024
+	      << "KB (unpacked " << prim_mem.second/1024 << "KB)" << std::endl;
 
     std::cerr << std::endl;
 
@@ -968,14 +1446,15 @@ void KL_table::swallow
       BlockEltList pc(prims.begin(),prims.end());
       assert(sub.d_KL[z].size()==sub_pc.size());
       assert(desc == descent_set(embed[z]));
-      d_KL[embed[z]].resize(pc.size(),zero); // default to |zero|
+      std::vector<KLIndex> KL(pc.size(),zero); // default to |zero|
       for (unsigned int i=0; i<sub_pc.size(); ++i)
       {
 	unsigned int new_i = prim_index(embed[sub_pc[i]],desc);
 	assert(sub.prim_index(sub_pc[i],desc)==i); // |sub_pc[i]| is primitive
 	assert(prim_index(pc[new_i],desc)==new_i); // |pc[new_i]| is primitive
-	d_KL[embed[z]][new_i] = poly_trans[sub.d_KL[z][i]];
+	KL[new_i] = poly_trans[sub.d_KL[z][i]];
       }
+      d_KL[embed[z]] = KL_column(KL);
 
       for (auto& entry : sub.d_mu[z])
 	entry.x = embed[entry.x]; // renumber block elements (coef unchanged)
@@ -986,6 +1465,340 @@ void KL_table::swallow
 }
 
 
+/*
+  Checkpointing. A long computation by |fill| can save its completed columns
+  periodically, so that after an interruption (a reboot, or being killed for
+  using too much memory) it can be resumed by a new program run: build the same
+  block, call |read_checkpoint| on its (empty) |KL_table|, and call |fill|.
+  Since polynomials are read back in their original order, the result is
+  identical to that of an uninterrupted computation.
+
+  The file format, all in 4-byte little-endian values, is a header followed by
+  records. The header is |checkpoint_magic|, |checkpoint_version|, block size,
+  rank, the two halves of |block_fingerprint|, and the modulus. Each record is
+  |checkpoint_record_magic|, the number of bytes of the remainder of the
+  record, then the number of polynomials added to |storage_pool| since the
+  previous record followed by, for each polynomial, its number of coefficients
+  and those coefficients; finally the number of columns completed since the
+  previous record, followed by, for each column |y|, the value |y|, the size of
+  |d_KL[y]| and its entries, and the size of |d_mu[y]| and its entries as pairs
+  $(x,\mu(x,y))$. The first save by |fill| writes the file afresh, and later
+  saves just append a record; a truncated final record (we got killed while
+  appending) is ignored when reading.
+*/
+
+namespace {
+
+// a value that changes with (almost) any change to the structure of |block|
+std::uint64_t block_fingerprint (const Block_base& block)
+{
+  std::uint64_t h = 0xcbf29ce484222325ull; // FNV-1a, applied to 4-byte values
+  const auto mix = [&h] (std::uint64_t v) { h = (h^v)*0x100000001b3ull; };
+  for (BlockElt z=0; z<block.size(); ++z)
+  {
+    mix(block.length(z)); mix(block.x(z)); mix(block.y(z));
+    for (weyl::Generator s=0; s<block.rank(); ++s)
+    {
+      mix(block.descentValue(s,z));
+      mix(block.cross(s,z));
+      const BlockEltPair& C = block.any_Cayleys(s,z);
+      mix(C.first); mix(C.second);
+    }
+  }
+  return h;
+}
+
+} // |namespace|
+
+void KL_table::set_checkpoint
+  (const std::string& file_name, unsigned int interval)
+{
+  checkpoint_file = file_name; // empty name disables checkpointing
+  checkpoint_interval = interval;
+  std::time(&last_checkpoint);
+  checkpoint_started = false; // first save will (re)write the whole file
+}
+
+void KL_table::write_checkpoint (std::ostream& out) const
+{
+  write_checkpoint_header(out);
+  write_checkpoint_record(out,0,BitMap(size()));
+}
+
+void KL_table::write_checkpoint_header (std::ostream& out) const
+{
+  const std::uint64_t fingerprint = block_fingerprint(block());
+  basic_io::put_int(checkpoint_magic,out);
+  basic_io::put_int(checkpoint_version,out);
+  basic_io::put_int(size(),out);
+  basic_io::put_int(rank(),out);
+  basic_io::put_int(static_cast<unsigned int>(fingerprint),out);
+  basic_io::put_int(static_cast<unsigned int>(fingerprint>>32),out);
+  basic_io::put_int(d_modulus,out);
+  if (not out.good())
+    throw error::OutputError();
+}
+
+/*
+  Write polynomials from |first_poly| on, and completed columns not in |done|.
+  The record is assembled in memory first and then written in one piece, so
+  that being killed while writing leaves a record whose length field exceeds
+  what follows it in the file (or not even a complete length field).
+*/
+void KL_table::write_checkpoint_record
+  (std::ostream& file, KLIndex first_poly, const BitMap& done) const
+{
+  std::ostringstream out; // the body of the record
+
+  basic_io::put_int(storage_pool.size()-first_poly,out);
+  for (KLIndex i=first_poly; i<storage_pool.size(); ++i)
+  {
+    const KLPolRef P = storage_pool[i];
+    basic_io::put_int(P.size(),out);
+    for (polynomials::Degree j=0; j<P.size(); ++j)
+      basic_io::put_int(P[j],out);
+  }
+
+  BlockElt n_columns=0;
+  for (BlockElt y=0; y<size(); ++y)
+    if (not d_holes.isMember(y) and not done.isMember(y))
+      ++n_columns;
+
+  basic_io::put_int(n_columns,out);
+  for (BlockElt y=0; y<size(); ++y)
+    if (not d_holes.isMember(y) and not done.isMember(y))
+    {
+      basic_io::put_int(y,out);
+      const KL_column& KL = d_KL[y];
+      basic_io::put_int(KL.size(),out);
+      for (unsigned int i=0; i<KL.size(); ++i)
+	basic_io::put_int(KL[i],out);
+      basic_io::put_int(d_mu[y].size(),out);
+      for (const auto& pair : d_mu[y])
+      {
+	basic_io::put_int(pair.x,out);
+	basic_io::put_int(pair.coef,out);
+      }
+    }
+
+  const std::string body = out.str();
+  std::ostringstream head;
+  basic_io::put_int(checkpoint_record_magic,head);
+  basic_io::put_int(static_cast<unsigned int>(body.size()),head);
+  const std::string record = head.str()+body;
+  file.write(record.data(),record.size());
+
+  if (not file.good())
+    throw error::OutputError();
+}
+
+/*
+  Add the columns from a checkpoint written by |write_checkpoint| for the same
+  block to our table. Polynomials are translated through our hash table, which
+  for a fresh table reproduces the original numbering. Columns already present
+  in our table are skipped.
+
+  Every count read is checked against the number of bytes that remain in its
+  record before anything is allocated for it, and each record is validated
+  completely before any of its columns are installed, so a corrupted file gives
+  an error (with possibly the columns of earlier records added) but never
+  causes an inconsistent table or a huge allocation.
+*/
+BlockElt KL_table::read_checkpoint (std::istream& in)
+{
+  in.seekg(0,std::ios_base::end);
+  const std::streamoff file_size = in.tellg();
+  in.seekg(0,std::ios_base::beg);
+  if (file_size<0 or not in.good())
+    throw std::runtime_error("Cannot determine size of KL checkpoint file");
+
+  std::streamoff left = file_size; // bytes we may still read in current part
+  const auto get = [&in,&left] () -> unsigned int
+  {
+    if (left<4)
+      throw std::runtime_error("Corrupted KL checkpoint file");
+    left -= 4;
+    return basic_io::read_bytes<4>(in);
+  };
+  // get a count of items of at least |item_size| bytes each that follow
+  const auto get_count = [&get,&left] (unsigned int item_size) -> unsigned int
+  {
+    const unsigned int n = get();
+    if (n>left/item_size)
+      throw std::runtime_error("Corrupted KL checkpoint file");
+    return n;
+  };
+
+  if (file_size<4 or get()!=checkpoint_magic)
+    throw std::runtime_error("Not a KL checkpoint file");
+  if (get()!=checkpoint_version)
+    throw std::runtime_error("Unsupported KL checkpoint format version");
+  if (get()!=size() or get()!=rank())
+    throw std::runtime_error("KL checkpoint is for a different block");
+  {
+    const std::uint64_t fingerprint = block_fingerprint(block());
+    const unsigned int low = get(); // order of evaluation matters here
+    if (low!=static_cast<unsigned int>(fingerprint) or
+	get()!=static_cast<unsigned int>(fingerprint>>32))
+      throw std::runtime_error("KL checkpoint is for a different block");
+  }
+  if (get()!=d_modulus)
+    throw std::runtime_error("KL checkpoint is for a different modulus");
+
+  const auto hash_object = polynomial_hash_table();
+  auto& hash = hash_object.ref;
+
+  std::vector<KLIndex> poly_trans; // file numbering to our numbering
+  std::vector<KLPol> new_polys;
+  std::vector<KLCoeff> coefs;
+  std::vector<BlockElt> new_y;
+  std::vector<std::vector<KLIndex> > new_KL;
+  std::vector<Mu_column> new_mu;
+
+  BlockElt count=0;
+  while (left>0)
+  {
+    if (left<8)
+      break; // truncated record header, ignore
+    if (get()!=checkpoint_record_magic)
+      throw std::runtime_error("Corrupted KL checkpoint file");
+    const std::streamoff length = get();
+    if (length<8 or length>left) // a record holds at least its two counts
+      break; // truncated final record (written while being killed), ignore
+    const std::streamoff after = left-length; // what remains after this record
+    left = length; // limit reading to this record
+
+    new_polys.clear();
+    for (unsigned int n=get_count(4); n-->0; )
+    {
+      coefs.resize(get_count(4));
+      for (auto& c : coefs)
+	c = get();
+      if (not coefs.empty() and
+	  (coefs.back()==0 or
+	   (d_modulus!=0 and
+	    std::any_of(coefs.begin(),coefs.end(),
+			[this](KLCoeff c) { return c>=d_modulus; }))))
+	throw std::runtime_error("Corrupted KL checkpoint file");
+      KLPol P = coefs.empty() ? Zero : KLPol(coefs.size()-1,coefs.back());
+      for (unsigned int j=0; j+1<coefs.size(); ++j)
+	P[j] = coefs[j];
+      new_polys.push_back(std::move(P));
+    }
+
+    const size_t n_polys = poly_trans.size()+new_polys.size();
+    new_y.clear(); new_KL.clear(); new_mu.clear();
+    for (unsigned int n=get_count(12); n-->0; ) // 3 counts per column at least
+    {
+      const BlockElt y = get();
+      if (y>=size())
+	throw std::runtime_error("Corrupted KL checkpoint file");
+      std::vector<KLIndex> col(get_count(4));
+      for (auto& index : col)
+	if ((index=get())>=n_polys)
+	  throw std::runtime_error("Corrupted KL checkpoint file");
+      Mu_column mu_col; mu_col.reserve(get_count(8));
+      for (unsigned int i=mu_col.capacity(); i-->0; )
+      {
+	const BlockElt x=get(); // order of evaluation matters here
+	const KLCoeff mu=get();
+	if (x>=y or mu==0 or (not mu_col.empty() and x<=mu_col.back().x))
+	  throw std::runtime_error("Corrupted KL checkpoint file");
+	mu_col.emplace_back(x,mu);
+      }
+      prepare_prim_index(descent_set(y)); // so looking up |KL_pol(x,y)| is OK
+      if (col.size()!=col_size(y))
+	throw std::runtime_error("Corrupted KL checkpoint file");
+      new_y.push_back(y);
+      new_KL.push_back(std::move(col));
+      new_mu.push_back(std::move(mu_col));
+    }
+    if (left!=0 or not in.good())
+      throw std::runtime_error("Corrupted KL checkpoint file");
+    left = after;
+
+    // the record is valid; now install it
+    for (const auto& P : new_polys)
+      poly_trans.push_back(hash.match(P));
+    for (unsigned int i=0; i<new_y.size(); ++i)
+    {
+      const BlockElt y = new_y[i];
+      if (d_holes.isMember(y))
+      {
+	for (auto& index : new_KL[i])
+	  index = poly_trans[index];
+	d_KL[y] = KL_column(new_KL[i]);
+	d_mu[y].swap(new_mu[i]);
+	d_holes.remove(y);
+	++count;
+      }
+    }
+  }
+  return count;
+} // |KL_table::read_checkpoint|
+
+void KL_table::report_progress()
+{
+  if (observer!=nullptr)
+    observer->columns_completed(*this);
+  checkpoint_if_due();
+}
+
+void KL_table::checkpoint_if_due()
+{
+  if (checkpoint_file.empty())
+    return;
+  std::time_t now; std::time(&now);
+  if (std::difftime(now,last_checkpoint)<checkpoint_interval)
+    return;
+  save_checkpoint();
+  last_checkpoint = now;
+}
+
+/*
+  The first save writes a temporary file and renames it, so that a previous
+  checkpoint file is replaced only by a complete one, even if we get killed
+  while writing. Later saves append a record with just the new polynomials and
+  columns; being killed while doing so leaves a truncated record that
+  |read_checkpoint| ignores.
+*/
+void KL_table::save_checkpoint()
+{
+  if (checkpoint_started)
+  {
+    std::fstream out(checkpoint_file.c_str(),
+		     std::ios_base::in | std::ios_base::out
+		     | std::ios_base::binary);
+    if (not out.is_open())
+      throw std::runtime_error("Cannot open KL checkpoint file "
+			       +checkpoint_file);
+    out.seekp(0,std::ios_base::end);
+    try { write_checkpoint_record(out,checkpoint_polys,checkpoint_columns); }
+    catch (...) { checkpoint_started=false; throw; } // next save rewrites all
+  }
+  else
+  {
+    const std::string temp_name = checkpoint_file + ".tmp";
+    {
+      std::ofstream out(temp_name.c_str(),
+			std::ios_base::out
+			| std::ios_base::trunc
+			| std::ios_base::binary);
+      if (not out.is_open())
+	throw std::runtime_error("Cannot open KL checkpoint file "+temp_name);
+      write_checkpoint(out);
+    } // close |out|, flushing buffers
+    if (std::rename(temp_name.c_str(),checkpoint_file.c_str())!=0)
+      throw std::runtime_error("Cannot rename KL checkpoint file "+temp_name);
+    checkpoint_started = true;
+  }
+
+  checkpoint_polys = storage_pool.size();
+  checkpoint_columns = d_holes;
+  ~checkpoint_columns; // complement in place: the columns now in the file
+}
+
+
 /*****************************************************************************
 
         Chapter V -- Functions declared in kl.h
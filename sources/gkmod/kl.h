@@ -17,10 +17,18 @@
 
 #include <limits>
 #include <set>
+#include <string>
+#include <iosfwd>
+#include <ctime>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 #include "../Atlas.h"
 
 #include "bitmap.h"
+#include "bits.h"	// for |bits::bitCount| in |KL_column::operator[]|
 #include "klsupport.h"	// containment
 #include "polynomials.h"// containment
 
@@ -36,7 +44,7 @@ wgraph::WGraph wGraph(const KL_table&);
 
 /******** type definitions **************************************************/
 
-/* Namely: the definition of KL_table itself */
+/* Namely: the definition of KL_table itself, and of its column type */
 
 struct Mu_pair
 { BlockElt x; MuCoeff coef;
@@ -44,10 +52,123 @@ struct Mu_pair
   bool operator< (const Mu_pair& other) const { return x<other.x; }
 };
 
-using KL_column = std::vector<KLIndex>;
+/*
+  A column of the KL table: polynomial indices for the primitive elements |x|
+  for some |y|. For large blocks most of them are the index |0| of the zero
+  polynomial, so we store a bitmap of the positions of nonzero entries, for
+  each word of that bitmap the number of nonzero entries before it, and the
+  nonzero entries themselves. Look-up takes constant time, using a bit count.
+*/
+class KL_column
+{
+  std::vector<std::uint64_t> d_bits; // bit |i%64| of |d_bits[i/64]|: entry |i|
+  std::vector<unsigned int> d_before; // nonzero entries before each word
+  std::vector<KLIndex> d_nonzero; // the nonzero entries, in order
+  unsigned int d_size; // the number of entries
+
+ public:
+  KL_column () : d_bits(), d_before(), d_nonzero(), d_size(0) {}
+  explicit KL_column (const std::vector<KLIndex>& entries); // compress these
+
+  unsigned int size () const { return d_size; }
+  size_t nonzero_count () const { return d_nonzero.size(); }
+  KLIndex operator[] (unsigned int i) const
+  { assert(i<d_size);
+    const std::uint64_t word = d_bits[i>>6], bit = std::uint64_t(1)<<(i&63);
+    return (word&bit)==0 ? KLIndex(0)
+      : d_nonzero[d_before[i>>6]+bits::bitCount(word&(bit-1))];
+  }
+
+  size_t memory () const; // bytes of storage used, for statistics
+
+  void clear () { KL_column().swap(*this); } // also release storage
+  void swap (KL_column& other)
+  { d_bits.swap(other.d_bits); d_before.swap(other.d_before);
+    d_nonzero.swap(other.d_nonzero); std::swap(d_size,other.d_size);
+  }
+}; // |class KL_column|
+
 using Mu_column = std::vector<Mu_pair>;
 using Mu_list = containers::sl_list<Mu_pair>;
 
+/*
+  Counters describing the work done while filling a table of KL polynomials,
+  accumulated over all calls of |fill|; also used for |ext_kl::KL_table|. They
+  allow telling whether a computation is dominated by hashing or by recursion.
+*/
+struct Fill_stats
+{
+  using clock = std::chrono::steady_clock;
+
+  BlockElt columns; // number of columns computed
+  size_t lookups; // polynomials looked up in the hash table
+  size_t interned; // those lookups that added a new polynomial
+  size_t rehashes; // number of times (a shard of) the hash table was enlarged
+  size_t hash_slots; // size of the hash table at the end of the latest fill
+  std::vector<double> seconds; // time spent computing columns, by length
+
+  Fill_stats ()
+  : columns(0), lookups(0), interned(0), rehashes(0), hash_slots(0), seconds()
+  {}
+
+  void add_time (size_t length, clock::time_point& start) // and restart clock
+  { const auto now = clock::now();
+    if (seconds.size()<=length)
+      seconds.resize(length+1,0.0);
+    seconds[length] += std::chrono::duration<double>(now-start).count();
+    start = now;
+  }
+}; // |struct Fill_stats|
+
+// while in scope, record what happens to the counters of |hash| in |stats|
+template<typename Hash> class Hash_counting
+{
+  Fill_stats& stats;
+  const Hash& hash;
+  const size_t lookups, size, rehashes; // values at construction
+ public:
+  Hash_counting(Fill_stats& stats, const Hash& hash)
+  : stats(stats), hash(hash)
+  , lookups(hash.lookups()), size(hash.size()), rehashes(hash.rehashes()) {}
+  ~Hash_counting()
+  { stats.lookups += hash.lookups()-lookups;
+    stats.interned += hash.size()-size;
+    stats.rehashes += hash.rehashes()-rehashes;
+    stats.hash_slots = hash.capacity();
+  }
+}; // |class Hash_counting|
+
+/*
+  While in scope, owns the duty to join the threads in |threads|. Leaving the
+  scope by an exception, for instance when starting one of them failed, would
+  otherwise destroy threads that are still joinable, which terminates the
+  program.
+*/
+class Thread_joiner
+{
+  std::vector<std::thread>& threads;
+ public:
+  explicit Thread_joiner(std::vector<std::thread>& threads)
+  : threads(threads) {}
+  ~Thread_joiner()
+  { for (auto& thread : threads)
+      if (thread.joinable())
+	thread.join();
+  }
+}; // |class Thread_joiner|
+
+/*
+  An object that |KL_table::fill| informs whenever the table is in a coherent
+  state after completing some columns, for instance to write those columns out
+  while the computation proceeds. It is called from the thread calling |fill|.
+*/
+class Fill_observer
+{
+ public:
+  virtual ~Fill_observer () {}
+  virtual void columns_completed (const KL_table& table) = 0;
+}; // |class Fill_observer|
+
 struct Poly_hash_export // auxiliary to export possibly temporary hash table
 {
   std::unique_ptr<KL_hash_Table> own; // maybe own the temporary
@@ -80,6 +201,22 @@ class KL_table
 
   const KLStore& storage_pool;
 
+  const KLCoeff d_modulus; // if nonzero, coefficients are reduced modulo this
+
+  std::string checkpoint_file; // if nonempty, |fill| saves its progress here
+  unsigned int checkpoint_interval; // minimal number of seconds between saves
+  std::time_t last_checkpoint; // when progress was last saved (or fill began)
+  bool checkpoint_started; // whether |checkpoint_file| was written since set
+  KLIndex checkpoint_polys; // number of polynomials already in that file
+  BitMap checkpoint_columns; // columns already in that file
+
+  Fill_observer* observer; // if set, informed of completed columns by |fill|
+
+  Fill_stats d_stats; // what |fill| has done so far
+
+  KL_hash_Table* demand_hash; // during |fill_column|, the hash table to use
+  Fill_stats::clock::time_point demand_start; // for timing |fill_column|
+
   // the constructors will ensure that |d_store| contains 0, 1 at beginning
   enum { zero = 0, one  = 1 }; // indices of polynomials 0,1 in |d_store|
   // use |enum| rather than |static constxepr KLIndex|: avoid any references
@@ -95,6 +232,8 @@ class KL_table
 
 // constructors and destructors
   KL_table(const Block_base&, KL_hash_Table* pol_hash=nullptr);
+  // a table computing modulo |modulus|, which must be odd; it owns its storage
+  KL_table(const Block_base&, KLCoeff modulus);
 
 // accessors
 
@@ -117,6 +256,8 @@ class KL_table
   MuCoeff mu(BlockElt x, BlockElt y) const; // $\mu(x,y)$
 
 
+  KLCoeff modulus() const { return d_modulus; } // 0 for exact computation
+
   // List of all non-zero KL polynomials for the block, in generation order
   const KLStore& pol_store() const { return storage_pool; }
 
@@ -128,13 +269,36 @@ class KL_table
   // get bitmap of primitive elements for column |y| with nonzero KL polynomial
   BitMap prim_map (BlockElt y) const;
 
+  // bytes used by the completed columns, and what plain vectors would use
+  std::pair<size_t,size_t> column_memory () const;
+  // all bytes held by the table, including polynomials only if it owns them
+  size_t memory () const;
+
+  const Fill_stats& stats() const { return d_stats; }
+
 // manipulators
 
   // partial fill, up to column |limit| exclusive; fill all if |limit==0|
-  void fill (BlockElt limit=0, bool verbose=false);
+  // columns of equal length are computed concurrently if |n_threads!=1|
+  void fill (BlockElt limit=0, bool verbose=false, unsigned int n_threads=1);
+
+  // the same, but by Chinese remaindering from tables computed modulo |moduli|
+  void fill_by_CRT (const std::vector<KLCoeff>& moduli, BlockElt limit=0,
+		    bool verbose=false, unsigned int n_threads=1);
+
+  // compute just column |y| and the columns it depends on, if not done yet
+  void fill_column (BlockElt y);
 
   Poly_hash_export polynomial_hash_table ();
 
+  // make |fill| save progress to |file_name| every |interval| seconds or so
+  void set_checkpoint (const std::string& file_name, unsigned int interval);
+  void write_checkpoint (std::ostream& out) const; // all completed columns
+  BlockElt read_checkpoint (std::istream& in); // returns number of columns added
+
+  // make |fill| report completed columns to |obs| (not owned); |nullptr| stops
+  void set_fill_observer (Fill_observer* obs) { observer=obs; }
+
   void swallow (KL_table&& sub, const BlockEltList& embed, KL_hash_Table& hash);
 
   // private methods used during construction
@@ -147,20 +311,44 @@ class KL_table
     first_endgame_pair(BlockElt x, BlockElt y) const;
   BlockEltPair inverse_Cayley(weyl::Generator s, BlockElt y) const;
 
-  // manipulators
-  void silent_fill(BlockElt limit); // called by public |fill| when not verbose
-  void verbose_fill(BlockElt limit); // called by public |fill| when verbose
+  // arithmetic of the recursion, modulo |d_modulus| if that is nonzero, and
+  // otherwise exact (but throwing on overflow); |p| may also be a |KLPolRef|
+  template<typename P> void add // |a += c*q^d*p|
+    (KLPol& a, const P& p, polynomials::Degree d=0, KLCoeff c=1) const;
+  template<typename P> void subtract // |a -= c*q^d*p|
+    (KLPol& a, const P& p, polynomials::Degree d=0, KLCoeff c=1) const;
+  void divide(KLPol& a, KLCoeff c) const;
+  void quotient_by_1_plus_q(KLPol& a, polynomials::Degree delta) const;
 
-  void fill_KL_column(std::vector<KLPol>& klv, BlockElt y, KL_hash_Table& hash);
+  // manipulators
+  void silent_fill(BlockElt limit, unsigned int n_threads); // not verbose
+  void verbose_fill(BlockElt limit, unsigned int n_threads); // when verbose
+  void fill_stratum(BlockElt y_start, BlockElt y_limit, unsigned int n_threads,
+		    KL_hash_Table& hash); // concurrently, for one length
+
+  void demand_column(BlockElt y); // compute hole |y| within |fill_column|
+  void need_column(BlockElt z) // ensure column |z| is present before use
+  { if (demand_hash!=nullptr and d_holes.isMember(z)) demand_column(z); }
+  void fill_KL_column(std::vector<KLPol>& klv, std::vector<KLPol>& col,
+		      BlockElt y, KL_hash_Table& hash);
+  bool compute_KL_column(std::vector<KLPol>& klv, std::vector<KLPol>& col,
+			 BlockElt y); // fills |d_mu[y]| but not |d_KL[y]|
+  void store_KL_column(BlockElt y, const std::vector<KLPol>& col,
+		       bool backwards, KL_hash_Table& hash);
+  void report_progress(); // called whenever the table is in a coherent state
+  void checkpoint_if_due(); // called by |report_progress|
+  void save_checkpoint(); // write or append to |checkpoint_file| (safely)
+  void write_checkpoint_header (std::ostream& out) const;
+  void write_checkpoint_record
+    (std::ostream& out, KLIndex first_poly, const BitMap& done) const;
   void recursion_column(BlockElt y, weyl::Generator s,
 			std::vector<KLPol>& klv);
   void mu_correction(const BlockEltList& extremals,
 		     RankFlags desc_y, BlockElt sy, weyl::Generator s,
 		     std::vector<KLPol>& klv);
-  void complete_primitives(const std::vector<KLPol>& klv, BlockElt y,
-			   KL_hash_Table& hash);
-  void new_recursion_column(std::vector<KLPol>& klv, BlockElt y,
-			    KL_hash_Table& hash);
+  void complete_primitives(std::vector<KLPol>& klv, BlockElt y,
+			   std::vector<KLPol>& col);
+  void new_recursion_column(std::vector<KLPol>& col, BlockElt y);
   KLPol mu_new_formula
     (BlockElt x, BlockElt y, weyl::Generator s, const Mu_list& muy);
 
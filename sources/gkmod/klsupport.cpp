@@ -15,6 +15,7 @@
 */
 
 #include <cassert>
+#include <algorithm> // for |std::lower_bound|
 #include "klsupport.h"
 
 /*
@@ -104,12 +105,23 @@ KLSupport::KLSupport(const Block_base& b)
   mean we will have to store null polynomials at primitive elements to ensure
   everything is at its predicted place, while such (fairly common) polynomials
   could be suppressed when using pairs $(x,P_{x,y})$ and binary search on $x$.
+
+  Only the initial part of |index| that can be looked up is kept: for lookups
+  |prim_index(x,A)| one always has |x<=y| for some |y| with |descent_set(y)==A|,
+  or if not the result is not used other than to be found out of range for the
+  column of |y|, which |range| is as well. The remaining values are packed into
+  fields of just enough bits to hold |range|; for large blocks this reduces the
+  size of these tables, which may exist for up to $2^r$ descent sets, severalfold.
+
+  We also record the extremal elements for |A|, those whose descent set
+  contains |A|, so that finding those below some length needs no scan of the
+  block; this uses much less space than |index|.
 */
 
 void KLSupport::fill_prim_index(RankFlags descs)
 {
   prim_index_tp& record=d_prim_index[descs.to_ulong()];
-  record.index.resize(d_block.size()); // create slots; we will fill backwards
+  std::vector<unsigned int> index(d_block.size()); // we will fill backwards
 
   unsigned int count = 0; // count primitives seen
   constexpr unsigned int dead_end = -1; // signals "no valid index" temporarily
@@ -117,7 +129,7 @@ void KLSupport::fill_prim_index(RankFlags descs)
   {
     // store index of primitivized |x| among primitives for |RankFlags(descs)|
     // since |x| is decreasing, initially count _larger_ primitive elements
-    auto& dest = record.index[x]; // the slot to fill during this iteration
+    auto& dest = index[x]; // the slot to fill during this iteration
     RankFlags a = good_ascent_set(x) & descs;
     if (a.none())
     { // then |x| is primitive, record its index
@@ -132,19 +144,61 @@ void KLSupport::fill_prim_index(RankFlags descs)
     else
     {
       auto sz = d_block.unique_ascent(s,x);
-      dest = sz==UndefBlock ? dead_end : record.index[sz];
+      dest = sz==UndefBlock ? dead_end : index[sz];
     }
   } // |for(x-->0)|
 
   record.range = count;
+  record.width = 0;
+  while (record.width<32 and count>>record.width!=0)
+    ++record.width; // now |record.range| fits into |record.width| bits
+
+  record.limit = d_block.size();
+  while (record.limit>0 and descent_set(record.limit-1)!=descs)
+    --record.limit; // make |record.limit-1| last element with |descs|
+
+  record.packed.assign((size_t(record.limit)*record.width+63)/64+1,0); // padded
   const BlockElt last=count-1;
-  for (unsigned int& slot : record.index)
-    slot = slot==dead_end ? record.range : last-slot; // reverse indices
+  for (BlockElt x=0; x<record.limit; ++x)
+  {
+    const unsigned long long v = // reverse indices, or |range| for dead end
+      index[x]==dead_end ? record.range : last-index[x];
+    const size_t pos = size_t(x)*record.width;
+    const unsigned int offset = pos%64;
+    record.packed[pos/64] |= v<<offset;
+    if (offset+record.width>64) // then the field straddles two words
+      record.packed[pos/64+1] |= v>>(64-offset);
+  }
+
+  record.extremals.clear();
+  for (BlockElt x=0; x<d_block.size(); ++x)
+    if (is_extremal(x,descs))
+      record.extremals.push_back(x);
+  record.extremals.shrink_to_fit();
 
 } // |fill_prim_index|
 
 /******** accessors **********************************************************/
 
+// number of elements extremal for |descent_set| of length less than |l|
+unsigned int KLSupport::n_extremals (size_t l, RankFlags descent_set) const
+{
+  const BlockEltList& list = extremals(descent_set);
+  return std::lower_bound(list.begin(),list.end(),length_less(l))-list.begin();
+}
+
+std::pair<size_t,size_t> KLSupport::prim_index_memory () const
+{
+  size_t packed=0, plain=0;
+  for (const auto& record : d_prim_index)
+    if (record.range!=static_cast<unsigned int>(-1))
+    {
+      packed += record.packed.capacity()*sizeof(unsigned long long);
+      plain += size()*sizeof(unsigned int);
+    }
+  return std::make_pair(packed,plain);
+}
+
 #if 0
 /*
   Find for |x| a primitive element for |d| above it, returning that value, or
@@ -40,11 +40,29 @@ class KLSupport
   std::vector<Elt_info> info;
   std::vector<BlockElt> length_stop; // |length_stop[l]| is first of length |l|
 
+  /* The map from |BlockElt| to index of its primitivisation is stored only
+     below |limit|, one past the last element with this descent set (no
+     queries go beyond it), and packed using |width| bits for each value.
+  */
   struct prim_index_tp
   {
-    std::vector<unsigned int> index; // from |BlockElt| to index of prim'zed
+    std::vector<unsigned long long> packed; // |limit| fields, plus a word
+    BlockElt limit; // elements from here on map to |range| (a dead end)
     unsigned int range; // number of primitive elements for this descen set
-  prim_index_tp() : index(), range(-1) {}
+    unsigned int width; // number of bits needed to represent |range|
+    BlockEltList extremals; // increasing list of extremal elements for it
+  prim_index_tp() : packed(), limit(0), range(-1), width(0), extremals() {}
+
+    unsigned int operator[] (BlockElt x) const
+    { if (x>=limit) // includes |x==UndefBlock|
+	return range;
+      const size_t pos = static_cast<size_t>(x)*width;
+      const unsigned int offset = pos%64;
+      // combine with next word (there is always one) in case field straddles
+      const unsigned long long v =
+	packed[pos/64]>>offset | packed[pos/64+1]<<1<<(63-offset);
+      return v & ((1ull<<width)-1);
+    }
   };
   std::vector<prim_index_tp> d_prim_index; // indexed by descent set number
 
@@ -101,7 +119,7 @@ class KLSupport
   unsigned int prim_index (BlockElt x, RankFlags descent_set) const
   { const prim_index_tp& record=d_prim_index[descent_set.to_ulong()];
     assert(record.range!=static_cast<unsigned int>(-1));
-    return x==UndefBlock ? record.range : record.index[x];
+    return record[x];
   }
 
   unsigned int nr_of_primitives (RankFlags descent_set) const
@@ -110,6 +128,15 @@ class KLSupport
     return record.range;
   }
 
+  // increasing list of all elements extremal for |descent_set|; those of
+  // length less than |l| form the initial part of length |n_extremals(l,A)|
+  const BlockEltList& extremals (RankFlags descent_set) const
+  { const prim_index_tp& record=d_prim_index[descent_set.to_ulong()];
+    assert(record.range!=static_cast<unsigned int>(-1));
+    return record.extremals;
+  }
+  unsigned int n_extremals (size_t l, RankFlags descent_set) const;
+
   // this is where an element |y| occurs in its "own" primitive row
   unsigned int self_index (BlockElt y) const
   { return prim_index(y,descent_set(y)); }
@@ -148,6 +175,9 @@ class KLSupport
 
   void fill_prim_index(RankFlags A);
 
+  // memory used by the |prim_index| tables, and what plain vectors would use
+  std::pair<size_t,size_t> prim_index_memory() const;
+
 #ifndef NDEBUG
   void check_sub(const KLSupport& sub, const BlockEltList& embed);
 #endif
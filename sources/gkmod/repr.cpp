@@ -13,6 +13,8 @@
 #include <map> // used in computing |reducibility_points|
 #include <algorithm> // for |make_heap|
 #include <iostream> // for progress reports and easier debugging
+#include <fstream> // for deformation files
+#include <cstdio> // for |std::rename|
 #include "error.h"
 
 #include "arithmetic.h"
@@ -908,26 +910,28 @@ bool Rep_context::compare::operator()
 
 SR_poly Rep_context::scale(const poly& P, const Rational& f) const
 {
-  poly result;
+  std::vector<std::pair<StandardRepr,Split_integer> > terms;
+  terms.reserve(P.size()); // usually there is one final per term of |P|
   for (auto it=P.begin(); it!=P.end(); ++it)
   { auto z=it->first; // take a copy for modification
     auto finals = finals_for(scale(z,f));
-    for (const StandardRepr& final : finals)
-      result.add_term(final,it->second);
+    for (StandardRepr& final : finals)
+      terms.emplace_back(std::move(final),it->second);
   }
-  return result;
+  return poly(std::move(terms)); // sorts, and combines equal parameters
 }
 
 SR_poly Rep_context::scale_0(const poly& P) const
 {
-  poly result;
+  std::vector<std::pair<StandardRepr,Split_integer> > terms;
+  terms.reserve(P.size()); // usually there is one final per term of |P|
   for (auto it=P.begin(); it!=P.end(); ++it)
   { auto z=it->first; // take a copy for modification
     auto finals = finals_for(scale_0(z));
-    for (const StandardRepr& final : finals)
-      result.add_term(final,it->second);
+    for (StandardRepr& final : finals)
+      terms.emplace_back(std::move(final),it->second);
   }
-  return result;
+  return poly(std::move(terms)); // sorts, and combines equal parameters
 }
 
 containers::sl_list<StandardRepr>
@@ -1070,6 +1074,11 @@ Rep_table::Rep_table(RealReductiveGroup &G)
 , KL_poly_pool{KLPol(),KLPol(KLCoeff(1))}, KL_poly_hash(KL_poly_pool)
 , poly_pool{ext_kl::Pol(0),ext_kl::Pol(1)}, poly_hash(poly_pool)
 , block_list(), place()
+, twisted_sum_pool(), twisted_sum_hash(twisted_sum_pool), twisted_sums()
+, twisted_sum_hits(0)
+, n_threads(1)
+, usage(), budget(0), block_bytes(0), use_count(0), last_used(nullptr)
+, evictions(0)
 {}
 Rep_table::~Rep_table() = default;
 
@@ -1112,7 +1121,7 @@ public:
 blocks::common_block& Rep_table::add_block_below
   (const common_context& ctxt, const StandardReprMod& srm, BitMap* subset)
 {
-  assert(mod_hash.find(srm)==mod_hash.empty); // otherwise don't call us
+  assert(not is_placed(mod_hash.find(srm))); // otherwise don't call us
   Bruhat_generator gen(this,ctxt); // object to help generating Bruhat interval
   const auto prev_size = mod_pool.size(); // limit of previously known elements
   containers::sl_list<unsigned long> elements(gen.block_below(srm)); // generate
@@ -1121,7 +1130,7 @@ blocks::common_block& Rep_table::add_block_below
     std::pair<blocks::common_block*,containers::sl_list<BlockElt> >;
   containers::sl_list<sub_pair> sub_blocks;
   for (auto z : elements)
-    if (z<prev_size) // then |z| was already known as a partial block element
+    if (z<prev_size and is_placed(z)) // then |z| is in a known partial block
     { // record block pointer and index of |z| in block into |sub_blocks|
       const auto block_p = &*place[z].first;
       const BlockElt z_rel = place[z].second;
@@ -1332,6 +1341,9 @@ containers::simple_list<unsigned long> Rep_table::Bruhat_generator::block_below
   return results.front();
 } // |Rep_table::Bruhat_generator::block_below|
 
+bool Rep_table::is_placed (unsigned long h) const
+{ return h<place.size() and place[h].second!=UndefBlock; }
+
 // erase node in |block_list| after |pos|, avoiding dangling iterators in |place|
 void Rep_table::block_erase (bl_it pos)
 {
@@ -1352,6 +1364,14 @@ void Rep_table::block_erase (bl_it pos)
 	place[seq].first=pos; // replace iterator that is about to be invalidated
     }
   }
+  const auto it = usage.find(&*pos);
+  if (it!=usage.end())
+  {
+    block_bytes -= it->second.bytes;
+    usage.erase(it);
+  }
+  if (last_used==&*pos)
+    last_used=nullptr;
   block_list.erase(pos);
 } // |Rep_table::block_erase|
 
@@ -1370,6 +1390,8 @@ unsigned long Rep_table::add_block(const StandardReprMod& srm)
     auto seq = mod_hash.match(block.representative(z));
     if (seq==place.size()) // block element is new
       place.emplace_back(bl_it(),z); // iterator filled later
+    else if (not is_placed(seq)) // element of a block that was evicted
+      place[seq] = std::make_pair(bl_it(),z); // iterator filled later
     else
     {
       auto& sub_block = *place[seq].first;
@@ -1416,12 +1438,12 @@ blocks::common_block& Rep_table::lookup_full_block (StandardRepr& sr,BlockElt& z
   make_dominant(sr); // without this we would not be in any valid block
   auto srm = StandardReprMod::mod_reduce(*this,sr); // modular |z|
   auto h=mod_hash.find(srm); // look up modulo translation in $X^*$
-  if (h==mod_hash.empty or not place[h].first->is_full()) // then we must
+  if (not is_placed(h) or not place[h].first->is_full()) // then we must
     h=add_block(srm); // generate a new full block (possibly swalllow older ones)
   assert(h<place.size() and place[h].first->is_full());
 
   z = place[h].second;
-  return *place[h].first;
+  return use_block(*place[h].first);
 
 } // |Rep_table::lookup_full_block|
 
@@ -1431,20 +1453,117 @@ blocks::common_block& Rep_table::lookup (StandardRepr& sr,BlockElt& which)
   auto srm = StandardReprMod::mod_reduce(*this,sr); // modular |z|
   assert(mod_hash.size()==place.size()); // should be in sync at this point
   auto h=mod_hash.find(srm); // look up modulo translation in $X^*$
-  if (h!=mod_hash.empty) // then we are in a new translation family of blocks
+  if (is_placed(h)) // then we are in a known translation family of blocks
   {
-    assert(h<place.size()); // it cannot be |mod_hash.empty| anymore
     which = place[h].second;
-    return *place[h].first;
+    return use_block(*place[h].first);
   }
   common_context ctxt(real_group(),SubSystem::integral(root_datum(),sr.gamma()));
   BitMap subset;
   auto& block= add_block_below(ctxt,srm,&subset); // ensure block is known
   which = last(subset);
   assert(block.representative(which)==srm);
-  return block;
+  return use_block(block);
 } // |Rep_table::lookup|
 
+void Rep_table::set_block_budget (size_t bytes)
+{
+  budget=bytes;
+  usage.clear(); block_bytes=0; last_used=nullptr;
+  if (budget==0)
+    return; // no need to keep track of anything
+  for (const auto& block : block_list) // older blocks come first
+  {
+    const size_t size = block.memory();
+    usage.emplace(&block,block_usage{++use_count,size,block.fill_count()});
+    block_bytes += size;
+  }
+  trim_blocks(nullptr);
+}
+
+std::vector<size_t> Rep_table::block_memory () const
+{
+  std::vector<size_t> result; result.reserve(block_list.size());
+  for (const auto& block : block_list)
+    result.push_back(block.memory());
+  return result;
+}
+
+// blocks grow after being returned by |lookup|, so we check for growth when
+// the next block is requested, which also gives the moment to enforce |budget|;
+// blocks are only referred to during one (non recursive) call, so no block
+// other than the one now returned needs to be kept
+blocks::common_block& Rep_table::use_block (blocks::common_block& block)
+{
+  if (budget==0)
+    return block;
+  if (last_used!=nullptr)
+    measure(last_used); // only it can have grown since the previous call
+  auto it = usage.find(&block);
+  if (it==usage.end())
+  {
+    it = usage.emplace(&block,block_usage{0,0,0}).first;
+    measure(&block); // a new block, measured just once
+  }
+  it->second.stamp = ++use_count;
+  last_used = &block;
+  trim_blocks(&block);
+  return block;
+}
+
+// walking the whole block in |memory()| is costly, so do it only if it grew
+void Rep_table::measure (const blocks::common_block* block)
+{
+  const auto it = usage.find(block);
+  if (it==usage.end())
+    return; // only stored blocks are accounted for
+  const size_t fills = block->fill_count();
+  if (it->second.bytes!=0 and it->second.fills==fills)
+    return; // nothing was filled since the previous measurement
+  block_bytes -= it->second.bytes;
+  it->second.bytes = block->memory();
+  it->second.fills = fills;
+  block_bytes += it->second.bytes;
+}
+
+void Rep_table::trim_blocks (const blocks::common_block* keep)
+{
+  while (block_bytes>budget)
+  {
+    bl_it oldest = block_list.end();
+    unsigned long oldest_stamp = use_count+1;
+    for (auto it=block_list.begin(); not block_list.at_end(it); ++it)
+      if (&*it!=keep)
+      {
+	const auto u = usage.find(&*it);
+	const unsigned long stamp = u==usage.end() ? 0 : u->second.stamp;
+	if (stamp<oldest_stamp)
+	{
+	  oldest = it;
+	  oldest_stamp = stamp;
+	}
+      }
+    if (block_list.at_end(oldest))
+      return; // only |keep| is left, which by itself may exceed |budget|
+    evict_block(oldest);
+  }
+}
+
+// drop |*pos| from |block_list|; |lookup| will rebuild it when needed again
+void Rep_table::evict_block (bl_it pos)
+{
+  const auto& block = *pos;
+  for (BlockElt z=0; z<block.size(); ++z)
+  {
+    const auto h = mod_hash.find(block.representative(z));
+    assert(h<place.size());
+    if (place[h].first==pos)
+      place[h] = std::make_pair(bl_it(),UndefBlock); // see |is_placed|
+  }
+  ++evictions;
+  block_erase(pos);
+}
+
 // in the following type the second component is a mulitplicity so we are in fact
 // dealing with a sparse reprensetion of polynomials with |BlockElt| exponents
 
@@ -1561,8 +1680,9 @@ containers::sl_list<std::pair<StandardRepr,int> > Rep_table::deformation_terms
       finals.push_front(z); // accumulate in reverse order
 
   assert(not finals.empty() and finals.front()==y); // do not call for non-final
-  const kl::KL_table& kl_tab =
-    block.kl_tab(&KL_poly_hash,y+1); // fill silently up to |y|
+  kl::KL_table& kl_tab = block.kl_tab_column(&KL_poly_hash,y);
+  for (auto z : finals)
+    kl_tab.fill_column(z); // compute just the columns we shall use
 
   std::unique_ptr<unsigned int[]> index // a sparse array, map final to position
     (new unsigned int [block.size()]); // unlike |std::vector| do not initialise
@@ -1588,7 +1708,7 @@ containers::sl_list<std::pair<StandardRepr,int> > Rep_table::deformation_terms
     const bool contribute = block.length(z)%2!=y_parity;
     for (BlockElt x=z+1; x-->0; ) // for |x| from |z| down to |0| inclusive
     {
-      const kl::KLPol& pol = kl_tab.KL_pol(x,z); // regular KL polynomial
+      kl::KLPolRef pol = kl_tab.KL_pol(x,z); // regular KL polynomial
       int eval = 0;
       for (polynomials::Degree d=pol.size(); d-->0; )
 	eval = static_cast<int>(pol[d]) - eval; // evaluate at $q = -1$
@@ -1635,27 +1755,19 @@ containers::sl_list<std::pair<StandardRepr,int> > Rep_table::deformation_terms
   return result;
 } // |deformation_terms|, common block version
 
-// compute and return sum of KL polynomials at $s$ for final parameter |sr|
-SR_poly Rep_table::KL_column_at_s(StandardRepr sr) // |sr| must be final
+// sum of KL polynomials at $s$ for column |z| of |block|, already computed
+SR_poly Rep_table::KL_sum_at_s
+  (blocks::common_block& block, BlockElt z, const RatWeight& gamma,
+   const kl::KL_table& kl_tab)
 {
-  normalise(sr); // implies that |sr| it will appear at the top of its own block
-  assert(is_final(sr));
-
-  BlockElt z;
-  auto& block = lookup(sr,z);
-
-  const auto& gamma=sr.gamma();
   std::vector<pair_list> contrib = contributions(block,block.singular(gamma),z);
   assert(contrib.size()==z+1 and contrib[z].front().first==z);
 
-  const kl::KL_table& kl_tab =
-    block.kl_tab(&KL_poly_hash,z+1); // fill silently up to |z|
-
   SR_poly result;
   auto z_length=block.length(z);
   for (BlockElt x=z+1; x-->0; )
   {
-    const kl::KLPol& pol = kl_tab.KL_pol(x,z); // regular KL polynomial
+    kl::KLPolRef pol = kl_tab.KL_pol(x,z); // regular KL polynomial
     if (pol.isZero())
       continue;
     Split_integer eval(0);
@@ -1670,8 +1782,73 @@ SR_poly Rep_table::KL_column_at_s(StandardRepr sr) // |sr| must be final
   }
 
   return result;
+} // |Rep_table::KL_sum_at_s|
+
+// compute and return sum of KL polynomials at $s$ for final parameter |sr|
+SR_poly Rep_table::KL_column_at_s(StandardRepr sr) // |sr| must be final
+{
+  normalise(sr); // implies that |sr| it will appear at the top of its own block
+  assert(is_final(sr));
+
+  BlockElt z;
+  auto& block = lookup(sr,z);
+
+  const kl::KL_table& kl_tab = // compute column |z|, and what it depends on
+    block.kl_tab_column(&KL_poly_hash,z);
+
+  return KL_sum_at_s(block,z,sr.gamma(),kl_tab);
 } // |Rep_table::KL_column_at_s|
 
+// the same for a list of final parameters, handling each block only once
+std::vector<SR_poly> Rep_table::KL_column_at_s
+  (std::vector<StandardRepr> srs) // by value, each one must be final
+{
+  for (auto& sr : srs)
+  {
+    normalise(sr);
+    assert(is_final(sr));
+  }
+  // generate partial blocks from the end, where Bruhat-higher elements tend to
+  // be, so that (partial) blocks found first will contain many elements
+  for (auto it=srs.rbegin(); it!=srs.rend(); ++it)
+  { BlockElt z;
+    lookup(*it,z); // ensure a block for |*it| is known; ignore it for now
+  }
+
+  std::vector<SR_poly> result(srs.size());
+  BitMap done(srs.size());
+  for (unsigned long i=0; i<srs.size(); ++i)
+    if (not done.isMember(i))
+    {
+      BlockElt z;
+      auto& block = lookup(srs[i],z); // further lookups are avoided below
+
+      // collect all remaining parameters in |block|, and needed column limit
+      containers::sl_list<std::pair<unsigned long,BlockElt> > group;
+      BlockElt limit=0;
+      for (unsigned long j=i; j<srs.size(); ++j)
+	if (not done.isMember(j))
+	{
+	  const auto h = mod_hash.find(StandardReprMod::mod_reduce(*this,srs[j]));
+	  if (is_placed(h) and &*place[h].first==&block)
+	  {
+	    group.emplace_back(j,place[h].second);
+	    done.insert(j);
+	    limit=std::max(limit,place[h].second+1);
+	  }
+	}
+      assert(not group.empty() and group.front().second==z);
+
+      const kl::KL_table& kl_tab = // fill the columns below |limit| once
+	block.kl_tab(&KL_poly_hash,limit,false,n_threads);
+      for (const auto& member : group)
+	result[member.first] =
+	  KL_sum_at_s(block,member.second,srs[member.first].gamma(),kl_tab);
+    }
+
+  return result;
+} // |Rep_table::KL_column_at_s|, list version
+
 // compute and return column of KL table for final parameter |sr|
 containers::simple_list<std::pair<BlockElt,kl::KLPol> >
   Rep_table::KL_column(StandardRepr sr) // |sr| must be final
@@ -1681,13 +1858,13 @@ containers::simple_list<std::pair<BlockElt,kl::KLPol> >
   BlockElt z;
   auto& block = lookup(sr,z);
 
-  const kl::KL_table& kl_tab =
-    block.kl_tab(&KL_poly_hash,z+1); // fill silently up to |z|
+  const kl::KL_table& kl_tab = // compute column |z|, and what it depends on
+    block.kl_tab_column(&KL_poly_hash,z);
 
   containers::simple_list<std::pair<BlockElt,kl::KLPol> > result;
   for (BlockElt x=z+1; x-->0; )
   {
-    const kl::KLPol& pol = kl_tab.KL_pol(x,z); // regular KL polynomial
+    kl::KLPolRef pol = kl_tab.KL_pol(x,z); // regular KL polynomial
     if (not pol.isZero())
       result.emplace_front(x,pol);
   }
@@ -1814,13 +1991,28 @@ SR_poly twisted_KL_column_at_s
   return twisted_KL_sum(eblock,eblock.element(entry),block,z.gamma());
 } // |twisted_KL_column_at_s|
 
-// look up or compute and return the alternating sum of twisted KL polynomials
-// at the inner class involution for final parameter |z|, evaluated at $q=s$
+/*
+  Look up or compute and return the alternating sum of twisted KL polynomials
+  at the inner class involution for final parameter |z|, evaluated at $q=s$.
+  The twisted KL table is kept with the extended block of the common block
+  containing |z|, so other parameters of that block need no new KL
+  computations; in addition the resulting sums are stored by parameter, so that
+  repeated calls for the same parameter just return a copy.
+*/
 SR_poly Rep_table::twisted_KL_column_at_s(StandardRepr sr)
   // |z| must be inner-class-twist-fixed, nonzero and final
 {
   normalise(sr);
   assert(is_final(sr) and sr==inner_twisted(sr));
+  {
+    const auto h = twisted_sum_hash.find(sr);
+    if (h!=twisted_sum_hash.empty)
+    {
+      ++twisted_sum_hits;
+      return twisted_sums[h];
+    }
+  }
+
   BlockElt y0;
   auto& block = lookup(sr,y0);
   auto& eblock = block.extended_block(&poly_hash);
@@ -1838,7 +2030,7 @@ SR_poly Rep_table::twisted_KL_column_at_s(StandardRepr sr)
     if (not contrib[z].empty() and contrib[z].front().first==z)
       finals.push_front(z); // accumulate in reverse order
 
-  const auto& kl_tab = eblock.kl_table(y+1,&poly_hash);
+  const auto& kl_tab = eblock.kl_table(y+1,&poly_hash,n_threads);
 
   SR_poly result;
   const auto& gamma=sr.gamma();
@@ -1860,6 +2052,10 @@ SR_poly Rep_table::twisted_KL_column_at_s(StandardRepr sr)
       result.add_term(block.sr(eblock.z(pair.first),gamma),eval*pair.second);
   }
 
+  // |sr| was normalised above, so |lookup| left it unchanged
+  assert(twisted_sum_hash.size()==twisted_sums.size());
+  twisted_sum_hash.match(sr);
+  twisted_sums.push_back(result);
   return result;
 } // |Rep_table::twisted_KL_column_at_s|
 
@@ -1882,7 +2078,7 @@ Rep_table::twisted_deformation_terms
     if (not contrib[z].empty() and contrib[z].front().first==z)
       finals.push_front(z); // accumulate in reverse order
 
-  const auto& kl_tab = eblock.kl_table(y_index+1,&poly_hash);
+  const auto& kl_tab = eblock.kl_table(y_index+1,&poly_hash,n_threads);
 
   std::vector<int> pool_at_minus_1; // evaluations at $q=-1$ of KL polynomials
   {
@@ -2074,6 +2270,252 @@ K_type_poly Rep_table::twisted_deformation (StandardRepr z)
 
 } // |Rep_table::twisted_deformation (StandardRepr z)|
 
+// First 4 bytes of a deformation file, see |Rep_table::write_deformations|
+const unsigned int deformation_magic = 0x44454631;
+
+std::vector<long long int> Rep_table::group_key() const
+{
+  const RootDatum& rd = root_datum();
+  std::vector<long long int> key { static_cast<long long int>(rd.rank())
+				 , rd.semisimpleRank() };
+  for (auto it=rd.beginSimpleRoot(); it!=rd.endSimpleRoot(); ++it)
+    key.insert(key.end(),it->begin(),it->end());
+  for (auto it=rd.beginSimpleCoroot(); it!=rd.endSimpleCoroot(); ++it)
+    key.insert(key.end(),it->begin(),it->end());
+  const WeightInvolution& delta = inner_class().distinguished();
+  for (unsigned int i=0; i<delta.numRows(); ++i)
+    for (unsigned int j=0; j<delta.numColumns(); ++j)
+      key.push_back(delta(i,j));
+  key.push_back(real_group().realForm());
+  key.push_back(real_group().x0_torus_part().data().to_ulong());
+  const auto& g = g_rho_check();
+  key.insert(key.end(),g.numerator().begin(),g.numerator().end());
+  key.push_back(g.denominator());
+  key.push_back(kgb().size());
+  return key;
+}
+
+/*
+  Write all stored deformation formulae, with the samples of their alcoves and
+  the $K$-types they refer to, preceded by a key identifying the real form.
+  Integers are written in 4 bytes, except for those of |group_key| and of
+  infinitesimal characters, which are written in 8 bytes.
+*/
+unsigned long Rep_table::write_deformations (std::ostream& out) const
+{
+  const auto put_long =
+    [&out] (long long int n) { basic_io::write_bytes<8>(n,out); };
+  const auto put_terms = [&out] (const K_type_poly& P)
+  {
+    basic_io::put_int(P.size(),out);
+    for (const auto& term : P)
+    {
+      basic_io::put_int(term.first,out);
+      basic_io::put_int(term.second.e(),out);
+      basic_io::put_int(term.second.s(),out);
+    }
+  };
+
+  basic_io::put_int(deformation_magic,out);
+  const auto key = group_key();
+  basic_io::put_int(key.size(),out);
+  for (auto n : key)
+    put_long(n);
+
+  basic_io::put_int(K_type_pool.size(),out);
+  for (const auto& t : K_type_pool)
+  {
+    basic_io::put_int(t.x(),out);
+    for (auto c : t.lambda_rho())
+      basic_io::put_int(c,out);
+  }
+
+  unsigned long n_units=0, count=0;
+  for (const auto& unit : pool)
+    if (unit.has_deformation_formula() or unit.has_twisted_deformation_formula())
+    {
+      ++n_units;
+      count += (unit.has_deformation_formula() ? 1 : 0)
+	+ (unit.has_twisted_deformation_formula() ? 1 : 0);
+    }
+  basic_io::put_int(n_units,out);
+  for (const auto& unit : pool)
+    if (unit.has_deformation_formula() or unit.has_twisted_deformation_formula())
+    {
+      basic_io::put_int(unit.sample.x(),out);
+      for (auto c : lambda_rho(unit.sample))
+	basic_io::put_int(c,out);
+      const auto& gamma = unit.sample.gamma();
+      for (auto c : gamma.numerator())
+	put_long(c);
+      put_long(gamma.denominator());
+      put_terms(unit.def_formula());
+      put_terms(unit.twisted_def_formula());
+    }
+
+  if (not out.good())
+    throw error::OutputError();
+  return count;
+} // |Rep_table::write_deformations|
+
+/*
+  Add the deformation formulae from a file written by |write_deformations| for
+  the same real form. $K$-types are translated through |K_type_hash|, and the
+  samples are entered into |alcove_hash|; for a fresh table this reproduces the
+  original numbering. Formulae already known for an alcove are not replaced.
+  The whole file is read and checked before any of this is done, so that a
+  corrupted file leaves our tables unchanged.
+*/
+unsigned long Rep_table::read_deformations (std::istream& in)
+{
+  const auto get = [&in] () -> unsigned int
+    { return basic_io::read_bytes<4>(in); };
+  const auto get_int = [&get] () -> int { return static_cast<int>(get()); };
+  const auto get_long = [&in] () -> long long int
+    { return basic_io::read_bytes<8>(in); };
+  const auto corrupted = [] ()
+    { return std::runtime_error("Corrupted deformation file"); };
+
+  in.seekg(0,std::ios_base::end);
+  const std::streamoff file_size = in.tellg();
+  in.seekg(0,std::ios_base::beg);
+  if (file_size<0 or not in.good())
+    throw std::runtime_error("Cannot determine size of deformation file");
+  // get a count of items of at least |item_size| bytes each, bounded by what
+  // remains of the file, so that corrupt counts cannot cause huge allocations
+  const auto get_count = [&in,&get,file_size,&corrupted]
+    (unsigned int item_size) -> unsigned int
+  {
+    const unsigned int n = get();
+    const std::streamoff pos = in.tellg();
+    if (not in.good() or pos<0 or n>(file_size-pos)/item_size)
+      throw corrupted();
+    return n;
+  };
+
+  if (get()!=deformation_magic)
+    throw std::runtime_error("Not a deformation file");
+  {
+    const auto key = group_key();
+    bool same = get()==key.size();
+    for (unsigned int i=0; same and i<key.size(); ++i)
+      same = get_long()==key[i];
+    if (not same)
+      throw std::runtime_error("Deformation file is for a different group");
+  }
+
+  // first read and check everything, without changing our tables
+  const unsigned int r = rank();
+  std::vector<K_type> K_types;
+  Weight lam_rho(r);
+  for (unsigned int n=get_count(4*(1+r)); n-->0; )
+  {
+    const KGBElt x = get();
+    for (auto& c : lam_rho)
+      c = get_int();
+    if (not in.good() or x>=kgb().size())
+      throw corrupted();
+    K_types.emplace_back(*this,sr(x,lam_rho,RatWeight(r)));
+  }
+
+  using file_terms = std::vector<std::pair<unsigned int,Split_integer> >;
+  const auto get_terms = [&] () -> file_terms
+  {
+    file_terms terms(get_count(12));
+    for (auto& term : terms)
+    {
+      const unsigned int i = get();
+      const int e = get_int(); // order of evaluation matters here
+      const int s = get_int();
+      if (i>=K_types.size())
+	throw corrupted();
+      term = std::make_pair(i,Split_integer(e,s));
+    }
+    return terms;
+  };
+
+  struct unit_record { StandardRepr sample; file_terms untwisted, twisted; };
+  std::vector<unit_record> units;
+  Ratvec_Numer_t num(r);
+  for (unsigned int n=get_count(4+12*r+8+8); n-->0; )
+  {
+    const KGBElt x = get();
+    for (auto& c : lam_rho)
+      c = get_int();
+    for (auto& c : num)
+      c = get_long();
+    const long long int denom = get_long();
+    if (not in.good() or x>=kgb().size() or denom<=0)
+      throw corrupted();
+    auto untwisted = get_terms();
+    auto twisted = get_terms();
+    if (not in.good())
+      throw corrupted();
+    units.push_back
+      ({sr_gamma(x,lam_rho,{num,denom}),std::move(untwisted),std::move(twisted)});
+  }
+
+  // now the whole file is valid; install its contents
+  std::vector<K_type_nr> K_trans; K_trans.reserve(K_types.size());
+  for (const auto& t : K_types)
+    K_trans.push_back(K_type_hash.match(t));
+
+  std::vector<K_term_type> terms;
+  const auto translate = [&] (const file_terms& ft) -> K_type_poly
+  {
+    terms.clear();
+    for (const auto& term : ft)
+      terms.emplace_back(K_trans[term.first],term.second);
+    return K_type_poly(std::move(terms));
+  };
+
+  unsigned long count=0;
+  for (auto& unit : units)
+  {
+    auto untwisted = translate(unit.untwisted);
+    auto twisted = translate(unit.twisted);
+    const auto h =
+      alcove_hash.match(deformation_unit(*this,std::move(unit.sample)));
+    if (not untwisted.is_zero() and not pool[h].has_deformation_formula())
+    {
+      pool[h].set_deformation_formula(std::move(untwisted));
+      ++count;
+    }
+    if (not twisted.is_zero() and not pool[h].has_twisted_deformation_formula())
+    {
+      pool[h].set_twisted_deformation_formula(std::move(twisted));
+      ++count;
+    }
+  }
+  return count;
+} // |Rep_table::read_deformations|
+
+unsigned long Rep_table::save_deformations (const std::string& file_name) const
+{
+  const std::string temp_name = file_name + ".tmp";
+  unsigned long count;
+  {
+    std::ofstream out(temp_name.c_str(),
+		      std::ios_base::out
+		      | std::ios_base::trunc
+		      | std::ios_base::binary);
+    if (not out.is_open())
+      throw std::runtime_error("Cannot open deformation file "+temp_name);
+    count = write_deformations(out);
+  } // close |out|, flushing buffers
+  if (std::rename(temp_name.c_str(),file_name.c_str())!=0)
+    throw std::runtime_error("Cannot rename deformation file "+temp_name);
+  return count;
+}
+
+unsigned long Rep_table::load_deformations (const std::string& file_name)
+{
+  std::ifstream in(file_name.c_str(),std::ios_base::in|std::ios_base::binary);
+  if (not in.is_open())
+    throw std::runtime_error("Cannot open deformation file "+file_name);
+  return read_deformations(in);
+}
+
 
 //			|common_conetxt| methods
 
@@ -12,6 +12,8 @@
 #define REPR_H
 
 #include <iostream>
+#include <string>
+#include <map> // for |Rep_table::usage|
 
 #include "../Atlas.h"
 
@@ -257,7 +259,7 @@ class Rep_context
     bool operator()(const StandardRepr& r,const StandardRepr& s) const;
   }; // |compare|
 
-  using poly = Free_Abelian<StandardRepr,Split_integer,compare>;
+  using poly = Free_Abelian_light<StandardRepr,Split_integer,compare>;
 
   poly scale(const poly& P, const Rational& f) const;
   poly scale_0(const poly& P) const;
@@ -403,7 +405,7 @@ class Rep_table : public Rep_context
   std::vector<K_type> K_type_pool;
   HashTable<K_type,K_type_nr> K_type_hash;
 
-  std::vector<kl::KLPol> KL_poly_pool;
+  kl::KLStore KL_poly_pool; // compact storage of KL polynomials
   KL_hash_Table KL_poly_hash;
 
   std::vector<ext_kl::Pol> poly_pool;
@@ -413,6 +415,25 @@ class Rep_table : public Rep_context
   using bl_it = containers::sl_list<blocks::common_block>::iterator;
   std::vector<std::pair<bl_it, BlockElt> > place;
 
+  // results of |twisted_KL_column_at_s|, by normalised final parameter
+  std::vector<StandardRepr> twisted_sum_pool;
+  HashTable<StandardRepr,unsigned long> twisted_sum_hash;
+  std::vector<SR_poly> twisted_sums; // indexed like |twisted_sum_pool|
+  size_t twisted_sum_hits; // number of calls answered from |twisted_sums|
+
+  unsigned int n_threads; // for KL tables that are filled up to some element
+
+  // when |budget!=0|, the least recently used blocks are dropped from
+  // |block_list| whenever the bytes they use together exceed |budget|
+  // |bytes| were measured when the block's |fill_count()| was |fills|
+  struct block_usage { unsigned long stamp; size_t bytes, fills; };
+  std::map<const blocks::common_block*,block_usage> usage; // if |budget!=0|
+  size_t budget; // in bytes; |0| means no limit
+  size_t block_bytes; // sum of |bytes| fields of |usage|, as last measured
+  unsigned long use_count; // clock for |stamp| fields
+  const blocks::common_block* last_used; // it may have grown since
+  size_t evictions; // number of blocks dropped so far
+
  public:
   Rep_table(RealReductiveGroup &G);
   ~Rep_table();
@@ -420,6 +441,18 @@ class Rep_table : public Rep_context
 
   ext_KL_hash_Table* shared_poly_table () { return &poly_hash; }
 
+  // with |n>1|, KL tables are filled (in parallel) for all elements up to the
+  // one needed, rather than computing just the columns needed (sequentially)
+  void set_threads (unsigned int n) { n_threads=n; } // |0|: hardware decides
+  unsigned int threads () const { return n_threads; }
+
+  // limit memory of stored blocks; blocks that are dropped to stay within
+  // |bytes| will be rebuilt when needed again (deformation formulae are kept)
+  void set_block_budget (size_t bytes); // |0| means no limit
+  size_t block_budget () const { return budget; }
+  std::vector<size_t> block_memory () const; // bytes for each stored block
+  size_t evicted_blocks () const { return evictions; }
+
   const StandardReprMod& srm(unsigned long n) const { return mod_pool[n]; }
 
   // the |length| method generates a partial block, for best amortised efficiency
@@ -432,9 +465,15 @@ class Rep_table : public Rep_context
     (StandardRepr& sr,BlockElt& z); // |sr| is by reference; will be normalised
 
   SR_poly KL_column_at_s(StandardRepr z); // by value
+  // the same for many final parameters; fills the KL table of a block only once
+  std::vector<SR_poly> KL_column_at_s(std::vector<StandardRepr> zs);
   containers::simple_list<std::pair<BlockElt,kl::KLPol> >
     KL_column(StandardRepr z); // by value
   SR_poly twisted_KL_column_at_s(StandardRepr z); // by value
+  // how many calls of the latter were answered from a stored result, and how
+  // many had to be computed (and are now stored)
+  std::pair<size_t,size_t> twisted_KL_sum_counts() const
+  { return { twisted_sum_hits, twisted_sums.size() }; }
 
   StandardRepr K_type_sr(K_type_nr i) { return K_type_pool[i].sr(*this); }
 
@@ -460,8 +499,27 @@ class Rep_table : public Rep_context
 
   K_type_poly twisted_deformation(StandardRepr z); // by value
 
+  // binary files of stored deformation formulae, with the K-types they use;
+  // the |save| and |write| methods return the number of formulae written, and
+  // the |load| and |read| methods return the number of formulae added
+  unsigned long save_deformations(const std::string& file_name) const;
+  unsigned long load_deformations(const std::string& file_name);
+  unsigned long write_deformations(std::ostream& out) const;
+  unsigned long read_deformations(std::istream& in);
+
  private:
+  // values that identify our real form, recorded in deformation files
+  std::vector<long long int> group_key() const;
   void block_erase (bl_it pos); // erase from |block_list| in safe manner
+  bool is_placed (unsigned long h) const; // whether |mod_pool[h]| has a block
+  // record use of |block| (returned by |lookup|), then trim to |budget|
+  blocks::common_block& use_block (blocks::common_block& block);
+  void measure (const blocks::common_block* block); // update |bytes| if grown
+  void trim_blocks (const blocks::common_block* keep); // evict LRU, not |keep|
+  void evict_block (bl_it pos); // drop |*pos| and forget its |place| entries
+  SR_poly KL_sum_at_s // for |KL_column_at_s|, given a filled KL table
+    (blocks::common_block& block, BlockElt z, const RatWeight& gamma,
+     const kl::KL_table& kl_tab);
   unsigned long add_block(const StandardReprMod&); // full block
   class Bruhat_generator; // helper class: internal |add_block_below| recursion
 
@@ -163,12 +163,16 @@ std::vector<WGraph> cells(const WGraph& wg)
    |kl::Helper::fillMuRow| as well as that to the mentioned |wGraph| function.
 */
 WGraph wGraph
-  ( std::ifstream& block_file
-  , std::ifstream& matrix_file
-  , std::ifstream& KL_file)
+  ( const std::string& block_file_name
+  , const std::string& matrix_file_name
+  , const std::string& KL_file_name)
 {
   using pol_uptr = std::unique_ptr<filekl::polynomial_info>;
 
+  const filekl::mapped_file block_file(block_file_name);
+  const filekl::mapped_file matrix_file(matrix_file_name);
+  const filekl::mapped_file KL_file(KL_file_name);
+
   filekl::matrix_info mi(block_file,matrix_file);
   pol_uptr pol_p(nullptr);
 
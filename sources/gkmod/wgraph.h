@@ -29,10 +29,10 @@ std::vector<WGraph> cells(const WGraph&);
 
 // Functions
 
-WGraph wGraph
-  ( std::ifstream& block_file
-  , std::ifstream& matrix_file
-  , std::ifstream& KL_file);
+WGraph wGraph // from names of files as written by |filekl|; these are mapped
+  ( const std::string& block_file
+  , const std::string& matrix_file
+  , const std::string& KL_file);
 
 }
 
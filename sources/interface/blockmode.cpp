@@ -75,6 +75,11 @@ namespace {
   void kllist_f();
   void primkl_f();
   void klwrite_f();
+  void klthreads_f();
+  void klformat_f();
+  void klcheckpoint_f();
+  void klresume_f();
+  void klstats_f();
   void wgraph_f();
   void wcells_f();
 
@@ -85,6 +90,8 @@ namespace {
   RealReductiveGroup* dual_G_R_pointer=nullptr;
   Block* block_pointer=nullptr;
   wgraph::WGraph* WGr_pointer=nullptr;
+  unsigned int KL_threads=1; // number of threads used to fill KL tables
+  unsigned int KL_format=1; // format of files written by "klwrite"
 } // |namespace|
 
 /*****************************************************************************
@@ -137,6 +144,16 @@ CommandNode blockNode()
   result.add("primkl",primkl_f,
 	     "prints the KL polynomials for primitive pairs",std_help);
   result.add("klwrite",klwrite_f,"writes the KL polynomials to disk",std_help);
+  result.add("klthreads",klthreads_f,
+	     "sets the number of threads used for KL computations",std_help);
+  result.add("klformat",klformat_f,
+	     "selects the binary format written by klwrite",std_help);
+  result.add("klcheckpoint",klcheckpoint_f,
+	     "makes KL computations save their progress periodically",std_help);
+  result.add("klresume",klresume_f,
+	     "reads KL progress saved by an earlier computation",std_help);
+  result.add("klstats",klstats_f,
+	     "prints statistics about the KL computation",std_help);
   result.add("wcells",wcells_f,
 	     "prints the Kazhdan-Lusztig cells for the block",std_help);
   result.add("wgraph",wgraph_f,"prints the W-graph for the block",std_help);
@@ -168,7 +185,7 @@ Block& currentBlock()
 
 kl::KL_table& currentKL()
 {
-  return currentBlock().kl_tab(nullptr,0,true);
+  return currentBlock().kl_tab(nullptr,0,true,KL_threads);
 }
 
 const wgraph::WGraph& currentWGraph()
@@ -252,6 +269,8 @@ void block_mode_exit()
   delete dual_G_R_pointer; dual_G_R_pointer=nullptr;
   delete block_pointer; block_pointer=nullptr;
   delete WGr_pointer; WGr_pointer=nullptr;
+  KL_threads=1;
+  KL_format=1;
 }
 
 /*****************************************************************************
@@ -493,7 +512,11 @@ void primkl_f()
   kl_io::printPrimitiveKL(file,kl_tab,currentBlock());
 }
 
-// Write the results of the KL computations to a pair of binary files
+/*
+  Write the results of the KL computations to a pair of binary files. Rows of
+  the matrix file are written while the KL table is being filled, as soon as
+  their columns are complete; the polynomial file is written at the end.
+*/
 void klwrite_f()
 {
   std::ofstream matrix_out, coefficient_out; // binary output files
@@ -501,22 +524,101 @@ void klwrite_f()
   interactive::open_binary_file
     (coefficient_out,"File name for polynomial output: ");
 
-  const kl::KL_table& kl_tab = currentKL();
-
   if (matrix_out.is_open())
-  {
+  { // write matrix rows while computing: the table might still be incomplete
+    kl::KL_table& kl_tab = currentBlock().kl_tab_object(nullptr);
+    filekl::matrix_writer writer(kl_tab,matrix_out,KL_format==2);
+    kl_tab.set_fill_observer(&writer);
+    try { currentKL(); }
+    catch (...) { kl_tab.set_fill_observer(nullptr); throw; }
+    kl_tab.set_fill_observer(nullptr);
+
     std::cout << "Writing matrix entries... " << std::flush;
-    filekl::write_matrix_file(kl_tab,matrix_out);
+    writer.finish(kl_tab);
     std::cout << "Done." << std::endl;
   }
+
+  const kl::KL_table& kl_tab = currentKL();
   if (coefficient_out.is_open())
   {
     std::cout << "Writing polynomial coefficients... " << std::flush;
-    filekl::write_KL_store(kl_tab.pol_store(),coefficient_out);
+    filekl::write_KL_store(kl_tab.pol_store(),coefficient_out,KL_format==2);
     std::cout << "Done." << std::endl;
   }
 }
 
+/*
+  Set the number of threads used when (further) filling the KL table of the
+  block. Since the result does not depend on this number, any part of the
+  table already computed is retained.
+*/
+void klthreads_f()
+{
+  KL_threads = interactive::get_bounded_int
+    (interactive::common_input(),
+     "number of threads (0 for all hardware threads): ",1024);
+  std::cout << "KL computations will use ";
+  if (KL_threads==0)
+    std::cout << "all hardware threads." << std::endl;
+  else
+    std::cout << KL_threads << " thread" << (KL_threads==1 ? "." : "s.")
+	      << std::endl;
+}
+
+/*
+  Select the format of the files written by "klwrite": 1 for the original
+  format with fixed size fields, 2 for the compact format.
+*/
+void klformat_f()
+{
+  unsigned long f = interactive::get_bounded_int
+    (interactive::common_input(),"file format (1 or 2): ",3);
+  if (f==0)
+  {
+    std::cout << "there is no format 0; keeping format " << KL_format << '.'
+	      << std::endl;
+    return;
+  }
+  KL_format = f;
+  std::cout << "klwrite will use "
+	    << (KL_format==1 ? "the original" : "the compact") << " format."
+	    << std::endl;
+}
+
+/*
+  Ask for a file name and an interval, and arrange that (further) filling the
+  KL table of the block saves its progress there; an empty name stops this.
+  The table is created, but nothing is computed here.
+*/
+void klcheckpoint_f()
+{
+  std::string name = interactive::getFileName
+    ("File name for KL checkpoints (empty to stop checkpointing): ");
+  unsigned int minutes = name.empty() ? 0 : interactive::get_bounded_int
+    (interactive::common_input(),"minutes between checkpoints: ",10080);
+  currentBlock().kl_tab_object(nullptr).set_checkpoint(name,60*minutes);
+  if (name.empty())
+    std::cout << "KL computations will not save their progress." << std::endl;
+  else
+    std::cout << "KL computations will save their progress to " << name
+	      << " every " << minutes << " minutes." << std::endl;
+}
+
+// Read a file written by checkpointing into the KL table of the block
+void klresume_f()
+{
+  ioutils::InputFile file("KL checkpoint");
+  BlockElt count = currentBlock().kl_tab_object(nullptr).read_checkpoint(file);
+  std::cout << "Read " << count << " KL columns." << std::endl;
+}
+
+// Print counters and table sizes for the KL computation (doing it if needed)
+void klstats_f()
+{
+  const kl::KL_table& kl_tab = currentKL();
+  ioutils::OutputFile file; kl_io::printStats(file,kl_tab);
+}
+
 // Print the W-graph corresponding to a block.
 void wgraph_f()
 {
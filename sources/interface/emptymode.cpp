@@ -110,7 +110,8 @@ void extract_graph_f()
   ioutils::InputFile polynomial_file("polynomial information");
   ioutils::OutputFile file;
 
-  wgraph::WGraph wg=wgraph::wGraph(block_file,matrix_file,polynomial_file);
+  wgraph::WGraph wg=wgraph::wGraph
+    (block_file.name(),matrix_file.name(),polynomial_file.name());
   wgraph_io::printWGraph(file,wg);
 }
 
@@ -121,7 +122,8 @@ void extract_cells_f()
   ioutils::InputFile polynomial_file("polynomial information");
   ioutils::OutputFile file;
 
-  wgraph::WGraph wg=wgraph::wGraph(block_file,matrix_file,polynomial_file);
+  wgraph::WGraph wg=wgraph::wGraph
+    (block_file.name(),matrix_file.name(),polynomial_file.name());
   wgraph::DecomposedWGraph dg(wg);
   wgraph_io::printWDecomposition(file,dg);
 }
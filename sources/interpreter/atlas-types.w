@@ -4883,14 +4883,14 @@ by constructing a new polynomial |Pol(P)|.
 	{ BlockElt y = *it;
           const auto& P = kl_tab.KL_pol(x,y);
           if (not P.isZero())
-            M(i,loc[y]) += Pol(P);
+            M(i,loc[y]) += Pol(KLPol(P));
         }
       else
 	for (auto it=start; not survivors.at_end(it); ++it)
 	{ BlockElt y = *it;
           const auto& P = kl_tab.KL_pol(x,y);
           if (not P.isZero())
-            M(i,loc[y]) -= Pol(P);
+            M(i,loc[y]) -= Pol(KLPol(P));
         }
     }
   }
@@ -5036,7 +5036,8 @@ void dual_KL_block_wrapper(expression_base::level l)
     { BlockElt y = last-*jt; // index into |dual_block|
       for (auto it = jt; not survivors.at_end(it); ++it)
       { BlockElt x = last-*it; // index into |dual_block|
-         M_ind->val(loc[x],loc[y]) = hash.match(Pol(kl_tab.KL_pol(x,y)));
+         M_ind->val(loc[x],loc[y]) =
+           hash.match(Pol(KLPol(kl_tab.KL_pol(x,y))));
       }
     }
     push_value(std::move(M_ind));
@@ -5558,7 +5559,7 @@ combinations of parameters.
 @h <iomanip> // for |std::setw|
 @< Function def...@>=
 void virtual_module_value::print(std::ostream& out) const
-{ if (val.empty())
+{ if (val.is_zero())
     {@; out << "Empty sum of standard modules"; return; }
   bool has_one=false, has_s=false;
   for (repr::SR_poly::const_iterator it=val.begin(); it!=val.end(); ++it)
@@ -5612,13 +5613,13 @@ void real_form_of_virtual_module_wrapper(expression_base::level l)
 void virtual_module_unary_eq_wrapper(expression_base::level l)
 { shared_virtual_module m = get<virtual_module_value>();
   if (l!=expression_base::no_value)
-    push_value(whether(m->val.empty()));
+    push_value(whether(m->val.is_zero()));
 }
 
 void virtual_module_unary_neq_wrapper(expression_base::level l)
 { shared_virtual_module m = get<virtual_module_value>();
   if (l!=expression_base::no_value)
-    push_value(whether(m->val.size()>0));
+    push_value(whether(not m->val.is_zero()));
 }
 
 @)
@@ -5832,14 +5833,13 @@ a \.{ParamPol} argument $P$ need to start with an empty module for the same real
 form; writing $0*P$ is quite a convenient way to achieve this.
 
 Matters are similar but somewhat subtler for scalar multiplication by split
-integers, because these have zero divisors. Therefore we need to
-test \emph{each} coefficient produced by multiplication in this case, and
-remove the term when the coefficient becomes zero. We must take care to
-advance the iterator ``manually'' before doing that, and as a consequence
-cannot as usual advance the iterator in the |for| clause. In this case we do
-not bother handling the case of an entirely zero split integer
-multiplier separately; that case \emph{is} rare, and the given code works
-correctly for it (albeit not in the fastest possible way).
+integers, because these have zero divisors. Therefore \emph{each} coefficient
+produced by multiplication must be tested in this case, and the term removed
+when the coefficient becomes zero; the |operator*=| method of |repr::SR_poly|
+does this, squeezing out such terms in a single pass over its vector of
+terms. In this case we do not bother handling the case of an entirely zero
+split integer multiplier separately; that case \emph{is} rare, and the given
+code works correctly for it (albeit not in the fastest possible way).
 
 @< Local function... @>=
 
@@ -5861,8 +5861,7 @@ void int_mult_virtual_module_wrapper(expression_base::level l)
     pop_value();
     assert(c!=0); // we tested that above
     if (l!=expression_base::no_value)
-    { for (repr::SR_poly::iterator it=m->val.begin(); it!=m->val.end(); ++it)
-        it->second *= c;
+    {@; m->val *= Split_integer(c);
       push_value(std::move(m));
     }
   }
@@ -5874,11 +5873,7 @@ void split_mult_virtual_module_wrapper(expression_base::level l)
   if (l==expression_base::no_value)
     return;
 @)
-  for (repr::SR_poly::iterator it=m->val.begin(); it!=m->val.end(); )
-    // no |++it| here!
-    if ((it->second *= c)==Split_integer(0,0))
-      m->val.erase(it++); // advance, then delete the node just abandoned
-    else ++it;
+  m->val *= c; // removes any terms whose coefficient becomes zero
   push_value(std::move(m));
 }
 
@@ -5892,7 +5887,7 @@ void last_term_wrapper (expression_base::level l)
   if (l==expression_base::no_value)
     return;
 @)
-  if (m->val.empty())
+  if (m->val.is_zero())
     throw runtime_error("Empty module has no last term");
   const auto& term = *m->val.rbegin();
   push_value(std::make_shared<split_int_value>(term.second));
@@ -5907,7 +5902,7 @@ void first_term_wrapper (expression_base::level l)
   if (l==expression_base::no_value)
     return;
 @)
-  if (m->val.empty())
+  if (m->val.is_zero())
     throw runtime_error("Empty module has no first term");
   const auto& term = *m->val.begin();
   push_value(std::make_shared<split_int_value>(term.second));
@@ -6276,9 +6271,11 @@ void full_deform_wrapper(expression_base::level l)
   for (auto it=finals.cbegin(); it!=finals.cend(); ++it)
     res += p->rt().deformation(*it);
 @)
-  repr::SR_poly result;
-  for (const auto& t : res @;@;) // transform to |std::map|
-    result.emplace(p->rt().K_type_sr(t.first),t.second);
+  std::vector<std::pair<StandardRepr,Split_integer> > terms;
+  terms.reserve(res.size());
+  for (const auto& t : res @;@;) // transform to parameters
+    terms.emplace_back(p->rt().K_type_sr(t.first),t.second);
+  repr::SR_poly result(std::move(terms)); // sort by parameter order
   push_value(std::make_shared<virtual_module_value>(p->rf,std::move(result)));
 }
 @)
@@ -6298,12 +6295,99 @@ void twisted_full_deform_wrapper(expression_base::level l)
     res.add_multiple(p->rt().twisted_deformation(it->first) @|
                        ,it->second ? Split_integer(0,1) : Split_integer(1,0));
 @)
-  repr::SR_poly result;
-  for (@[const auto& t : res@]@;@;) // transform to |std::map|
-    result.emplace(p->rt().K_type_sr(t.first),t.second);
+  std::vector<std::pair<StandardRepr,Split_integer> > terms;
+  terms.reserve(res.size());
+  for (@[const auto& t : res@]@;@;) // transform to parameters
+    terms.emplace_back(p->rt().K_type_sr(t.first),t.second);
+  repr::SR_poly result(std::move(terms)); // sort by parameter order
   push_value(std::make_shared<virtual_module_value>(p->rf,std::move(result)));
 }
 
+@ The deformation formulae computed by the functions above are stored in the
+|Rep_table| of the real form, but only for the duration of the session. The
+following functions save them to a file, and add them from such a file to a
+real form, which must be the same one as the one they were saved from (the file
+records the root datum, inner class and real form, and this is checked). Both
+functions return the number of formulae transferred. Since |K_type| values are
+numbered in the order they are encountered, a file is best loaded before any
+deformations are computed; then the table is exactly as when it was saved.
+
+@< Local function def...@>=
+void save_deformations_wrapper(expression_base::level l)
+{ shared_string file_name = get<string_value>();
+  shared_real_form rf = get<real_form_value>();
+  auto count = rf->rt().save_deformations(file_name->val);
+  if (l!=expression_base::no_value)
+    push_value(std::make_shared<int_value>(count));
+}
+@)
+void load_deformations_wrapper(expression_base::level l)
+{ shared_string file_name = get<string_value>();
+  shared_real_form rf = get<real_form_value>();
+  auto count = rf->rt().load_deformations(file_name->val);
+  if (l!=expression_base::no_value)
+    push_value(std::make_shared<int_value>(count));
+}
+
+@ The number of threads set by \.{set\_KL\_threads(rf,n)} ($n=0$ means as
+many as the hardware supports) only affects two kinds of KL table fills: those
+of twisted KL tables, used by the twisted deformation functions and twisted KL
+sums, and the filling of an ordinary KL table up to the highest element of a
+list of parameters passed to \.{KL\_sum\_at\_s}. Those fills compute columns
+of equal length concurrently. The ordinary deformation functions, and KL sums
+for a single parameter, compute just the columns of a KL table that they need,
+sequentially, and the deformation recursion is not parallelised at all. Results
+do not depend on the number of threads. As for \.{klthreads} in \.{Fokko}, at
+most $1023$ threads can be requested.
+
+@< Local function def...@>=
+void set_KL_threads_wrapper(expression_base::level l)
+{ int n_threads = get<int_value>()->int_val();
+  shared_real_form rf = get<real_form_value>();
+  if (n_threads<0)
+    throw runtime_error("Negative number of threads ") << n_threads;
+  if (n_threads>=1024) // same bound as for \.{klthreads} in \.{Fokko}
+    throw runtime_error("Too many threads ") << n_threads;
+  rf->rt().set_threads(n_threads);
+  if (l==expression_base::single_value)
+    wrap_tuple<0>(); // |no_value| needs no special care
+}
+
+@ The blocks that a real form builds for these computations are kept for the
+remainder of the session, which in long computations may take more memory than
+is available. After \.{set\_block\_budget(rf,m)} with $m>0$, blocks that have
+not been used recently are dropped whenever the blocks of |rf| together occupy
+more than $m$ megabytes; they are rebuilt if ever needed again. Stored
+deformation formulae do not refer to blocks, so they are unaffected. The
+function \.{block\_memory} reports the bytes used by each currently stored
+block, and how many blocks were dropped so far.
+
+@< Local function def...@>=
+void set_block_budget_wrapper(expression_base::level l)
+{ int megabytes = get<int_value>()->int_val();
+  shared_real_form rf = get<real_form_value>();
+  if (megabytes<0)
+    throw runtime_error("Negative memory budget ") << megabytes;
+  rf->rt().set_block_budget(static_cast<size_t>(megabytes)<<20);
+  if (l==expression_base::single_value)
+    wrap_tuple<0>(); // |no_value| needs no special care
+}
+@)
+void block_memory_wrapper(expression_base::level l)
+{ shared_real_form rf = get<real_form_value>();
+  if (l==expression_base::no_value)
+    return;
+  const auto sizes = rf->rt().block_memory();
+  own_row result = std::make_shared<row_value>(0);
+  result->val.reserve(sizes.size());
+  for (size_t bytes : sizes)
+    result->val.push_back(std::make_shared<int_value>(bytes));
+  push_value(std::move(result));
+  push_value(std::make_shared<int_value>(rf->rt().evicted_blocks()));
+  if (l==expression_base::single_value)
+    wrap_tuple<2>();
+}
+
 @ And here is another way to invoke the Kazhdan-Lusztig computations, which
 given a parameter corresponding to $y$ will obtain the formal sum over $x$ in
 the block of $y$ (or the Bruhat interval below $y$, where all those giving a
@@ -6316,7 +6400,11 @@ $$
   \sum_{x\leq y}(-1)^{l(y)-l(x)}P_{x,y}[q:=s] * x
 $$
 There are in fact two variants, of this function an ordinary one and one using
-twisted KLV polynomials, computed for the inner class involution.
+twisted KLV polynomials, computed for the inner class involution. The ordinary
+variant can also be applied to a list of parameters, which is faster than
+separate calls when many of them lie in the same block: the parameters are
+grouped by block, and the KL table of each block is filled only once, up to
+the highest element needed.
 
 @< Local function def...@>=
 void KL_sum_at_s_wrapper(expression_base::level l)
@@ -6328,6 +6416,33 @@ void KL_sum_at_s_wrapper(expression_base::level l)
       (p->rf,p->rt().KL_column_at_s(p->val)));
 }
 @)
+void KL_sums_at_s_wrapper(expression_base::level l)
+{ shared_row r = get<row_value>();
+  std::vector<StandardRepr> srs; srs.reserve(r->val.size());
+  shared_real_form rf;
+  for (const auto& entry : r->val)
+  { const module_parameter_value* p =
+      force<module_parameter_value>(entry.get());
+    test_standard(*p,"Cannot compute Kazhdan-Lusztig sum");
+    test_final(*p,"Cannot compute Kazhdan-Lusztig sum");
+    if (rf==nullptr)
+      rf=p->rf;
+    else if (rf!=p->rf)
+      throw runtime_error@|("Real form mismatch in list of parameters");
+    srs.push_back(p->val);
+  }
+  if (l==expression_base::no_value)
+    return;
+@)
+  own_row result = std::make_shared<row_value>(0);
+  result->val.reserve(srs.size());
+  if (rf!=nullptr) // an empty list gives an empty result
+    for (auto& sum : rf->rt().KL_column_at_s(std::move(srs)))
+      result->val.push_back
+        (std::make_shared<virtual_module_value>(rf,std::move(sum)));
+  push_value(std::move(result));
+}
+@)
 void twisted_KL_sum_at_s_wrapper(expression_base::level l)
 { shared_module_parameter p = get<module_parameter_value>();
   test_standard(*p,"Cannot compute Kazhdan-Lusztig sum");
@@ -6382,11 +6497,37 @@ void external_twisted_KL_sum_at_s_wrapper(expression_base::level l)
   test_compatible(p->rc().inner_class(),delta);
   if (not p->rc().is_twist_fixed(p->val,delta->val))
     throw runtime_error("Parameter not fixed by given involution");
-  if (l!=expression_base::no_value)
+  if (l==expression_base::no_value)
+    return;
+  if (delta->val==p->rc().inner_class().distinguished())
+  { // then use the version that keeps and reuses its results
+    auto sr=p->val; // take a copy
+    p->rc().make_dominant(sr);
+    push_value (std::make_shared<virtual_module_value>@|
+      (p->rf,p->rt().twisted_KL_column_at_s(sr)));
+  }
+  else
     push_value (std::make_shared<virtual_module_value>@|
       (p->rf,twisted_KL_column_at_s(p->rc(),p->val,delta->val)));
 }
 
+@ The sums computed by |twisted_KL_sum_at_s_wrapper| are stored in the
+|Rep_table| of the real form, and later calls for the same parameter use them.
+The following function tells how many calls were answered in that way, and
+how many sums had to be computed.
+
+@< Local function def...@>=
+void twisted_KL_sum_counts_wrapper(expression_base::level l)
+{ shared_real_form rf = get<real_form_value>();
+  if (l==expression_base::no_value)
+    return;
+  const auto counts = rf->rt().twisted_KL_sum_counts();
+  push_value(std::make_shared<int_value>(counts.first));
+  push_value(std::make_shared<int_value>(counts.second));
+  if (l==expression_base::single_value)
+    wrap_tuple<2>();
+}
+
 @ The function |scale_extended| is intended for use with in the deformation
 algorithm when interpreting parameters as specifying a representation of he
 extended group. One can arrange that deformation starts with a parameter for
@@ -6509,12 +6650,26 @@ install_function(twisted_deform_wrapper,@|"twisted_deform" ,"(Param->ParamPol)")
 install_function(full_deform_wrapper,@|"full_deform","(Param->ParamPol)");
 install_function(twisted_full_deform_wrapper,@|"twisted_full_deform"
                 ,"(Param->ParamPol)");
+install_function(save_deformations_wrapper,@|"save_deformations"
+                ,"(RealForm,string->int)");
+install_function(load_deformations_wrapper,@|"load_deformations"
+                ,"(RealForm,string->int)");
+install_function(set_KL_threads_wrapper,@|"set_KL_threads"
+                ,"(RealForm,int->)");
+install_function(set_block_budget_wrapper,@|"set_block_budget"
+                ,"(RealForm,int->)");
+install_function(block_memory_wrapper,@|"block_memory"
+                ,"(RealForm->[int],int)");
 install_function(KL_sum_at_s_wrapper,@|"KL_sum_at_s","(Param->ParamPol)");
+install_function(KL_sums_at_s_wrapper,@|"KL_sum_at_s"
+                ,"([Param]->[ParamPol])");
 install_function(twisted_KL_sum_at_s_wrapper,@|"twisted_KL_sum_at_s"
                 ,"(Param->ParamPol)");
 install_function(KL_column_wrapper,@|"KL_column","(Param->[int,Param,vec])");
 install_function(external_twisted_KL_sum_at_s_wrapper,@|"twisted_KL_sum_at_s"
                 ,"(Param,mat->ParamPol)");
+install_function(twisted_KL_sum_counts_wrapper,@|"twisted_KL_sum_counts"
+                ,"(RealForm->int,int)");
 install_function(scale_extended_wrapper,@|"scale_extended"
                 ,"(Param,mat,rat->Param,bool)");
 install_function(finalize_extended_wrapper,@|"finalize_extended"
@@ -6527,22 +6682,159 @@ access to the table of Kazhdan-Lusztig polynomials.
 @< Local function def...@>=
 void raw_KL_wrapper (expression_base::level l)
 { shared_Block b = get<Block_value>();
-  const Block& block = b->val;
   if (l==expression_base::no_value)
     return;
 @)
+  const kl::KL_table& kl_tab = b->kl_tab;
   b->kl_tab.fill(); // this does the actual KL computation
-  own_matrix M = std::make_shared<matrix_value>(int_Matrix(b->kl_tab.size()));
-  for (unsigned int y=1; y<b->kl_tab.size(); ++y)
+  @< Push the KL matrix, the polynomials and the length stops of block |b| @>
+  if (l==expression_base::single_value)
+    wrap_tuple<3>();
+}
+
+@ The KL computation can be done by several threads at once; this is selected
+by giving their number as additional argument to \.{raw\_KL}, where $0$ means
+to use as many threads as the hardware supports. The resulting table, including
+the numbering of the polynomials, does not depend on the number of threads
+used, and neither does the value returned.
+
+@< Local function def...@>=
+void raw_KL_threads_wrapper (expression_base::level l)
+{ int n_threads = get<int_value>()->int_val();
+  shared_Block b = get<Block_value>();
+  if (n_threads<0)
+    throw runtime_error("Negative number of threads ") << n_threads;
+  if (n_threads>=1024) // same bound as for \.{klthreads} in \.{Fokko}
+    throw runtime_error("Too many threads ") << n_threads;
+  if (l==expression_base::no_value)
+    return;
+@)
+  const kl::KL_table& kl_tab = b->kl_tab;
+  b->kl_tab.fill(0,false,n_threads); // this does the actual KL computation
+  @< Push the KL matrix, the polynomials and the length stops of block |b| @>
+  if (l==expression_base::single_value)
+    wrap_tuple<3>();
+}
+
+@ Instead of computing with exact (but overflow-checked) coefficients, one
+can compute the KL polynomials modulo some odd number~$n$, which must be at
+least~$3$. Since the result is not a table of true KL polynomials, it is not
+stored in the block, but in a local |kl::KL_table| that is discarded after use.
+The polynomials returned have their coefficients reduced modulo~$n$; since
+their numbering is that of polynomials modulo~$n$, it will in general differ
+from the one obtained by \.{raw\_KL}.
+
+@< Local function def...@>=
+void raw_KL_mod_wrapper (expression_base::level l)
+{ int n = get<int_value>()->int_val();
+  shared_Block b = get<Block_value>();
+  if (n<3 or n%2==0)
+    throw runtime_error("Modulus should be odd and at least 3, not ") << n;
+  if (l==expression_base::no_value)
+    return;
+@)
+  kl::KL_table kl_tab(b->val,n);
+  kl_tab.fill(); // this does the actual modular KL computation
+  @< Push the KL matrix, the polynomials and the length stops of block |b| @>
+  if (l==expression_base::single_value)
+    wrap_tuple<3>();
+}
+
+@ Computations modulo several numbers can be combined by the Chinese remainder
+theorem to give the exact KL polynomials, provided the product of the moduli
+exceeds all coefficients that occur (which the user must ensure). This is what
+\.{raw\_KL\_CRT} does; the result is stored in the block as for \.{raw\_KL},
+with the same numbering of the polynomials as a direct computation would
+produce, and the value returned is identical as well.
+
+@< Local function def...@>=
+void raw_KL_CRT_wrapper (expression_base::level l)
+{ shared_row moduli = get<row_value>();
+  shared_Block b = get<Block_value>();
+  std::vector<KLCoeff> mods; mods.reserve(moduli->val.size());
+  for (const auto& entry : moduli->val)
+  { int n = force<int_value>(entry.get())->int_val();
+    if (n<3 or n%2==0)
+      throw runtime_error("Modulus should be odd and at least 3, not ") << n;
+    mods.push_back(n);
+  }
+  if (l==expression_base::no_value)
+    return;
+@)
+  const kl::KL_table& kl_tab = b->kl_tab;
+  b->kl_tab.fill_by_CRT(mods); // this does the actual KL computation
+  @< Push the KL matrix, the polynomials and the length stops of block |b| @>
+  if (l==expression_base::single_value)
+    wrap_tuple<3>();
+}
+
+@ To analyse the performance of KL computations, \.{KL\_statistics} reports
+the counters kept by the KL table stored in a block, without computing
+anything. The first component lists pairs of a name and a value, the second
+gives the time spent computing columns, in milliseconds, for each length.
+
+@< Local function def...@>=
+void KL_statistics_wrapper (expression_base::level l)
+{ shared_Block b = get<Block_value>();
+  if (l==expression_base::no_value)
+    return;
+@)
+  const kl::KL_table& kl_tab = b->kl_tab;
+  const kl::Fill_stats& stats = kl_tab.stats();
+  size_t mu_total=0, mu_max=0;
+  for (BlockElt y=0; y<kl_tab.size(); ++y)
+  { const size_t n = kl_tab.mu_column(y).size();
+    mu_total += n;
+    if (n>mu_max)
+      mu_max = n;
+  }
+  const std::pair<const char*,size_t> counters[] = @/
+  { {"columns",stats.columns}, {"hash lookups",stats.lookups}
+  , {"new polynomials",stats.interned}, {"hash enlargements",stats.rehashes}
+  , {"hash slots",stats.hash_slots}
+  , {"polynomials",kl_tab.pol_store().size()}
+  , {"polynomial bytes",kl_tab.pol_store().memory()}
+  , {"matrix bytes",kl_tab.column_memory().first}
+  , {"primitive index bytes",kl_tab.prim_index_memory().first}
+  , {"mu entries",mu_total}, {"longest mu list",mu_max} };
+  own_row result = std::make_shared<row_value>(0);
+  result->val.reserve(sizeof(counters)/sizeof(counters[0]));
+  for (const auto& c : counters)
+  { auto pair=std::make_shared<tuple_value>(2);
+    pair->val[0] = std::make_shared<string_value>(c.first);
+    pair->val[1] = std::make_shared<int_value>(c.second);
+    result->val.push_back(std::move(pair));
+  }
+  push_value(std::move(result));
+@)
+  std::vector<int> ms; ms.reserve(stats.seconds.size());
+  for (double t : stats.seconds)
+    ms.push_back(static_cast<int>(1000*t+0.5));
+  push_value(std::make_shared<vector_value>(ms));
+  if (l==expression_base::single_value)
+    wrap_tuple<2>();
+}
+
+@ The three components of the value returned by \.{raw\_KL} are a matrix of
+polynomial indices, the list of coefficient vectors of those polynomials, and
+the list of block sizes up to each length. They are taken from the table
+|kl_tab|, which will usually be |b->kl_tab|.
+
+@< Push the KL matrix, the polynomials and the length stops of block |b| @>=
+{ const Block& block = b->val;
+  own_matrix M = std::make_shared<matrix_value>(int_Matrix(kl_tab.size()));
+  for (unsigned int y=1; y<kl_tab.size(); ++y)
     for (unsigned int x=0; x<y; ++x)
-      M->val(x,y) = b->kl_tab.KL_pol_index(x,y);
+      M->val(x,y) = kl_tab.KL_pol_index(x,y);
 @)
   own_row polys = std::make_shared<row_value>(0);
-  const auto& store = b->kl_tab.pol_store();
+  const auto& store = kl_tab.pol_store();
   polys->val.reserve(store.size());
   for (auto it=store.begin(); it!=store.end(); ++it)
+  { const KLPol P = *it; // unpack from compact storage
     polys->val.emplace_back(std::make_shared<vector_value> @|
-       (std::vector<int>(it->begin(),it->end())));
+       (std::vector<int>(P.begin(),P.end())));
+  }
 @)
   std::vector<int> length_stops
     (block.size()==0 ? 2 :block.length(block.size()-1)+2);
@@ -6553,8 +6845,6 @@ void raw_KL_wrapper (expression_base::level l)
   push_value(std::move(M));
   push_value(std::move(polys));
   push_value(std::make_shared<vector_value>(length_stops));
-  if (l==expression_base::single_value)
-    wrap_tuple<3>();
 }
 
 @ For testing, it is useful to also have the dual Kazhdan-Lusztig tables. In
@@ -6581,8 +6871,10 @@ void raw_dual_KL_wrapper (expression_base::level l)
   const auto& store = kl_tab.pol_store();
   polys->val.reserve(store.size());
   for (auto it=store.begin(); it!=store.end(); ++it)
+  { const KLPol P = *it; // unpack from compact storage
     polys->val.emplace_back(std::make_shared<vector_value> @|
-       (std::vector<int>(it->begin(),it->end())));
+       (std::vector<int>(P.begin(),P.end())));
+  }
 @)
   std::vector<int> length_stops
     (block.size()==0 ? 2 :block.length(block.size()-1)+2);
@@ -6612,7 +6904,45 @@ void raw_ext_KL_wrapper (expression_base::level l)
   if (l==expression_base::no_value)
     return;
 @)
-  const auto& rc = p->rc();
+  const unsigned int n_threads=1;
+  @< Push the extended KL matrix, polynomials and length stops for |p| and
+     |delta|, computing with |n_threads| threads @>
+  if (l==expression_base::single_value)
+    wrap_tuple<3>();
+}
+
+@ Like for \.{raw\_KL}, the extended KL computation can be done by several
+threads at once, selected by an additional argument. Columns of equal length
+are then computed concurrently, but the numbering of the polynomials, and
+therefore the value returned, does not depend on the number of threads.
+
+@< Local function def...@>=
+void raw_ext_KL_threads_wrapper (expression_base::level l)
+{ int n_threads = get<int_value>()->int_val();
+  auto delta = get<matrix_value>();
+  own_module_parameter p = get_own<module_parameter_value>();
+  test_standard(*p,"Cannot generate block");
+  test_compatible(p->rc().inner_class(),delta);
+  if (n_threads<0)
+    throw runtime_error("Negative number of threads ") << n_threads;
+  if (n_threads>=1024) // same bound as for \.{klthreads} in \.{Fokko}
+    throw runtime_error("Too many threads ") << n_threads;
+  if (l==expression_base::no_value)
+    return;
+@)
+  @< Push the extended KL matrix, polynomials and length stops for |p| and
+     |delta|, computing with |n_threads| threads @>
+  if (l==expression_base::single_value)
+    wrap_tuple<3>();
+}
+
+@ The common part of the previous two functions builds the extended block,
+fills its table of twisted KL polynomials, and pushes the three components of
+the result.
+
+@< Push the extended KL matrix, polynomials and length stops for |p| and
+   |delta|, computing with |n_threads| threads @>=
+{ const auto& rc = p->rc();
   rc.make_dominant(p->val);
   const auto gamma = p->val.gamma();
   const auto srm = repr::StandardReprMod::mod_reduce(rc,p->val);
@@ -6629,7 +6959,7 @@ void raw_ext_KL_wrapper (expression_base::level l)
     ext_block::ext_block eb(block,delta->val,nullptr);
     std::vector<ext_kl::Pol> pool;
     ext_KL_hash_Table hash(pool,4);
-    ext_kl::KL_table klt(eb,&hash); klt.fill_columns();
+    ext_kl::KL_table klt(eb,&hash); klt.fill_columns(0,n_threads);
   @)
     own_matrix M = std::make_shared<matrix_value>(int_Matrix(klt.size()));
     for (unsigned int y=1; y<klt.size(); ++y)
@@ -6647,8 +6977,6 @@ void raw_ext_KL_wrapper (expression_base::level l)
     @< Transfer the coefficient vectors of the polynomials from |pool|... @>
     push_value(std::make_shared<vector_value>(length_stops));
   }
-  if (l==expression_base::single_value)
-    wrap_tuple<3>();
 }
 
 @ For old style blocks, the user may want to get information about the
@@ -6972,8 +7300,17 @@ void print_W_graph_wrapper(expression_base::level l)
 
 @< Install wrapper functions @>=
 install_function(raw_KL_wrapper,@|"raw_KL","(Block->mat,[vec],vec)");
+install_function(raw_KL_threads_wrapper,@|"raw_KL","(Block,int->mat,[vec],vec)");
+install_function(raw_KL_mod_wrapper,@|"raw_KL_mod"
+		,"(Block,int->mat,[vec],vec)");
+install_function(raw_KL_CRT_wrapper,@|"raw_KL_CRT"
+		,"(Block,[int]->mat,[vec],vec)");
+install_function(KL_statistics_wrapper,@|"KL_statistics"
+		,"(Block->[(string,int)],vec)");
 install_function(raw_dual_KL_wrapper,@|"dual_KL","(Block->mat,[vec],vec)");
 install_function(raw_ext_KL_wrapper,@|"raw_ext_KL","(Param,mat->mat,[vec],vec)");
+install_function(raw_ext_KL_threads_wrapper,@|"raw_ext_KL"
+		,"(Param,mat,int->mat,[vec],vec)");
 install_function(W_graph_wrapper,@|"W_graph","(Block->[[int],[int,int]])");
 install_function(W_cells_wrapper,@|"W_cells",
   "(Block->[[int],[[int],[int,int]]])");
@@ -5657,10 +5657,10 @@ between them.
     dst = out_forward(flags) ? result->val.begin() : result->val.end();
   }
   if (in_forward(flags))
-    for (auto it=pol_val->val.cbegin(); it!=pol_val->val.cend(); ++it)
+    for (auto it=pol_val->val.begin(); it!=pol_val->val.end(); ++it)
       @< Loop body for iterating over terms of a virtual module @>
   else
-    for (auto it=pol_val->val.crbegin(); it!=pol_val->val.crend(); ++it)
+    for (auto it=pol_val->val.rbegin(); it!=pol_val->val.rend(); ++it)
       @< Loop body for iterating over terms of a virtual module @>
 }
 
@@ -422,10 +422,10 @@ std::ostream& print_KL(std::ostream& f, blocks::common_block& block,
   unsigned int parity = block.length(z)%2;
   for (size_t x = 0; x <= z; ++x)
   {
-    const kl::KLPol& pol = kl_tab.KL_pol(x,z);
+    kl::KLPolRef pol = kl_tab.KL_pol(x,z);
     if (not pol.isZero())
     {
-      Poly p(pol); // convert
+      Poly p = kl::KLPol(pol); // unpack and convert
       if (block.length(x)%2!=parity)
 	p*=-1;
       auto finals=block.finals_for(x,singular);
@@ -3,10 +3,97 @@
 #include  "basic_io.h"
 #include  "kl.h"
 #include  <iostream>
+#include  <string>
+#include  <stdexcept>
 
 namespace atlas {
   namespace filekl {
 
+    // append |v| to |buf| in groups of 7 bits, least significant first, with the
+    // high bit set in every byte except the last one
+    void put_varint(unsigned long long v, std::string& buf)
+    {
+      for (; v>=0x80; v>>=7)
+        buf.push_back(char((v&0x7F)|0x80));
+      buf.push_back(char(v));
+    }
+
+    // append to |row| the compact encoding of row |y| of the matrix file
+    void encode_compact_row
+      (const kl::KL_table& kl_tab, BlockElt y, std::string& row)
+    {
+      const auto& kld=kl_tab.KL_data(y);
+      size_t n_strong=1; // count |y| itself
+      for (size_t i=0; i<kld.size(); ++i)
+        if (kld[i]!=0)
+          ++n_strong;
+
+      put_varint(kld.size()+1,row); // number of primitive elements, with |y|
+      put_varint(n_strong,row);
+      size_t next=0; // first position not yet accounted for
+      for (size_t i=0; i<kld.size(); ++i)
+        if (kld[i]!=0)
+        { put_varint(i-next,row); next=i+1; } // gap before strong position
+      put_varint(kld.size()-next,row); // the final gap, before |y| itself
+
+      long long prev=0; // previous polynomial index written
+      for (size_t i=0; i<kld.size(); ++i)
+        if (kld[i]!=0)
+        { long long d=static_cast<long long>(kld[i])-prev; prev=kld[i];
+          put_varint(d<0 ? ~static_cast<unsigned long long>(d)<<1|1
+                         : static_cast<unsigned long long>(d)<<1
+                    ,row); // zigzag encoding of the difference
+        }
+    }
+
+    // append the number of coefficients of |p|, then those coefficients, to |buf|
+    void put_polynomial(kl::KLPolRef p, std::string& buf)
+    {
+      if (p.isZero())
+        put_varint(0,buf);
+      else
+      { put_varint(p.degree()+1,buf);
+        for (size_t j=0; j<=p.degree(); ++j)
+          put_varint(p[j],buf);
+      }
+    }
+
+    void write_compact_KL_store(const kl::KLStore& store, std::ostream& out)
+    {
+      // determine the offsets at which the polynomials will be written
+      std::vector<unsigned long long> start; start.reserve(store.size()+1);
+      unsigned long long offset=0, n_coef=0;
+      std::string buf;
+      for (size_t i=0; i<store.size(); ++i)
+      { kl::KLPolRef p=store[i];
+        start.push_back(offset);
+        buf.clear(); put_polynomial(p,buf);
+        offset+=buf.size();
+        if (not p.isZero())
+          n_coef+=p.degree()+1;
+      }
+      start.push_back(offset);
+
+      unsigned int width=1; // number of bytes needed to represent |offset|
+      while (width<8 and offset>>(8*width)!=0)
+        ++width;
+
+      basic_io::put_int(compact_magic_code,out);
+      out.put(char(compact_version));
+      basic_io::put_int(store.size(),out); // write number of KL poynomials
+      basic_io::write_bytes<8>(n_coef,out);
+      out.put(char(width));
+      for (auto pos : start)
+        basic_io::write_bytes(width,pos,out);
+
+      for (size_t i=0; i<store.size(); ++i)
+      { buf.clear(); put_polynomial(store[i],buf);
+        out.write(buf.data(),buf.size());
+      }
+
+      if (not out.good()) throw error::OutputError();
+    }
+
     void write_block_file(const Block& block, std::ostream& out)
     {
       unsigned char rank=block.rank(); // certainly fits in a byte
@@ -66,6 +153,7 @@ namespace atlas {
     write_KL_row(const kl::KL_table& kl_tab, BlockElt y, std::ostream& out)
     {
       BitMap prims=kl_tab.prim_map(y);
+      prims.extend_capacity(true); // add |y| itself, with polynomial 1
       const auto& kld=kl_tab.KL_data(y);
 
       assert(kld.size()+1==prims.capacity()); // check the number of KL polynomials
@@ -98,28 +186,81 @@ namespace atlas {
       return start_row;
     }
 
-    void write_matrix_file(const kl::KL_table& kl_tab, std::ostream& out)
+    matrix_writer::matrix_writer
+      (const kl::KL_table& kl_tab, std::ostream& out, bool compact)
+    : out(out), compact(compact), next_row(0), row_start()
     {
-      std::vector<unsigned int> delta(kl_tab.size());
-      std::streamoff offset=0;
-      for (BlockElt y=0; y<kl_tab.size(); ++y)
-      {
-        std::streamoff new_offset=write_KL_row(kl_tab,y,out);
-        delta[y]=static_cast<unsigned int>((new_offset-offset)/4);
-        offset=new_offset;
+      row_start.reserve(kl_tab.size()+1);
+      if (compact) // write the header; the original format has none
+      { basic_io::put_int(compact_magic_code,out);
+        out.put(char(compact_version));
+        basic_io::put_int(kl_tab.size(),out);
       }
+    }
+
+    void matrix_writer::columns_completed(const kl::KL_table& kl_tab)
+    {
+      const BlockElt limit=kl_tab.first_hole(); // rows before it can be written
+      if (next_row>=limit)
+        return;
+
+      std::string row; // buffer for encoding one row in compact format
+      for (; next_row<limit; ++next_row)
+        if (compact)
+        { row.clear(); encode_compact_row(kl_tab,next_row,row);
+          row_start.push_back(out.tellp());
+          out.write(row.data(),row.size());
+        }
+        else
+          row_start.push_back(write_KL_row(kl_tab,next_row,out));
+
+      // get completed lengths to disk, so that they survive an interrupted run
+      if (next_row==kl_tab.size()
+          or kl_tab.length(next_row)>kl_tab.length(next_row-1))
+        out.flush();
+      if (not out.good()) throw error::OutputError();
+    }
+
+    void matrix_writer::finish(const kl::KL_table& kl_tab)
+    {
+      columns_completed(kl_tab); // write any rows not yet written
+      if (next_row<kl_tab.size())
+        throw std::logic_error("Writing incomplete KL table");
 
       // now write the values allowing rapid location of the matrix rows
-      for (BlockElt y=0; y<kl_tab.size(); ++y)
-        basic_io::put_int(delta[y],out);
+      if (compact)
+      { row_start.push_back(out.tellp()); // end of the final row
+        for (auto pos : row_start)
+          basic_io::write_bytes<5>(pos,out);
+      }
+      else
+      { unsigned long long offset=0;
+        for (auto new_offset : row_start)
+        { basic_io::put_int(static_cast<unsigned int>((new_offset-offset)/4),out);
+          offset=new_offset;
+        }
+
+        // and finally sign file as being in new format by overwriting 4 bytes
+        out.seekp(0,std::ios_base::beg);
+        basic_io::put_int(magic_code,out);
+      }
+
+      if (not out.good()) throw error::OutputError();
+    }
 
-      // and finally sign file as being in new format by overwriting 4 bytes
-      out.seekp(0,std::ios_base::beg);
-      basic_io::put_int(magic_code,out);
+    void write_matrix_file
+      (const kl::KL_table& kl_tab, std::ostream& out, bool compact)
+    {
+      matrix_writer writer(kl_tab,out,compact);
+      writer.finish(kl_tab);
     }
 
-    void write_KL_store(const kl::KLStore& store, std::ostream& out)
+    void write_KL_store
+      (const kl::KLStore& store, std::ostream& out, bool compact)
     {
+      if (compact)
+        { write_compact_KL_store(store,out); return; }
+
       const size_t coef_size=4; // dictated (for now) by |basic_io::put_int|
 
       basic_io::put_int(store.size(),out); // write number of KL poynomials
@@ -4,8 +4,10 @@
 
 
 #include <iosfwd>
+#include <vector>
 
 #include "../Atlas.h"
+#include "kl.h" // for |kl::Fill_observer|
 
 namespace atlas {
   namespace filekl {
@@ -13,13 +15,31 @@ namespace atlas {
     const BlockElt no_good_ascent = UndefBlock-1;
      // value flagging that no good ascent exists
     const unsigned int magic_code=0x06ABdCF0; 
+    const unsigned int compact_magic_code=0x06ABdCF1; // start of compact files
+    const unsigned char compact_version=2; // follows |compact_magic_code|
 
     
     void write_block_file(const Block& block, std::ostream& out);
     
-    void write_matrix_file(const kl::KL_table& kl_tab, std::ostream& out);
+    // writes a matrix file row by row, as soon as columns of |kl_tab| are filled
+    class matrix_writer : public kl::Fill_observer
+    {
+      std::ostream& out;
+      const bool compact; // whether to use the compact format
+      BlockElt next_row; // first row not yet written
+      std::vector<unsigned long long> row_start; // positions of the rows written
+
+    public:
+      matrix_writer(const kl::KL_table& kl_tab, std::ostream& out, bool compact);
+      virtual void columns_completed(const kl::KL_table& kl_tab); // write new rows
+      void finish(const kl::KL_table& kl_tab); // write row index; |kl_tab| is full
+    };
     
-    void write_KL_store(const kl::KLStore& store, std::ostream& out);
+    void write_matrix_file
+      (const kl::KL_table& kl_tab, std::ostream& out, bool compact=false);
+    
+    void write_KL_store
+      (const kl::KLStore& store, std::ostream& out, bool compact=false);
 
   }
 }
@@ -52,6 +52,7 @@ is \.{filekl.cpp}, with others explicitly added below.
 @c
 namespace atlas {
   namespace filekl {
+    @< Local functions for writing compact files @>@;
     @< Functions for writing binary files @>@;
   }@;
 }@;
@@ -82,26 +83,27 @@ and \.{Atlas.h}.
 
 @< Includes needed in the header file @>=
 #include <iosfwd>
+#include <vector>
 
 #include "../Atlas.h"
+#include "kl.h" // for |kl::Fill_observer|
 
-@ The \.{filekl\_in} implementation does a lot of file reading, and notably uses
-the |basic_io::read_bytes| function template to read a fixed number of
-consecutive bytes into an |unsigned long long int| value.
+@ The \.{filekl\_in} implementation does a lot of file reading. Rather than
+going through streams, it maps the files into memory (see the |mapped_file|
+class below), and uses the |get_bytes| function template to decode a fixed
+number of consecutive bytes into an |unsigned long long int| value, in the same
+way |basic_io::read_bytes| would when reading them from a stream.
 
 @( filekl_in.cpp @>=
 
 #include "filekl_in.h"
 #include <stdexcept>
 
-#include "basic_io.h"
 @< Includes needed in the input implementation file @>
 
 namespace atlas {
   namespace filekl {
 
-    using basic_io::read_bytes;
-
     @< Constants common for writing and reading @>@;
 
     @< Methods for reading binary files @>@;
@@ -139,6 +141,7 @@ more elaborate standard header \.{ios}.
 
 @< Includes needed in the input header file @>=
 #include <ios>
+#include <string>
 @)
 #include "bitset.h" // to make |RankFlags| a complete type; used when inlining
 #include "../Atlas.h"
@@ -155,6 +158,8 @@ specific place. It's value was chosen in memory of Fokko du Cloux.
 const BlockElt no_good_ascent = UndefBlock-1;
  // value flagging that no good ascent exists
 const unsigned int magic_code=0x06ABdCF0; // indication of new matrix format
+const unsigned int compact_magic_code=0x06ABdCF1; // start of compact files
+const unsigned char compact_version=2; // follows |compact_magic_code|
 
 @* Writing a block file.
 Here is how a block file is written.
@@ -228,6 +233,133 @@ void write_block_file(const Block& block, std::ostream& out)
   }
 }
 
+@* The {\bf mapped\_file} class.
+%
+The files read by the classes below can be huge (hundreds of gigabytes for the
+big block of~$E_8$), and are accessed at random places, so rather than reading
+them through streams, with a system call for every seek and read, we map them
+into memory using \.{mmap}. Once that is done, all data are addressed directly,
+and the operating system brings into memory just the pages that are actually
+used; moreover, several processes reading the same file share those pages.
+
+A |mapped_file| owns the mapping of a read-only file. The method |at| gives
+access to a range of bytes, after checking that they are all present in the
+file, so that malformed files cause an exception rather than a crash. The
+mapping is shared with the page cache (|MAP_SHARED|), and since we only read,
+nothing is ever written back.
+
+@< Input class declarations @>=
+
+class mapped_file
+{
+  const unsigned char* d_data; // start of the (read-only) mapped contents
+  ullong d_size;               // size of the file in bytes
+
+public:
+  explicit mapped_file(const std::string& name); // map file, or throw
+  ~mapped_file();
+  mapped_file(const mapped_file&) = delete; // copying forbidden
+  mapped_file& operator=(const mapped_file&) = delete;
+@)
+  ullong size() const @+{@; return d_size; }
+  // pointer to |n| bytes at |offset|, or throw if they are not all present
+  const unsigned char* at(ullong offset, ullong n) const;
+};
+
+@)
+// decode |n| bytes at |p| as little-endian number, like |read_bytes| does
+template<unsigned int n> ullong get_bytes(const unsigned char* p);
+template<> inline ullong get_bytes<1>(const unsigned char* p)
+  @+{@; return p[0]; }
+template<unsigned int n> inline ullong get_bytes(const unsigned char* p)
+  @+{@; return p[0]+(get_bytes<n-1>(p+1)<<8); }
+ullong get_var_bytes(unsigned int n, const unsigned char* p);
+ullong get_varint(const unsigned char*& p, const unsigned char* end);
+
+@*1 Methods of the {\bf mapped\_file} class.
+%
+The file descriptor is only needed to establish the mapping, so we close it
+right away. Since \.{mmap} refuses to map an empty range, an empty file is
+represented without a mapping; any |at| access then fails, as it should.
+
+@< Includes needed in the input implementation file @>=
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+@~@< Methods for reading binary files @>=
+
+mapped_file::mapped_file(const std::string& name)
+: d_data(nullptr), d_size(0)
+{
+  int fd=open(name.c_str(),O_RDONLY);
+  if (fd<0)
+    throw std::runtime_error("Cannot open file "+name);
+  struct stat status;
+  if (fstat(fd,&status)!=0)
+  {@; close(fd);
+    throw std::runtime_error("Cannot determine size of file "+name);
+  }
+  d_size=status.st_size;
+  if (d_size>0) // |mmap| refuses empty ranges, but empty files are OK here
+  { void* p=mmap(nullptr,d_size,PROT_READ,MAP_SHARED,fd,0);
+    if (p==MAP_FAILED)
+    {@; close(fd);
+      throw std::runtime_error("Cannot map file "+name);
+    }
+    d_data=static_cast<const unsigned char*>(p);
+  }
+  close(fd); // the mapping remains valid without the file descriptor
+}
+
+mapped_file::~mapped_file()
+{ if (d_size>0)
+    munmap(const_cast<unsigned char*>(d_data),d_size);
+}
+
+const unsigned char* mapped_file::at(ullong offset, ullong n) const
+{ if (offset>d_size or n>d_size-offset)
+    throw std::runtime_error("Premature end of file");
+  return d_data+offset;
+}
+
+@ The function |get_var_bytes| is the analogue of |basic_io::read_var_bytes|,
+for a number of bytes only known at run time.
+
+@< Methods for reading binary files @>=
+
+ullong get_var_bytes(unsigned int n, const unsigned char* p)
+{ switch(n)
+  { case 1: return get_bytes<1>(p);
+    case 2: return get_bytes<2>(p);
+    case 3: return get_bytes<3>(p);
+    case 4: return get_bytes<4>(p);
+    case 5: return get_bytes<5>(p);
+    case 6: return get_bytes<6>(p);
+    case 7: return get_bytes<7>(p);
+    case 8: return get_bytes<8>(p);
+  default: throw std::runtime_error("Illegal get_var_bytes");
+  }
+}
+
+@ Compact files use variable length numbers, in groups of $7$ bits with the
+high bit set in all bytes but the last. The function |get_varint| decodes one,
+advancing |p|, without reading at or beyond |end|.
+
+@< Methods for reading binary files @>=
+
+ullong get_varint(const unsigned char*& p, const unsigned char* end)
+{ ullong result=0;
+  for (unsigned int shift=0; p<end and shift<64; shift+=7)
+  { unsigned char b=*p++;
+    result |= ullong(b&0x7F)<<shift;
+    if ((b&0x80)==0)
+      return result;
+  }
+  throw std::runtime_error("Bad variable length number");
+}
+
 @* The {\bf block\_info} class.
 
 @< Input class declarations @>=
@@ -257,7 +389,7 @@ private:
   prim_table primitives_list; // lists of weakly primitives, per descent set
 
 public:
-  block_info(std::ifstream& in); // constructor reads, and closes, file
+  block_info(const mapped_file& in); // constructor reads the whole file
 
   BlockElt primitivize(BlockElt x, BlockElt y) const;
   const prim_list& prims_for_descents_of(BlockElt y);
@@ -313,30 +445,35 @@ const prim_list& block_info::prims_for_descents_of(BlockElt y)
   return result;
 }
 
-@
-@< Includes needed in the input implementation file @>=
-#include <fstream>
-@~@< Methods for reading binary files @>=
+@ The block file is small compared to the other files, and its contents are
+used all the time, so we copy it into vectors once and for all. After the
+header, the remaining data has a size determined by that header, so we can
+check their presence at once.
+
+@< Methods for reading binary files @>=
 
-block_info::block_info(std::ifstream& in)
+block_info::block_info(const mapped_file& in)
   : rank(), size(), max_length(), start_length()
   , descent_set(), ascents(), primitives_list() // don't initialize yet
 {
-  in.seekg(0,std::ios_base::beg); // ensure we are reading from the start
-  size=read_bytes<4>(in);
-  rank=read_bytes<1>(in);
-  max_length=read_bytes<1>(in);
+  const unsigned char* p=in.at(0,6);
+  size=get_bytes<4>(p);
+  rank=get_bytes<1>(p+4);
+  max_length=get_bytes<1>(p+5);
+
+  // all further data has fixed size; get it at once, checking its presence
+  p=in.at(6,4*(max_length+ullong(size)*(1+rank)));
 
   // read intervals of block elements for each length
   start_length.resize(max_length+2);
   start_length[0]=BlockElt(0);
-  for (size_t i=1; i<=max_length; ++i) start_length[i]=read_bytes<4>(in);
+  for (size_t i=1; i<=max_length; ++i,p+=4) start_length[i]=get_bytes<4>(p);
   start_length[max_length+1]=size;
 
   // read descent sets
   descent_set.reserve(size);
-  for (BlockElt y=0; y<size; ++y)
-    descent_set.push_back(RankFlags(read_bytes<4>(in)));
+  for (BlockElt y=0; y<size; ++y,p+=4)
+    descent_set.push_back(RankFlags(get_bytes<4>(p)));
 
   // read ascent table
   ascents.reserve(size);
@@ -345,8 +482,8 @@ block_info::block_info(std::ifstream& in)
       ascents.push_back(ascent_vector());
       ascent_vector& a=ascents.back();
       a.reserve(rank);
-      for (size_t s=0; s<rank; ++s)
-	a.push_back(read_bytes<4>(in));
+      for (size_t s=0; s<rank; ++s,p+=4)
+	a.push_back(get_bytes<4>(p));
     }
 
   // lists of primitives lazily computed, on demand by |prims_for_descents_of|
@@ -366,6 +503,7 @@ std::streamoff
 write_KL_row(const kl::KL_table& kl_tab, BlockElt y, std::ostream& out)
 {
   BitMap prims=kl_tab.prim_map(y); // marks nonzero KL polys among primitives
+  prims.extend_capacity(true); // add |y| itself, with polynomial 1
   const auto& kld=kl_tab.KL_data(y);
 
   assert(kld.size()+1==prims.capacity()); // check the number of KL polynomials
@@ -398,31 +536,113 @@ write_KL_row(const kl::KL_table& kl_tab, BlockElt y, std::ostream& out)
   return start_row;
 }
 
-@
+@ To allow writing the matrix file while the KL table is being computed, the
+rows are written by a |matrix_writer| object. It can be installed as observer
+of the |KL_table| during |fill|, which then calls |columns_completed| whenever
+it is in a coherent state; all rows before the first column not yet computed
+are then written. Once the table is complete, |finish| writes any remaining
+rows, and the table allowing rows to be located quickly. Whenever rows written
+complete a length, the stream is flushed, so that the rows of an interrupted
+computation are on disk.
+
+@h <string>
+@h <stdexcept>
 
 @< Declarations of exported functions @>=
-void write_matrix_file(const kl::KL_table& kl_tab, std::ostream& out);
+// writes a matrix file row by row, as soon as columns of |kl_tab| are filled
+class matrix_writer : public kl::Fill_observer
+{
+  std::ostream& out;
+  const bool compact; // whether to use the compact format
+  BlockElt next_row; // first row not yet written
+  std::vector<unsigned long long> row_start; // positions of the rows written
 
-@~@< Functions for writing binary files @>=
+public:
+  matrix_writer(const kl::KL_table& kl_tab, std::ostream& out, bool compact);
+  virtual void columns_completed(const kl::KL_table& kl_tab); // write new rows
+  void finish(const kl::KL_table& kl_tab); // write row index; |kl_tab| is full
+};
 
-void write_matrix_file(const kl::KL_table& kl_tab, std::ostream& out)
+@~When |compact| holds, the file is written in the compact format described
+below; otherwise as described above.
+
+@< Functions for writing binary files @>=
+
+matrix_writer::matrix_writer
+  (const kl::KL_table& kl_tab, std::ostream& out, bool compact)
+: out(out), compact(compact), next_row(0), row_start()
 {
-  std::vector<unsigned int> delta(kl_tab.size());
-  std::streamoff offset=0;
-  for (BlockElt y=0; y<kl_tab.size(); ++y)
-  {
-    std::streamoff new_offset=write_KL_row(kl_tab,y,out);
-    delta[y]=static_cast<unsigned int>((new_offset-offset)/4);
-    offset=new_offset;
+  row_start.reserve(kl_tab.size()+1);
+  if (compact) // write the header; the original format has none
+  { basic_io::put_int(compact_magic_code,out);
+    out.put(char(compact_version));
+    basic_io::put_int(kl_tab.size(),out);
   }
+}
+
+void matrix_writer::columns_completed(const kl::KL_table& kl_tab)
+{
+  const BlockElt limit=kl_tab.first_hole(); // rows before it can be written
+  if (next_row>=limit)
+    return;
+
+  std::string row; // buffer for encoding one row in compact format
+  for (; next_row<limit; ++next_row)
+    if (compact)
+    { row.clear(); encode_compact_row(kl_tab,next_row,row);
+      row_start.push_back(out.tellp());
+      out.write(row.data(),row.size());
+    }
+    else
+      row_start.push_back(write_KL_row(kl_tab,next_row,out));
+
+  // get completed lengths to disk, so that they survive an interrupted run
+  if (next_row==kl_tab.size()
+      or kl_tab.length(next_row)>kl_tab.length(next_row-1))
+    out.flush();
+  if (not out.good()) throw error::OutputError();
+}
+
+void matrix_writer::finish(const kl::KL_table& kl_tab)
+{
+  columns_completed(kl_tab); // write any rows not yet written
+  if (next_row<kl_tab.size())
+    throw std::logic_error("Writing incomplete KL table");
 
   // now write the values allowing rapid location of the matrix rows
-  for (BlockElt y=0; y<kl_tab.size(); ++y)
-    basic_io::put_int(delta[y],out);
+  if (compact)
+  { row_start.push_back(out.tellp()); // end of the final row
+    for (auto pos : row_start)
+      basic_io::write_bytes<5>(pos,out);
+  }
+  else
+  { unsigned long long offset=0;
+    for (auto new_offset : row_start)
+    { basic_io::put_int(static_cast<unsigned int>((new_offset-offset)/4),out);
+      offset=new_offset;
+    }
 
-  // and finally sign file as being in new format by overwriting 4 bytes
-  out.seekp(0,std::ios_base::beg);
-  basic_io::put_int(magic_code,out);
+    // and finally sign file as being in new format by overwriting 4 bytes
+    out.seekp(0,std::ios_base::beg);
+    basic_io::put_int(magic_code,out);
+  }
+
+  if (not out.good()) throw error::OutputError();
+}
+
+@ Writing the matrix file for a complete table just uses a |matrix_writer|.
+
+@< Declarations of exported functions @>=
+void write_matrix_file
+  (const kl::KL_table& kl_tab, std::ostream& out, bool compact=false);
+
+@~@< Functions for writing binary files @>=
+
+void write_matrix_file
+  (const kl::KL_table& kl_tab, std::ostream& out, bool compact)
+{
+  matrix_writer writer(kl_tab,out,compact);
+  writer.finish(kl_tab);
 }
 
 @*The {\bf matrix\_info} class.
@@ -436,26 +656,29 @@ typedef prim_list strong_prim_list;
 
 class matrix_info
 {
-  std::ifstream& matrix_file; // non-owned reference to (open) file
+  const mapped_file& matrix_file; // non-owned reference to mapped file
 
   block_info block;
 
-  std::vector<std::streampos> row_pos; // positions where each row starts
+  bool compact; // whether the file is in compact format
+  std::vector<ullong> row_pos; // offsets where each row starts
 
 // data for currently selected row~|y|
   BlockElt cur_y;		// row number
   strong_prim_list cur_strong_prims;   // strongly primitives for this row
-  std::streampos cur_row_entries; // indices of polynomials for row start here
+  ullong cur_row_entries; // indices of polynomials for row start here
+  std::vector<KLIndex> cur_entries; // decoded indices, for compact files only
 
 //private methods
   matrix_info(const matrix_info&); // copying forbidden
   void set_y(BlockElt y);  // install |cur_y| and dependent data
+  void decode_compact_row(BlockElt y, const prim_list& weak_prims);
 
 public:
   BlockElt x_prim; // public variable that is set by |find_pol_nr|
 
 // constructor and destructor
-  matrix_info(std::ifstream& block_file,std::ifstream& m_file);
+  matrix_info(const mapped_file& block_file,const mapped_file& m_file);
   ~matrix_info() {}
 
 // accessors
@@ -490,28 +713,38 @@ size_t matrix_info::length (BlockElt y) const
     -1; // now we have just |l(y)|
 }
 
-@
+@ Selecting a row decodes its bitmap of strongly primitive elements, and
+records where the polynomial indices for the row start. Nothing needs to be
+done when the row is already selected: unlike a stream position, the mapped
+data are not disturbed by other accesses.
+
 @< Methods for reading binary files @>=
 
 void matrix_info::set_y(BlockElt y)
 {
   if (y==cur_y)
-    {@; matrix_file.seekg(cur_row_entries); return; }
+    return;
   cur_y=y;
   const prim_list& weak_prims = block.prims_for_descents_of(y);
   cur_strong_prims.resize(0);
   // restart building from scratch, but don't deallocate storage
 
-  matrix_file.seekg(row_pos[y]);
-  size_t n_prim=read_bytes<4>(matrix_file);
-
+  if (compact)
+    decode_compact_row(y,weak_prims);
+  else
+  {
+    size_t n_prim=get_bytes<4>(matrix_file.at(row_pos[y],4));
+    cur_row_entries=row_pos[y]+4+4*ullong((n_prim+31)/32); // after bitmap
+    const unsigned char* p=
+      matrix_file.at(row_pos[y]+4,cur_row_entries-(row_pos[y]+4));
 
-  for (size_t i=0; i<n_prim; i+=32)
-    {
-      unsigned int chunk=read_bytes<4>(matrix_file);
-      for (size_t j=0; chunk!=0; ++j,chunk>>=1) // and certainly |j<32|
-        if ((chunk&1)!=0) cur_strong_prims.push_back(weak_prims[i+j]);
-    }
+    for (size_t i=0; i<n_prim; i+=32,p+=4)
+      {
+	unsigned int chunk=get_bytes<4>(p);
+	for (size_t j=0; chunk!=0; ++j,chunk>>=1) // and certainly |j<32|
+	  if ((chunk&1)!=0) cur_strong_prims.push_back(weak_prims[i+j]);
+      }
+  }
 
   {
 #ifndef NDEBUG
@@ -533,8 +766,38 @@ void matrix_info::set_y(BlockElt y)
 #endif
     cur_strong_prims.back()=y; // replace by |y|
   }
+}
+
+@ In the compact format, selecting a row decodes the positions of the strongly
+primitive elements among the weakly primitive ones from their gaps, and also
+the polynomial indices for the row, which are stored as zigzag-encoded
+differences with their predecessor in the row.
 
-  cur_row_entries=matrix_file.tellg();
+@< Methods for reading binary files @>=
+
+void matrix_info::decode_compact_row(BlockElt y, const prim_list& weak_prims)
+{
+  const unsigned char* p=matrix_file.at(row_pos[y],row_pos[y+1]-row_pos[y]);
+  const unsigned char* end=p+(row_pos[y+1]-row_pos[y]);
+  size_t n_prim=get_varint(p,end);
+  size_t n_strong=get_varint(p,end);
+  if (n_strong==0 or n_prim>weak_prims.size())
+    throw std::runtime_error("Bad compact matrix row");
+
+  for (size_t i=0,k=0; k<n_strong; ++i,++k)
+  { i+=get_varint(p,end); // skip weakly primitive elements that are not strong
+    if (i>=n_prim)
+      throw std::runtime_error("Bad compact matrix row");
+    cur_strong_prims.push_back(weak_prims[i]);
+  }
+
+  cur_entries.resize(0);
+  long long prev=0;
+  for (size_t k=1; k<n_strong; ++k) // no index is recorded for |y| itself
+  { ullong d=get_varint(p,end); // zigzag encoded difference with |prev|
+    prev += (d&1)!=0 ? ~static_cast<long long>(d>>1) : static_cast<long long>(d>>1);
+    cur_entries.push_back(KLIndex(prev));
+  }
 }
 
 @
@@ -551,8 +814,10 @@ KLIndex matrix_info::find_pol_nr(BlockElt x,BlockElt y)
   if (it==cur_strong_prims.end() or *it!=x_prim)
     return KLIndex(0); // not strong
 
-  matrix_file.seekg(4*size_t(it-cur_strong_prims.begin()),std::ios_base::cur);
-  return KLIndex(read_bytes<4>(matrix_file));
+  if (compact)
+    return cur_entries[it-cur_strong_prims.begin()];
+  return KLIndex(get_bytes<4>(matrix_file.at
+    (cur_row_entries+4*ullong(it-cur_strong_prims.begin()),4)));
 }
 
 
@@ -580,62 +845,76 @@ BlockElt matrix_info::prim_nr(unsigned int i,BlockElt y)
 @< Methods for reading binary files @>=
 
 matrix_info::matrix_info
-  (std::ifstream& block_file,std::ifstream& m_file)
+  (const mapped_file& block_file,const mapped_file& m_file)
 : matrix_file(m_file) // store reference to the matrix file
   , block(block_file) // read in block information
+  , compact(get_bytes<4>(matrix_file.at(0,4))==compact_magic_code)
   , row_pos(block.size) // dimension these vectors
-  , cur_y(UndefBlock), cur_strong_prims(), cur_row_entries(0)
+  , cur_y(UndefBlock), cur_strong_prims(), cur_row_entries(0), cur_entries()
 {
-  matrix_file.seekg(0,std::ios_base::beg);
-  if (read_bytes<4>(matrix_file)==magic_code)
-  { matrix_file.seekg(-4*std::streamoff(block_size()),std::ios_base::end);
-    std::streamoff cumul=0;
-    for (BlockElt y=0; y<block_size(); ++y)
-    { cumul+= 4*std::streamoff(read_bytes<4>(matrix_file));
+  if (compact)
+  { const unsigned char* p=matrix_file.at(4,5);
+    if (p[0]!=compact_version)
+      throw std::runtime_error ("Unknown compact matrix file version");
+    if (get_bytes<4>(p+1)!=block_size())
+      throw std::runtime_error ("Matrix file does not match block file");
+    const ullong table_size=5*(ullong(block_size())+1);
+    if (matrix_file.size()<table_size)
+      throw std::runtime_error ("Premature end of file");
+    p=matrix_file.at(matrix_file.size()-table_size,table_size);
+    row_pos.resize(block_size()+1); // include end of final row
+    for (BlockElt y=0; y<=block_size(); ++y,p+=5)
+    {@; row_pos[y]=get_bytes<5>(p);
+      if (row_pos[y]>matrix_file.size()-table_size
+          or (y>0 and row_pos[y]<row_pos[y-1]))
+        throw std::runtime_error ("Bad row offset in compact matrix file");
+    }
+  }
+
+  else if (get_bytes<4>(matrix_file.at(0,4))==magic_code)
+  { const ullong table_size=4*ullong(block_size());
+    if (matrix_file.size()<table_size)
+      throw std::runtime_error ("Premature end of file");
+    const unsigned char* p=
+      matrix_file.at(matrix_file.size()-table_size,table_size);
+    ullong cumul=0;
+    for (BlockElt y=0; y<block_size(); ++y,p+=4)
+    {@; cumul+= 4*get_bytes<4>(p);
       row_pos[y] = cumul;
     }
   }
 
   else // read old file format, scanning the whole file
   {
-    size_t l=0; // length of y
-    matrix_file.seekg(0,std::ios_base::beg);
+    ullong pos=0; // offset into |matrix_file|
     for (BlockElt y=0; y<block.size; ++y)
     {
-      while (y>=block.start_length[l+1]) ++l;
-
-      if (read_bytes<4>(matrix_file)!=y and y!=0)
-      { std::cerr << y << std::endl;
+      if (get_bytes<4>(matrix_file.at(pos,4))!=y and y!=0)
+      {@; std::cerr << y << std::endl;
         throw std::runtime_error ("Alignment problem");
       }
-      row_pos[y]= matrix_file.tellg(); // record position after row number
-      size_t n_prim=read_bytes<4>(matrix_file);
+      row_pos[y]= pos+=4; // record position after row number
+      size_t n_prim=get_bytes<4>(matrix_file.at(pos,4));
+      pos+=4;
 
       { size_t n_strong_prim=0;
         { // compute number of entries to skip, while reading bitmap
-	  static const unsigned int ulsize=sizeof(unsigned long int);
-	  size_t count=n_prim/(8*ulsize); // number of |unsigned long|s to read
-
-	  while (count-->0)
-	    n_strong_prim+=bits::bitCount(read_bytes<ulsize>(matrix_file));
-
-	  count=(n_prim%(8*ulsize)+31)/32; // maybe some tetra-byte(s) left
-	  while (count-->0)
-	    n_strong_prim+=bits::bitCount(read_bytes<4>(matrix_file));
+	  const ullong n_words=(n_prim+31)/32;
+	  const unsigned char* p=matrix_file.at(pos,4*n_words);
+	  for (ullong i=0; i<n_words; ++i,p+=4)
+	    n_strong_prim+=bits::bitCount(get_bytes<4>(p));
+	  pos+=4*n_words;
 	}
 
 	// now skip over matrix entries
-	matrix_file.seekg(4*std::streamoff(n_strong_prim)
-			 ,std::ios_base::cur);
+	pos+=4*ullong(n_strong_prim);
       }
-      if (not matrix_file.good())
-      { std::cerr << y << std::endl;
+      if (pos>matrix_file.size())
+      {@; std::cerr << y << std::endl;
 	throw std::runtime_error ("Premature end of file");
       }
     } // for (BlockElt y...)
   } // |if (...==magic_code)|
-
-  block_file.close(); // success, we no longer need the block file
 }
 
 
@@ -643,7 +922,8 @@ matrix_info::matrix_info
 Here is how the polynomial file is written
 
 @< Declarations of exported functions @>=
-void write_KL_store(const kl::KLStore& store, std::ostream& out);
+void write_KL_store
+  (const kl::KLStore& store, std::ostream& out, bool compact=false);
 
 @~This routine prefers a simple format over an extremely space-optimised
 representation on disk. After writing the number |N| of polynomials in
@@ -658,8 +938,12 @@ size, is the number of coefficients, the degree is one less.
 
 @< Functions for writing binary files @>=
 
-void write_KL_store(const kl::KLStore& store, std::ostream& out)
+void write_KL_store
+  (const kl::KLStore& store, std::ostream& out, bool compact)
 {
+  if (compact)
+    {@; write_compact_KL_store(store,out); return; }
+
   const size_t coef_size=4; // dictated (for now) by |basic_io::put_int|
 
   basic_io::put_int(store.size(),out); // write number of KL poynomials
@@ -691,11 +975,131 @@ void write_KL_store(const kl::KLStore& store, std::ostream& out)
   }
 }
 
+@* Writing files in compact format.
+%
+The formats above use fixed-width fields, which makes them simple to read but
+wasteful of space: most polynomial indices in a row, and most coefficients,
+need far fewer than $4$ bytes. The compact format, selected by the |compact|
+argument of |write_matrix_file| and |write_KL_store|, uses variable length
+encoding instead: a number is written in groups of $7$ bits, least significant
+first, with the high bit set in every byte but the last one.
+
+Both compact files start with the $4$-byte |compact_magic_code| followed by the
+byte |compact_version|; old polynomial files start with their number of
+polynomials, but then have a zero byte, so the two cannot be confused. For
+the matrix file there follows the block size in $4$ bytes, and then the rows.
+Each row gives the number of primitive elements (with |y| included), the
+number of strongly primitive ones, then for each of them the number of
+primitive elements skipped since the previous one, and finally, for all but
+the last (which is |y| itself, with polynomial~$1$), the difference of its
+polynomial index with the previous one, zigzag-encoded so that small negative
+differences remain small. At the end of the file, the offsets of the rows
+within the file, and that of the end of the final row, are given in $5$ bytes
+each, so that rows can be located directly. The rows are written by
+|matrix_writer| above, using |encode_compact_row|.
+
+@< Local functions for writing compact files @>=
+
+// append |v| to |buf| in groups of 7 bits, least significant first, with the
+// high bit set in every byte except the last one
+void put_varint(unsigned long long v, std::string& buf)
+{
+  for (; v>=0x80; v>>=7)
+    buf.push_back(char((v&0x7F)|0x80));
+  buf.push_back(char(v));
+}
+
+// append to |row| the compact encoding of row |y| of the matrix file
+void encode_compact_row
+  (const kl::KL_table& kl_tab, BlockElt y, std::string& row)
+{
+  const auto& kld=kl_tab.KL_data(y);
+  size_t n_strong=1; // count |y| itself
+  for (size_t i=0; i<kld.size(); ++i)
+    if (kld[i]!=0)
+      ++n_strong;
+
+  put_varint(kld.size()+1,row); // number of primitive elements, with |y|
+  put_varint(n_strong,row);
+  size_t next=0; // first position not yet accounted for
+  for (size_t i=0; i<kld.size(); ++i)
+    if (kld[i]!=0)
+    {@; put_varint(i-next,row); next=i+1; } // gap before strong position
+  put_varint(kld.size()-next,row); // the final gap, before |y| itself
+
+  long long prev=0; // previous polynomial index written
+  for (size_t i=0; i<kld.size(); ++i)
+    if (kld[i]!=0)
+    { long long d=static_cast<long long>(kld[i])-prev; prev=kld[i];
+      put_varint(d<0 ? ~static_cast<unsigned long long>(d)<<1|1
+		     : static_cast<unsigned long long>(d)<<1
+		,row); // zigzag encoding of the difference
+    }
+}
+
+@ The compact polynomial file has after the header the number of polynomials
+in $4$ bytes, the total number of coefficients in $8$ bytes, and a byte giving
+the width |width| of the offsets that follow: one for each polynomial, and
+one for the end of the data, relative to the start of the data. Then for each
+polynomial its number of coefficients and its coefficients (constant term
+first) follow, all in variable length encoding.
+
+@< Local functions for writing compact files @>=
+
+// append the number of coefficients of |p|, then those coefficients, to |buf|
+void put_polynomial(kl::KLPolRef p, std::string& buf)
+{
+  if (p.isZero())
+    put_varint(0,buf);
+  else
+  { put_varint(p.degree()+1,buf);
+    for (size_t j=0; j<=p.degree(); ++j)
+      put_varint(p[j],buf);
+  }
+}
+
+void write_compact_KL_store(const kl::KLStore& store, std::ostream& out)
+{
+  // determine the offsets at which the polynomials will be written
+  std::vector<unsigned long long> start; start.reserve(store.size()+1);
+  unsigned long long offset=0, n_coef=0;
+  std::string buf;
+  for (size_t i=0; i<store.size(); ++i)
+  { kl::KLPolRef p=store[i];
+    start.push_back(offset);
+    buf.clear(); put_polynomial(p,buf);
+    offset+=buf.size();
+    if (not p.isZero())
+      n_coef+=p.degree()+1;
+  }
+  start.push_back(offset);
+
+  unsigned int width=1; // number of bytes needed to represent |offset|
+  while (width<8 and offset>>(8*width)!=0)
+    ++width;
+
+  basic_io::put_int(compact_magic_code,out);
+  out.put(char(compact_version));
+  basic_io::put_int(store.size(),out); // write number of KL poynomials
+  basic_io::write_bytes<8>(n_coef,out);
+  out.put(char(width));
+  for (auto pos : start)
+    basic_io::write_bytes(width,pos,out);
+
+  for (size_t i=0; i<store.size(); ++i)
+  { buf.clear(); put_polynomial(store[i],buf);
+    out.write(buf.data(),buf.size());
+  }
+
+  if (not out.good()) throw error::OutputError();
+}
+
 @* The {\bf polynomial\_info} class.
 %
 The class |polynomial_info| gives access to polynomials stored in a file, using
-random file access to treat the storage as an indexable repository of
-polynomials. The method |coefficients| produces the polynomial at a given index,
+the mapped file to treat the storage as an indexable repository of
+polynomials. Since no stream state is involved, its accessor methods can be
+called concurrently. The method |coefficients| produces the polynomial at a given index,
 and the virtual methods |degree| and |leading_coefficient| give less complete
 information, but which is expected to be most frequently accessed. A derived
 class might want to devote some memory to speeding up those accesses.
@@ -703,16 +1107,19 @@ class might want to devote some memory to speeding up those accesses.
 @< Input class declarations @>=
 class polynomial_info
 {
-  std::ifstream& file; // non-owned reference to (open) file
-
   KLIndex n_pols;         // number of polynomials in file
-  unsigned int coef_size; // number of bytes per coefficient
+  unsigned int coef_size; // number of bytes per coefficient, 0 if variable
   ullong n_coef;          // number of coefficients
-  std::streamoff index_begin, coefficients_begin;
+  unsigned int index_width; // number of bytes per index entry
+  const unsigned char* index_begin; // within non-owned mapped file
+  const unsigned char* coefficients_begin; // likewise
+@)
+  ullong pol_offset(KLIndex i) const // offset of polynomial |i| among coefficients
+  {@; return get_var_bytes(index_width,index_begin+index_width*ullong(i)); }
 
 public:
-  polynomial_info(std::ifstream& coefficient_file);
-  virtual ~polynomial_info();
+  polynomial_info(const mapped_file& coefficient_file);
+  virtual ~polynomial_info() @+{}
 @)
   KLIndex n_polynomials() const @+{@; return n_pols; }
   unsigned int coefficient_size() const @+{@; return coef_size; }
@@ -724,20 +1131,41 @@ public:
 };
 
 @*1 Methods of the {\bf polynomial\_info} class.
+%
+The constructor checks that the index and the coefficients are all present in
+the file, so that afterwards the accessors can address them without checks. A
+file in compact format is recognised by its initial |compact_magic_code| and
+|compact_version|; for it |coef_size| is set to~$0$, which the accessors take
+as indication that lengths and coefficients must be decoded as variable length
+numbers.
 
 @< Methods for reading binary files @>=
 
-polynomial_info::polynomial_info (std::ifstream& coefficient_file)
-: file(coefficient_file), n_pols(read_bytes<4>(file))
-, coef_size(), index_begin(file.tellg()), coefficients_begin()
-{ file.seekg(10,std::ios_base::cur); // skip initial 2 indices
-  coef_size=read_bytes<5>(file); // size of the |One|
-  file.seekg(index_begin+5*n_pols,std::ios_base::beg);
-  n_coef=read_bytes<5>(file)/coef_size;
-  coefficients_begin=file.tellg();
-}
+polynomial_info::polynomial_info (const mapped_file& file)
+: n_pols(get_bytes<4>(file.at(0,4)))
+, coef_size(), n_coef(), index_width(5), index_begin(), coefficients_begin()
+{ if (n_pols==compact_magic_code and file.at(4,1)[0]==compact_version)
+  { const unsigned char* p=file.at(5,13);
+    n_pols=get_bytes<4>(p);
+    n_coef=get_bytes<8>(p+4);
+    index_width=p[12];
+    if (n_pols<2 or index_width==0 or index_width>8)
+      throw std::runtime_error("Bad polynomial file");
+    index_begin=file.at(18,index_width*(ullong(n_pols)+1));
+    coefficients_begin=
+      file.at(18+index_width*(ullong(n_pols)+1),pol_offset(n_pols));
+    return; // |coef_size==0| flags variable length coefficients
+  }
 
-polynomial_info::~polynomial_info() @+{@; file.close(); }
+  index_begin=file.at(4,5*(ullong(n_pols)+1));
+  if (n_pols<2) // there should at least be |Zero| and |One|
+    throw std::runtime_error("Bad polynomial file");
+  coef_size=get_bytes<5>(index_begin+10); // size of the |One|
+  if (coef_size==0)
+    throw std::runtime_error("Bad polynomial file");
+  n_coef=get_bytes<5>(index_begin+5*n_pols)/coef_size;
+  coefficients_begin=file.at(4+5*(n_pols+1),n_coef*coef_size);
+}
 
 @
 @< Methods for reading binary files @>=
@@ -745,9 +1173,13 @@ polynomial_info::~polynomial_info() @+{@; file.close(); }
 size_t polynomial_info::degree(KLIndex i) const
 { if (i<2)
     return i-1; // exit for Zero and One
-  file.seekg(index_begin+5*i,std::ios_base::beg);
-  ullong index=read_bytes<5>(file);
-  ullong next_index=read_bytes<5>(file);
+  if (coef_size==0) // compact file: the length precedes the coefficients
+  { const unsigned char* p=coefficients_begin+pol_offset(i);
+    return get_varint(p,coefficients_begin+pol_offset(i+1))-1;
+  }
+  const unsigned char* p=index_begin+5*i;
+  ullong index=get_bytes<5>(p);
+  ullong next_index=get_bytes<5>(p+5);
   size_t length=(next_index-index)/coef_size;
   return length-1;
 }
@@ -756,16 +1188,25 @@ size_t polynomial_info::degree(KLIndex i) const
 @< Methods for reading binary files @>=
 
 std::vector<size_t> polynomial_info::coefficients(KLIndex i) const
-{ file.seekg(index_begin+5*i,std::ios_base::beg);
-  ullong index=read_bytes<5>(file);
-  ullong next_index=read_bytes<5>(file);
+{ if (coef_size==0)
+  { const unsigned char* p=coefficients_begin+pol_offset(i);
+    const unsigned char* end=coefficients_begin+pol_offset(i+1);
+    std::vector<size_t> result(get_varint(p,end));
+    for (size_t j=0; j<result.size(); ++j)
+      result[j]=get_varint(p,end);
+    return result;
+  }
+
+  const unsigned char* p=index_begin+5*i;
+  ullong index=get_bytes<5>(p);
+  ullong next_index=get_bytes<5>(p+5);
   size_t length=(next_index-index)/coef_size;
 
   std::vector<size_t> result(length);
-  file.seekg(coefficients_begin+index,std::ios_base::beg);
+  p=coefficients_begin+index;
 
-  for (size_t i=0; i<length; ++i)
-    result[i]=basic_io::read_var_bytes(coef_size,file);
+  for (size_t i=0; i<length; ++i,p+=coef_size)
+    result[i]=get_var_bytes(coef_size,p);
 
   return result;
 }
@@ -776,10 +1217,10 @@ std::vector<size_t> polynomial_info::coefficients(KLIndex i) const
 
 size_t polynomial_info::leading_coeff(KLIndex i) const
 { if (i<2) return i; // this makes "leading coefficient" of Zero return 0
-  file.seekg(index_begin+5*(i+1),std::ios_base::beg);
-  ullong next_index=read_bytes<5>(file);
-  file.seekg(coefficients_begin+next_index-coef_size,std::ios_base::beg);
-  return basic_io::read_var_bytes(coef_size,file);
+  if (coef_size==0)
+    return coefficients(i).back(); // variable length; must decode them all
+  ullong next_index=get_bytes<5>(index_begin+5*(i+1));
+  return get_var_bytes(coef_size,coefficients_begin+next_index-coef_size);
 }
 
 @* The {\bf cached\_pol\_info} class.
@@ -796,7 +1237,7 @@ class cached_pol_info
   mutable std::vector<unsigned char> cache;
 
 public:
-  cached_pol_info(std::ifstream& coefficient_file);
+  cached_pol_info(const mapped_file& coefficient_file);
 
   virtual size_t degree(KLIndex i) const;
   virtual size_t leading_coeff(KLIndex i) const;
@@ -805,7 +1246,7 @@ public:
 @*1 Methods of the {\bf cached\_pol\_info} class.
 @< Methods for reading binary files @>=
 
-cached_pol_info::cached_pol_info(std::ifstream& coefficient_file)
+cached_pol_info::cached_pol_info(const mapped_file& coefficient_file)
   : polynomial_info(coefficient_file)
   , cache(0)
 {
@@ -839,8 +1280,8 @@ size_t cached_pol_info::degree (KLIndex i) const
 |unsigned char| in |cache|, provided they fit. When the bits are$~0$ this either
 means the coefficient has not been stored yet, or that they have but did not
 fit. in either case |cahced_pol_info::leading_coeff| needs to call the base
-method |polynomial_info::leading_coeff| to obtain the leading coefficient by
-reading the file.
+method |polynomial_info::leading_coeff| to obtain the leading coefficient from
+the file.
 
 @< Methods for reading binary files @>=
 
@@ -862,7 +1303,7 @@ class progress_info
 {
   std::vector<KLIndex> first_pol; // count distinct polynomials in rows before
 public:
-  progress_info(std::ifstream& progress_file);
+  progress_info(const mapped_file& progress_file);
 
   BlockElt block_size() const { return first_pol.size()-1; }
   KLIndex first_new_in_row(BlockElt y) // |y==block_size()| is allowed
@@ -875,19 +1316,15 @@ public:
 @< Methods for reading binary files @>=
 
 
-progress_info::progress_info(std::ifstream& file)
+progress_info::progress_info(const mapped_file& file)
 : first_pol()
-{ file.seekg(0,std::ios_base::end); // measure |file|
-  if (file.tellg()%12!=0)
+{ if (file.size()%12!=0)
     throw std::runtime_error("Row file size not a multiple of 12");
-  BlockElt size= file.tellg()/12;
+  BlockElt size= file.size()/12;
   first_pol.reserve(size+1); first_pol.push_back(0);
-  file.seekg(0,std::ios_base::beg); // rewind
-  for (BlockElt y=0; y<size; ++y)
-  { file.seekg(8,std::ios_base::cur); // skip ahead
-    first_pol.push_back(first_pol.back()+read_bytes<4>(file));
-  }
-  file.close();
+  const unsigned char* p=file.at(0,file.size());
+  for (BlockElt y=0; y<size; ++y,p+=12)
+    first_pol.push_back(first_pol.back()+get_bytes<4>(p+8)); // skip 8
 }
 
 BlockElt progress_info::first_row_for_pol(KLIndex i) const
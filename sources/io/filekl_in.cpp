@@ -2,24 +2,85 @@
 #include "filekl_in.h"
 #include <stdexcept>
 
-#include "basic_io.h"
-
-#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "blocks.h"
 #include "bitset.h"
 namespace atlas {
   namespace filekl {
 
-    using basic_io::read_bytes;
-
     
     const BlockElt no_good_ascent = UndefBlock-1;
      // value flagging that no good ascent exists
     const unsigned int magic_code=0x06ABdCF0; 
+    const unsigned int compact_magic_code=0x06ABdCF1; // start of compact files
+    const unsigned char compact_version=2; // follows |compact_magic_code|
 
 
     
+    mapped_file::mapped_file(const std::string& name)
+    : d_data(nullptr), d_size(0)
+    {
+      int fd=open(name.c_str(),O_RDONLY);
+      if (fd<0)
+        throw std::runtime_error("Cannot open file "+name);
+      struct stat status;
+      if (fstat(fd,&status)!=0)
+      { close(fd);
+        throw std::runtime_error("Cannot determine size of file "+name);
+      }
+      d_size=status.st_size;
+      if (d_size>0) // |mmap| refuses empty ranges, but empty files are OK here
+      { void* p=mmap(nullptr,d_size,PROT_READ,MAP_SHARED,fd,0);
+        if (p==MAP_FAILED)
+        { close(fd);
+          throw std::runtime_error("Cannot map file "+name);
+        }
+        d_data=static_cast<const unsigned char*>(p);
+      }
+      close(fd); // the mapping remains valid without the file descriptor
+    }
+    
+    mapped_file::~mapped_file()
+    { if (d_size>0)
+        munmap(const_cast<unsigned char*>(d_data),d_size);
+    }
+    
+    const unsigned char* mapped_file::at(ullong offset, ullong n) const
+    { if (offset>d_size or n>d_size-offset)
+        throw std::runtime_error("Premature end of file");
+      return d_data+offset;
+    }
+    
+    ullong get_var_bytes(unsigned int n, const unsigned char* p)
+    { switch(n)
+      { case 1: return get_bytes<1>(p);
+        case 2: return get_bytes<2>(p);
+        case 3: return get_bytes<3>(p);
+        case 4: return get_bytes<4>(p);
+        case 5: return get_bytes<5>(p);
+        case 6: return get_bytes<6>(p);
+        case 7: return get_bytes<7>(p);
+        case 8: return get_bytes<8>(p);
+      default: throw std::runtime_error("Illegal get_var_bytes");
+      }
+    }
+
+    ullong get_varint(const unsigned char*& p, const unsigned char* end)
+    { ullong result=0;
+      for (unsigned int shift=0; p<end and shift<64; shift+=7)
+      { unsigned char b=*p++;
+        result |= ullong(b&0x7F)<<shift;
+        if ((b&0x80)==0)
+          return result;
+      }
+      throw std::runtime_error("Bad variable length number");
+    }
+    
+    
     BlockElt
     block_info::primitivize(BlockElt x, BlockElt y) const
     {
@@ -57,25 +118,38 @@ namespace atlas {
       return result;
     }
     
-    block_info::block_info(std::ifstream& in)
+    block_info::block_info(const mapped_file& in)
       : rank(), size(), max_length(), start_length()
       , descent_set(), ascents(), primitives_list() // don't initialize yet
     {
-      in.seekg(0,std::ios_base::beg); // ensure we are reading from the start
-      size=read_bytes<4>(in);
-      rank=read_bytes<1>(in);
-      max_length=read_bytes<1>(in);
+      const unsigned char* p=in.at(0,6);
+      size=get_bytes<4>(p);
+      rank=get_bytes<1>(p+4);
+      max_length=get_bytes<1>(p+5);
+      if (rank>constants::RANK_MAX)
+        throw std::runtime_error("Bad rank in block file");
+    
+      // all further data has fixed size; get it at once, checking its presence
+      p=in.at(6,4*(max_length+ullong(size)*(1+rank)));
     
       // read intervals of block elements for each length
       start_length.resize(max_length+2);
       start_length[0]=BlockElt(0);
-      for (size_t i=1; i<=max_length; ++i) start_length[i]=read_bytes<4>(in);
+      for (size_t i=1; i<=max_length; ++i,p+=4)
+      { start_length[i]=get_bytes<4>(p);
+        if (start_length[i]<start_length[i-1] or start_length[i]>size)
+          throw std::runtime_error("Bad length intervals in block file");
+      }
       start_length[max_length+1]=size;
     
       // read descent sets
       descent_set.reserve(size);
-      for (BlockElt y=0; y<size; ++y)
-        descent_set.push_back(RankFlags(read_bytes<4>(in)));
+      for (BlockElt y=0; y<size; ++y,p+=4)
+      { const ullong d=get_bytes<4>(p);
+        if ((d>>rank)!=0) // these are used to index |primitives_list|
+          throw std::runtime_error("Bad descent set in block file");
+        descent_set.push_back(RankFlags(d));
+      }
     
       // read ascent table
       ascents.reserve(size);
@@ -84,8 +158,12 @@ namespace atlas {
           ascents.push_back(ascent_vector());
           ascent_vector& a=ascents.back();
           a.reserve(rank);
-          for (size_t s=0; s<rank; ++s)
-    	a.push_back(read_bytes<4>(in));
+          for (size_t s=0; s<rank; ++s,p+=4)
+          { const BlockElt z=get_bytes<4>(p);
+            if (z<no_good_ascent and (z<=x or z>=size)) // ascents must go up
+              throw std::runtime_error("Bad ascent in block file");
+    	a.push_back(z);
+          }
         }
     
       // lists of primitives lazily computed, on demand by |prims_for_descents_of|
@@ -102,22 +180,36 @@ namespace atlas {
     void matrix_info::set_y(BlockElt y)
     {
       if (y==cur_y)
-        { matrix_file.seekg(cur_row_entries); return; }
+        return;
       cur_y=y;
       const prim_list& weak_prims = block.prims_for_descents_of(y);
       cur_strong_prims.resize(0);
       // restart building from scratch, but don't deallocate storage
     
-      matrix_file.seekg(row_pos[y]);
-      size_t n_prim=read_bytes<4>(matrix_file);
-    
-    
-      for (size_t i=0; i<n_prim; i+=32)
-        {
-          unsigned int chunk=read_bytes<4>(matrix_file);
-          for (size_t j=0; chunk!=0; ++j,chunk>>=1) // and certainly |j<32|
-            if ((chunk&1)!=0) cur_strong_prims.push_back(weak_prims[i+j]);
-        }
+      if (compact)
+        decode_compact_row(y,weak_prims);
+      else
+      {
+        size_t n_prim=get_bytes<4>(matrix_file.at(row_pos[y],4));
+        if (n_prim>weak_prims.size())
+          throw std::runtime_error("Bad matrix row");
+        cur_row_entries=row_pos[y]+4+4*ullong((n_prim+31)/32); // after bitmap
+        const unsigned char* p=
+          matrix_file.at(row_pos[y]+4,cur_row_entries-(row_pos[y]+4));
+    
+        for (size_t i=0; i<n_prim; i+=32,p+=4)
+          {
+    	unsigned int chunk=get_bytes<4>(p);
+    	for (size_t j=0; chunk!=0; ++j,chunk>>=1) // and certainly |j<32|
+    	  if ((chunk&1)!=0)
+    	  { if (i+j>=n_prim)
+    	      throw std::runtime_error("Bad matrix row");
+    	    cur_strong_prims.push_back(weak_prims[i+j]);
+    	  }
+          }
+        if (cur_strong_prims.empty()) // there should at least be |y| itself
+          throw std::runtime_error("Bad matrix row");
+      }
     
       {
     #ifndef NDEBUG
@@ -139,10 +231,33 @@ namespace atlas {
     #endif
         cur_strong_prims.back()=y; // replace by |y|
       }
-    
-      cur_row_entries=matrix_file.tellg();
     }
     
+    void matrix_info::decode_compact_row(BlockElt y, const prim_list& weak_prims)
+    {
+      const unsigned char* p=matrix_file.at(row_pos[y],row_pos[y+1]-row_pos[y]);
+      const unsigned char* end=p+(row_pos[y+1]-row_pos[y]);
+      size_t n_prim=get_varint(p,end);
+      size_t n_strong=get_varint(p,end);
+      if (n_strong==0 or n_prim>weak_prims.size())
+        throw std::runtime_error("Bad compact matrix row");
+
+      for (size_t i=0,k=0; k<n_strong; ++i,++k)
+      { i+=get_varint(p,end); // skip weakly primitive elements that are not strong
+        if (i>=n_prim)
+          throw std::runtime_error("Bad compact matrix row");
+        cur_strong_prims.push_back(weak_prims[i]);
+      }
+
+      cur_entries.resize(0);
+      long long prev=0;
+      for (size_t k=1; k<n_strong; ++k) // no index is recorded for |y| itself
+      { ullong d=get_varint(p,end); // zigzag encoded difference with |prev|
+        prev += (d&1)!=0 ? ~static_cast<long long>(d>>1) : static_cast<long long>(d>>1);
+        cur_entries.push_back(KLIndex(prev));
+      }
+    }
+
     KLIndex matrix_info::find_pol_nr(BlockElt x,BlockElt y)
     {
       set_y(y);
@@ -154,8 +269,10 @@ namespace atlas {
       if (it==cur_strong_prims.end() or *it!=x_prim)
         return KLIndex(0); // not strong
     
-      matrix_file.seekg(4*size_t(it-cur_strong_prims.begin()),std::ios_base::cur);
-      return KLIndex(read_bytes<4>(matrix_file));
+      if (compact)
+        return cur_entries[it-cur_strong_prims.begin()];
+      return KLIndex(get_bytes<4>(matrix_file.at
+        (cur_row_entries+4*ullong(it-cur_strong_prims.begin()),4)));
     }
     
     BlockElt matrix_info::prim_nr(unsigned int i,BlockElt y)
@@ -176,110 +293,189 @@ namespace atlas {
     }
     
     matrix_info::matrix_info
-      (std::ifstream& block_file,std::ifstream& m_file)
+      (const mapped_file& block_file,const mapped_file& m_file)
     : matrix_file(m_file) // store reference to the matrix file
       , block(block_file) // read in block information
+      , compact(get_bytes<4>(matrix_file.at(0,4))==compact_magic_code)
       , row_pos(block.size) // dimension these vectors
-      , cur_y(UndefBlock), cur_strong_prims(), cur_row_entries(0)
+      , cur_y(UndefBlock), cur_strong_prims(), cur_row_entries(0), cur_entries()
     {
-      matrix_file.seekg(0,std::ios_base::beg);
-      if (read_bytes<4>(matrix_file)==magic_code)
-      { matrix_file.seekg(-4*std::streamoff(block_size()),std::ios_base::end);
-        std::streamoff cumul=0;
-        for (BlockElt y=0; y<block_size(); ++y)
-        { cumul+= 4*std::streamoff(read_bytes<4>(matrix_file));
+      if (compact)
+      { const unsigned char* p=matrix_file.at(4,5);
+        if (p[0]!=compact_version)
+          throw std::runtime_error ("Unknown compact matrix file version");
+        if (get_bytes<4>(p+1)!=block_size())
+          throw std::runtime_error ("Matrix file does not match block file");
+        const ullong table_size=5*(ullong(block_size())+1);
+        if (matrix_file.size()<table_size)
+          throw std::runtime_error ("Premature end of file");
+        p=matrix_file.at(matrix_file.size()-table_size,table_size);
+        row_pos.resize(block_size()+1); // include end of final row
+        for (BlockElt y=0; y<=block_size(); ++y,p+=5)
+        { row_pos[y]=get_bytes<5>(p);
+          if (row_pos[y]>matrix_file.size()-table_size
+              or (y>0 and row_pos[y]<row_pos[y-1]))
+            throw std::runtime_error ("Bad row offset in compact matrix file");
+        }
+      }
+
+      else if (get_bytes<4>(matrix_file.at(0,4))==magic_code)
+      { const ullong table_size=4*ullong(block_size());
+        if (matrix_file.size()<table_size)
+          throw std::runtime_error ("Premature end of file");
+        const unsigned char* p=
+          matrix_file.at(matrix_file.size()-table_size,table_size);
+        ullong cumul=0;
+        for (BlockElt y=0; y<block_size(); ++y,p+=4)
+        { cumul+= 4*get_bytes<4>(p);
           row_pos[y] = cumul;
         }
       }
     
       else // read old file format, scanning the whole file
       {
-        size_t l=0; // length of y
-        matrix_file.seekg(0,std::ios_base::beg);
+        ullong pos=0; // offset into |matrix_file|
         for (BlockElt y=0; y<block.size; ++y)
         {
-          while (y>=block.start_length[l+1]) ++l;
-    
-          if (read_bytes<4>(matrix_file)!=y and y!=0)
+          if (get_bytes<4>(matrix_file.at(pos,4))!=y and y!=0)
           { std::cerr << y << std::endl;
             throw std::runtime_error ("Alignment problem");
           }
-          row_pos[y]= matrix_file.tellg(); // record position after row number
-          size_t n_prim=read_bytes<4>(matrix_file);
+          row_pos[y]= pos+=4; // record position after row number
+          size_t n_prim=get_bytes<4>(matrix_file.at(pos,4));
+          pos+=4;
     
           { size_t n_strong_prim=0;
             { // compute number of entries to skip, while reading bitmap
-    	  static const unsigned int ulsize=sizeof(unsigned long int);
-    	  size_t count=n_prim/(8*ulsize); // number of |unsigned long|s to read
-    
-    	  while (count-->0)
-    	    n_strong_prim+=bits::bitCount(read_bytes<ulsize>(matrix_file));
-    
-    	  count=(n_prim%(8*ulsize)+31)/32; // maybe some tetra-byte(s) left
-    	  while (count-->0)
-    	    n_strong_prim+=bits::bitCount(read_bytes<4>(matrix_file));
+    	  const ullong n_words=(n_prim+31)/32;
+    	  const unsigned char* p=matrix_file.at(pos,4*n_words);
+    	  for (ullong i=0; i<n_words; ++i,p+=4)
+    	    n_strong_prim+=bits::bitCount(get_bytes<4>(p));
+    	  pos+=4*n_words;
     	}
     
     	// now skip over matrix entries
-    	matrix_file.seekg(4*std::streamoff(n_strong_prim)
-    			 ,std::ios_base::cur);
+    	pos+=4*ullong(n_strong_prim);
           }
-          if (not matrix_file.good())
+          if (pos>matrix_file.size())
           { std::cerr << y << std::endl;
     	throw std::runtime_error ("Premature end of file");
           }
         } // for (BlockElt y...)
       } // |if (...==magic_code)|
-    
-      block_file.close(); // success, we no longer need the block file
     }
     
-    polynomial_info::polynomial_info (std::ifstream& coefficient_file)
-    : file(coefficient_file), n_pols(read_bytes<4>(file))
-    , coef_size(), index_begin(file.tellg()), coefficients_begin()
-    { file.seekg(10,std::ios_base::cur); // skip initial 2 indices
-      coef_size=read_bytes<5>(file); // size of the |One|
-      file.seekg(index_begin+5*n_pols,std::ios_base::beg);
-      n_coef=read_bytes<5>(file)/coef_size;
-      coefficients_begin=file.tellg();
+    polynomial_info::polynomial_info (const mapped_file& file)
+    : n_pols(get_bytes<4>(file.at(0,4)))
+    , coef_size(), n_coef(), index_width(5), index_begin(), coefficients_begin()
+    { if (n_pols==compact_magic_code and file.at(4,1)[0]==compact_version)
+      { const unsigned char* p=file.at(5,13);
+        n_pols=get_bytes<4>(p);
+        n_coef=get_bytes<8>(p+4);
+        index_width=p[12];
+        if (n_pols<2 or index_width==0 or index_width>8)
+          throw std::runtime_error("Bad polynomial file");
+        index_begin=file.at(18,index_width*(ullong(n_pols)+1));
+        coefficients_begin=
+          file.at(18+index_width*(ullong(n_pols)+1),pol_offset(n_pols));
+        check_offsets(0);
+        return; // |coef_size==0| flags variable length coefficients
+      }
+
+      index_begin=file.at(4,5*(ullong(n_pols)+1));
+      if (n_pols<2) // there should at least be |Zero| and |One|
+        throw std::runtime_error("Bad polynomial file");
+      coef_size=get_bytes<5>(index_begin+10); // size of the |One|
+      if (coef_size==0)
+        throw std::runtime_error("Bad polynomial file");
+      n_coef=get_bytes<5>(index_begin+5*n_pols)/coef_size;
+      coefficients_begin=file.at(4+5*(n_pols+1),n_coef*coef_size);
+      check_offsets(n_coef*coef_size);
+    }
+
+    /*
+      Check once and for all that the polynomial offsets read from the file
+      delimit consecutive ranges inside the coefficient area, so that the
+      accessors, having checked their polynomial number with |check_index|, can
+      use them without further tests. For compact files the coefficient area
+      was mapped up to |pol_offset(n_pols)|, and we pass |n_end==0|; otherwise
+      |n_end| is the size of that area, and the offsets must be multiples of
+      |coef_size| that end exactly there.
+    */
+    void polynomial_info::check_offsets(ullong n_end) const
+    { ullong prev=0;
+      for (KLIndex i=0; i<=n_pols; ++i)
+      { const ullong offset=pol_offset(i);
+        if (offset<prev or (coef_size!=0 and offset%coef_size!=0))
+          throw std::runtime_error("Bad polynomial offset in file");
+        prev=offset;
+      }
+      if (coef_size!=0 and prev!=n_end)
+        throw std::runtime_error("Bad polynomial offset in file");
+    }
+
+    void polynomial_info::check_index(KLIndex i) const
+    { if (i>=n_pols)
+        throw std::runtime_error("Polynomial number out of range");
     }
-    
-    polynomial_info::~polynomial_info() { file.close(); }
     
     size_t polynomial_info::degree(KLIndex i) const
-    { if (i<2)
+    { check_index(i);
+      if (i<2)
         return i-1; // exit for Zero and One
-      file.seekg(index_begin+5*i,std::ios_base::beg);
-      ullong index=read_bytes<5>(file);
-      ullong next_index=read_bytes<5>(file);
+      if (coef_size==0) // compact file: the length precedes the coefficients
+      { const unsigned char* p=coefficients_begin+pol_offset(i);
+        return get_varint(p,coefficients_begin+pol_offset(i+1))-1;
+      }
+      const unsigned char* p=index_begin+5*i;
+      ullong index=get_bytes<5>(p);
+      ullong next_index=get_bytes<5>(p+5);
       size_t length=(next_index-index)/coef_size;
       return length-1;
     }
     
     std::vector<size_t> polynomial_info::coefficients(KLIndex i) const
-    { file.seekg(index_begin+5*i,std::ios_base::beg);
-      ullong index=read_bytes<5>(file);
-      ullong next_index=read_bytes<5>(file);
+    { check_index(i);
+      if (coef_size==0)
+      { const unsigned char* p=coefficients_begin+pol_offset(i);
+        const unsigned char* end=coefficients_begin+pol_offset(i+1);
+        const ullong length=get_varint(p,end);
+        if (length>ullong(end-p)) // each coefficient takes at least one byte
+          throw std::runtime_error("Bad variable length number");
+        std::vector<size_t> result(length);
+        for (size_t j=0; j<result.size(); ++j)
+          result[j]=get_varint(p,end);
+        return result;
+      }
+
+      const unsigned char* p=index_begin+5*i;
+      ullong index=get_bytes<5>(p);
+      ullong next_index=get_bytes<5>(p+5);
       size_t length=(next_index-index)/coef_size;
     
       std::vector<size_t> result(length);
-      file.seekg(coefficients_begin+index,std::ios_base::beg);
+      p=coefficients_begin+index;
     
-      for (size_t i=0; i<length; ++i)
-        result[i]=basic_io::read_var_bytes(coef_size,file);
+      for (size_t i=0; i<length; ++i,p+=coef_size)
+        result[i]=get_var_bytes(coef_size,p);
     
       return result;
     }
     
     size_t polynomial_info::leading_coeff(KLIndex i) const
-    { if (i<2) return i; // this makes "leading coefficient" of Zero return 0
-      file.seekg(index_begin+5*(i+1),std::ios_base::beg);
-      ullong next_index=read_bytes<5>(file);
-      file.seekg(coefficients_begin+next_index-coef_size,std::ios_base::beg);
-      return basic_io::read_var_bytes(coef_size,file);
+    { check_index(i);
+      if (i<2) return i; // this makes "leading coefficient" of Zero return 0
+      if (coef_size==0) // variable length; must decode them all
+      { const auto c=coefficients(i);
+        if (c.empty())
+          throw std::runtime_error("Bad polynomial file");
+        return c.back();
+      }
+      ullong next_index=get_bytes<5>(index_begin+5*(i+1));
+      return get_var_bytes(coef_size,coefficients_begin+next_index-coef_size);
     }
     
-    cached_pol_info::cached_pol_info(std::ifstream& coefficient_file)
+    cached_pol_info::cached_pol_info(const mapped_file& coefficient_file)
       : polynomial_info(coefficient_file)
       , cache(0)
     {
@@ -302,11 +498,13 @@ namespace atlas {
     
     size_t cached_pol_info::degree (KLIndex i) const
     {
+      check_index(i);
       return i<2 ? i-1 : cache[i-2]&degree_mask ;
     }
     
     size_t cached_pol_info::leading_coeff (KLIndex i) const
     {
+      check_index(i);
       if (i<2)
         return i;
       if ((cache[i-2]&~degree_mask)!=0) return cache[i-2]/(degree_mask+1);
@@ -315,19 +513,15 @@ namespace atlas {
       return lc;
     }
     
-    progress_info::progress_info(std::ifstream& file)
+    progress_info::progress_info(const mapped_file& file)
     : first_pol()
-    { file.seekg(0,std::ios_base::end); // measure |file|
-      if (file.tellg()%12!=0)
+    { if (file.size()%12!=0)
         throw std::runtime_error("Row file size not a multiple of 12");
-      BlockElt size= file.tellg()/12;
+      BlockElt size= file.size()/12;
       first_pol.reserve(size+1); first_pol.push_back(0);
-      file.seekg(0,std::ios_base::beg); // rewind
-      for (BlockElt y=0; y<size; ++y)
-      { file.seekg(8,std::ios_base::cur); // skip ahead
-        first_pol.push_back(first_pol.back()+read_bytes<4>(file));
-      }
-      file.close();
+      const unsigned char* p=file.at(0,file.size());
+      for (BlockElt y=0; y<size; ++y,p+=12)
+        first_pol.push_back(first_pol.back()+get_bytes<4>(p+8)); // skip 8
     }
     
     BlockElt progress_info::first_row_for_pol(KLIndex i) const
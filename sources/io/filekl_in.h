@@ -5,6 +5,7 @@
 
 
 #include <ios>
+#include <string>
 
 #include "bitset.h" // to make |RankFlags| a complete type; used when inlining
 #include "../Atlas.h"
@@ -27,6 +28,31 @@ namespace atlas {
     typedef std::vector<prim_list> prim_table;
     
     
+    class mapped_file
+    {
+      const unsigned char* d_data; // start of the (read-only) mapped contents
+      ullong d_size;               // size of the file in bytes
+    
+    public:
+      explicit mapped_file(const std::string& name); // map file, or throw
+      ~mapped_file();
+      mapped_file(const mapped_file&) = delete; // copying forbidden
+      mapped_file& operator=(const mapped_file&) = delete;
+    
+      ullong size() const { return d_size; }
+      // pointer to |n| bytes at |offset|, or throw if they are not all present
+      const unsigned char* at(ullong offset, ullong n) const;
+    };
+    
+    // decode |n| bytes at |p| as little-endian number, like |read_bytes| does
+    template<unsigned int n> ullong get_bytes(const unsigned char* p);
+    template<> inline ullong get_bytes<1>(const unsigned char* p)
+      { return p[0]; }
+    template<unsigned int n> inline ullong get_bytes(const unsigned char* p)
+      { return p[0]+(get_bytes<n-1>(p+1)<<8); }
+    ullong get_var_bytes(unsigned int n, const unsigned char* p);
+    ullong get_varint(const unsigned char*& p, const unsigned char* end);
+    
     struct block_info
     {
       unsigned int rank;
@@ -42,7 +68,7 @@ namespace atlas {
       prim_table primitives_list; // lists of weakly primitives, per descent set
     
     public:
-      block_info(std::ifstream& in); // constructor reads, and closes, file
+      block_info(const mapped_file& in); // constructor reads the whole file
     
       BlockElt primitivize(BlockElt x, BlockElt y) const;
       const prim_list& prims_for_descents_of(BlockElt y);
@@ -54,26 +80,29 @@ namespace atlas {
     
     class matrix_info
     {
-      std::ifstream& matrix_file; // non-owned reference to (open) file
+      const mapped_file& matrix_file; // non-owned reference to mapped file
     
       block_info block;
     
-      std::vector<std::streampos> row_pos; // positions where each row starts
+      bool compact; // whether the file is in compact format
+      std::vector<ullong> row_pos; // offsets where each row starts
     
     // data for currently selected row~|y|
       BlockElt cur_y;		// row number
       strong_prim_list cur_strong_prims;   // strongly primitives for this row
-      std::streampos cur_row_entries; // indices of polynomials for row start here
+      ullong cur_row_entries; // indices of polynomials for row start here
+      std::vector<KLIndex> cur_entries; // decoded indices, for compact files only
     
     //private methods
       matrix_info(const matrix_info&); // copying forbidden
       void set_y(BlockElt y);  // install |cur_y| and dependent data
+      void decode_compact_row(BlockElt y, const prim_list& weak_prims);
     
     public:
       BlockElt x_prim; // public variable that is set by |find_pol_nr|
     
     // constructor and destructor
-      matrix_info(std::ifstream& block_file,std::ifstream& m_file);
+      matrix_info(const mapped_file& block_file,const mapped_file& m_file);
       ~matrix_info() {}
     
     // accessors
@@ -98,16 +127,23 @@ namespace atlas {
     
     class polynomial_info
     {
-      std::ifstream& file; // non-owned reference to (open) file
-    
       KLIndex n_pols;         // number of polynomials in file
-      unsigned int coef_size; // number of bytes per coefficient
+      unsigned int coef_size; // number of bytes per coefficient, 0 if variable
       ullong n_coef;          // number of coefficients
-      std::streamoff index_begin, coefficients_begin;
+      unsigned int index_width; // number of bytes per index entry
+      const unsigned char* index_begin; // within non-owned mapped file
+      const unsigned char* coefficients_begin; // likewise
+
+      ullong pol_offset(KLIndex i) const // offset of polynomial |i| among coefficients
+      { return get_var_bytes(index_width,index_begin+index_width*ullong(i)); }
+      void check_offsets(ullong n_end) const; // validate all |pol_offset| values
     
+    protected:
+      void check_index(KLIndex i) const; // throw unless |i<n_pols|
+
     public:
-      polynomial_info(std::ifstream& coefficient_file);
-      virtual ~polynomial_info();
+      polynomial_info(const mapped_file& coefficient_file);
+      virtual ~polynomial_info() {}
     
       KLIndex n_polynomials() const { return n_pols; }
       unsigned int coefficient_size() const { return coef_size; }
@@ -125,7 +161,7 @@ namespace atlas {
       mutable std::vector<unsigned char> cache;
     
     public:
-      cached_pol_info(std::ifstream& coefficient_file);
+      cached_pol_info(const mapped_file& coefficient_file);
     
       virtual size_t degree(KLIndex i) const;
       virtual size_t leading_coeff(KLIndex i) const;
@@ -135,7 +171,7 @@ namespace atlas {
     {
       std::vector<KLIndex> first_pol; // count distinct polynomials in rows before
     public:
-      progress_info(std::ifstream& progress_file);
+      progress_info(const mapped_file& progress_file);
     
       BlockElt block_size() const { return first_pol.size()-1; }
       KLIndex first_new_in_row(BlockElt y) // |y==block_size()| is allowed
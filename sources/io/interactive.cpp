@@ -114,7 +114,10 @@ InputFile::InputFile(std::string prompt, std::ios_base::openmode mode)
 	("Give input file for "+ prompt+" (? to abandon): ");
       d_stream = new std::ifstream(name.c_str(),mode);
       if (d_stream->is_open())
+      {
+	d_name=name;
 	break;
+      }
       std::cout << "Failure opening file, try again.\n";
     } while(true);
 #ifndef NREADLINE
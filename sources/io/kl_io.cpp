@@ -60,7 +60,7 @@ std::ostream& printAllKL
     bool first = true;
 
     for (size_t x = 0; x <= y; ++x) {
-      const kl::KLPol& pol = kl_tab.KL_pol(x,y);
+      kl::KLPolRef pol = kl_tab.KL_pol(x,y);
       if (pol.isZero())
 	continue;
       if (first)
@@ -160,7 +160,7 @@ std::ostream& printKLList(std::ostream& strm, const kl::KL_table& kl_tab)
   // get polynomials, omitting Zero
   for (kl::KLIndex i=0; i<store.size(); ++i)
   {
-    const kl::KLPol& r=store[i];
+    kl::KLPolRef r=store[i];
     if (not r.isZero()) polList.push_back(r);
   }
 
@@ -192,6 +192,70 @@ std::ostream& printMu(std::ostream& strm, const kl::KL_table& kl_tab)
   return strm;
 }
 
+// Print the counters in |stats| describing the work done by filling tables
+std::ostream& printStats(std::ostream& strm, const kl::Fill_stats& stats)
+{
+  strm << "columns computed: " << stats.columns << std::endl
+       << "hash lookups: " << stats.lookups
+       << ", new polynomials: " << stats.interned
+       << ", found: " << stats.lookups-stats.interned << std::endl
+       << "hash table slots: " << stats.hash_slots
+       << ", enlargements: " << stats.rehashes << std::endl;
+
+  double total=0;
+  for (double t : stats.seconds)
+    total += t;
+  const auto precision = strm.precision(3);
+  strm << "time computing columns: " << std::fixed
+       << total << 's' << std::endl;
+  for (size_t l=0; l<stats.seconds.size(); ++l)
+    if (stats.seconds[l]>0)
+      strm << "  length " << std::setw(3) << l << ": "
+	   << std::setw(10) << stats.seconds[l] << 's' << std::endl;
+  strm.unsetf(std::ios_base::floatfield);
+  strm.precision(precision);
+
+  return strm;
+}
+
+// Print the counters of |kl_tab|, and the sizes of its tables
+std::ostream& printStats(std::ostream& strm, const kl::KL_table& kl_tab)
+{
+  printStats(strm,kl_tab.stats());
+
+  const kl::KLStore& store = kl_tab.pol_store();
+  strm << "polynomials: " << store.size()
+       << ", stored in " << store.memory() << " bytes";
+  if (kl_tab.stats().hash_slots>0)
+  {
+    const auto precision = strm.precision(3);
+    strm << ", hash load " << double(store.size())/kl_tab.stats().hash_slots;
+    strm.precision(precision);
+  }
+  strm << std::endl;
+
+  const auto col_mem = kl_tab.column_memory();
+  strm << "KL matrix: " << col_mem.first << " bytes ("
+       << col_mem.second << " uncompressed)" << std::endl;
+
+  const auto prim_mem = kl_tab.prim_index_memory();
+  strm << "primitive index tables: " << prim_mem.first << " bytes ("
+       << prim_mem.second << " unpacked)" << std::endl;
+
+  size_t mu_total=0, mu_max=0;
+  for (BlockElt y=0; y<kl_tab.size(); ++y)
+  {
+    const size_t n = kl_tab.mu_column(y).size();
+    mu_total += n;
+    if (n>mu_max)
+      mu_max = n;
+  }
+  strm << "mu-lists: " << mu_total << " entries, longest "
+       << mu_max << std::endl;
+
+  return strm;
+}
+
 } // |namespace kl_io|
 
 } // |namsespace atlas|
@@ -31,6 +31,10 @@ namespace kl_io {
 
   std::ostream& printMu(std::ostream&, const kl::KL_table&);
 
+  // counters of work done; the second version adds sizes of the tables
+  std::ostream& printStats(std::ostream&, const kl::Fill_stats&);
+  std::ostream& printStats(std::ostream&, const kl::KL_table&);
+
 }
 
 }
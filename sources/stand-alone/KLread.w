@@ -29,6 +29,9 @@ The purpose of this program is to read the files binary written by the
 polynomials, or produced from them by the \.{matrix-merge} and
 \.{coef-merge} programs, and to give the use access to these results in a
 human-readable form.
+Programs that need many such results should rather use \.{KLserve}, which
+answers the same queries over a socket, keeping the files mapped between
+queries.
 
 @h <string>
 @h <vector>
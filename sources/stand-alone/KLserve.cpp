@@ -0,0 +1,700 @@
+#include <cerrno>
+#include <cstdlib> // for |exit| and |strtoul|
+#include <cstring>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <list>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <stdexcept>
+
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../Atlas.h"
+#include "filekl_in.h"
+
+/*
+  A server answering the queries that KLread answers interactively, for many
+  clients at once, over a Unix-domain socket. The block, matrix and
+  coefficient files stay mapped for the life of the server, so clients pay
+  neither process start-up nor file opening costs.
+
+  Usage: KLserve [-q] [-j threads] [-c cache-size] socket block matrix coef
+
+  A client connects to the socket and sends lines, each answered by one line:
+
+    p x y      the index of P_{x,y} followed by its coefficients (from q^0)
+    mu x y     the coefficient mu(x,y)
+    i n        the coefficients of polynomial number n
+    stats      the number of hits and misses of the polynomial cache
+    binary     switch this connection to binary mode (see |serve_binary|)
+    quit       close the connection
+
+  Errors are answered by a line starting with "error". Any number of queries
+  may be sent before reading the answers; answers are sent when all queries
+  received so far have been handled, so a batch is answered as a whole.
+
+  The main thread watches the listening socket and all connections using
+  |poll|. Whenever complete queries have arrived on a connection that has no
+  queries being handled, it hands them as one job to a queue from which the
+  worker threads take them; so a connection occupies a worker only while it
+  has queries to answer, and idle clients cost nothing but a file descriptor.
+  Each worker has its own |matrix_info| (which is not thread-safe, as it
+  caches the current row). The decoded polynomials are shared between the
+  threads in a cache of at most cache-size entries, from which the least
+  recently used ones are evicted.
+*/
+
+namespace { bool verbose=true; }
+
+namespace atlas {
+  namespace filekl {
+
+typedef std::shared_ptr<const std::vector<size_t> > coefficient_ptr;
+
+class pol_cache
+{
+  typedef std::pair<KLIndex,coefficient_ptr> cache_entry;
+  typedef std::list<cache_entry> entry_list; // most recently used first
+
+  const polynomial_info& pol;
+  size_t capacity;
+  entry_list entries;
+  std::unordered_map<KLIndex,entry_list::iterator> where; // locate |entries|
+  std::mutex lock;
+  ullong n_hits, n_misses;
+
+public:
+  pol_cache(const polynomial_info& p, size_t cap)
+  : pol(p), capacity(cap), entries(), where(), lock(), n_hits(0), n_misses(0)
+  {}
+
+  coefficient_ptr coefficients(KLIndex i); // |i| must be a valid index
+  std::pair<ullong,ullong> hits_and_misses()
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    return std::make_pair(n_hits,n_misses);
+  }
+};
+
+coefficient_ptr pol_cache::coefficients(KLIndex i)
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it=where.find(i);
+    if (it!=where.end())
+    {
+      ++n_hits;
+      entries.splice(entries.begin(),entries,it->second); // move to front
+      return it->second->second;
+    }
+    ++n_misses;
+  }
+
+  // decode without holding the lock; another thread might do the same
+  coefficient_ptr result=
+    std::make_shared<std::vector<size_t> >(pol.coefficients(i));
+
+  std::lock_guard<std::mutex> guard(lock);
+  if (capacity>0 and where.count(i)==0)
+  {
+    entries.push_front(cache_entry(i,result));
+    where[i]=entries.begin();
+    if (entries.size()>capacity)
+    {
+      where.erase(entries.back().first);
+      entries.pop_back();
+    }
+  }
+  return result;
+}
+
+// append |n| bytes of |val| to |out|, little-endian like the files
+void put_bytes(std::string& out, ullong val, unsigned int n)
+{
+  for (; n>0; --n,val>>=8)
+    out.push_back(char(val&0xFF));
+}
+
+// complete queries from one connection, to be answered by a worker thread
+struct job
+{
+  int fd; // identifies the connection
+  std::vector<std::string> lines; // text queries
+  std::string pairs; // then binary queries: 8 bytes for each pair $x,y$
+};
+
+// the answers to a |job|
+struct job_result
+{
+  int fd;
+  std::string answers;
+  bool close; // whether the connection must be closed after the answers
+};
+
+// a queue between threads; |pop| waits, |try_pop| does not
+template<typename T> class work_queue
+{
+  std::deque<T> items;
+  std::mutex lock;
+  std::condition_variable nonempty;
+
+public:
+  void push(T&& item)
+  {
+    { std::lock_guard<std::mutex> guard(lock); items.push_back(std::move(item)); }
+    nonempty.notify_one();
+  }
+  T pop() // wait until an item is available
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    nonempty.wait(guard,[this] { return not items.empty(); });
+    T item=std::move(items.front()); items.pop_front();
+    return item;
+  }
+  bool try_pop(T& item)
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (items.empty())
+      return false;
+    item=std::move(items.front()); items.pop_front();
+    return true;
+  }
+};
+
+/* A client connection, buffered in both directions, and only ever accessed by
+   the main thread. Its socket is non-blocking; |read_input| and
+   |write_output| transfer what they can without waiting.
+*/
+class connection
+{
+  std::string in_buf; // received bytes not yet made into a job
+  bool binary; // whether the connection has switched to binary mode
+  ullong pairs_left; // in binary mode, pairs still expected for current request
+
+public:
+  const int fd;
+  std::string out_buf; // answers not yet sent
+  bool busy; // whether a job for this connection is being handled
+  bool input_done; // end of input, or "quit" received, or fatal error
+  bool broken; // whether sending failed; if so we stop serving
+
+  static const size_t buffer_limit=1<<20; // stop reading beyond this
+
+  explicit connection(int socket)
+  : in_buf(), binary(false), pairs_left(0)
+  , fd(socket), out_buf(), busy(false), input_done(false), broken(false)
+  {}
+  ~connection() { ::close(fd); }
+
+  bool wants_input() const
+  { return not input_done and not broken
+      and in_buf.size()<buffer_limit and out_buf.size()<buffer_limit; }
+  bool finished() const // whether the connection can be closed
+  { return not busy and (input_done or broken) and (out_buf.empty() or broken); }
+
+  void read_input();
+  void write_output();
+  bool next_job(job& j); // move complete queries into |j|, if there are any
+};
+
+void connection::read_input()
+{
+  char buf[1<<16];
+  while (true)
+  {
+    ssize_t n=::read(fd,buf,sizeof(buf));
+    if (n>0)
+    {
+      in_buf.append(buf,n);
+      if (in_buf.size()>=buffer_limit)
+	return;
+    }
+    else if (n<0 and errno==EINTR)
+      continue;
+    else
+    {
+      if (n==0 or (errno!=EAGAIN and errno!=EWOULDBLOCK))
+      {
+	if (not binary and not in_buf.empty() and in_buf.back()!='\n')
+	  in_buf.push_back('\n'); // accept a final line without newline
+	input_done=true; // the final queries are still made into a job
+      }
+      return;
+    }
+  }
+}
+
+void connection::write_output()
+{
+  size_t done=0;
+  while (done<out_buf.size() and not broken)
+  {
+    ssize_t n=::send(fd,out_buf.data()+done,out_buf.size()-done,MSG_NOSIGNAL);
+    if (n>=0)
+      done+=n;
+    else if (errno==EAGAIN or errno==EWOULDBLOCK)
+      break; // try again when |poll| says so
+    else if (errno!=EINTR)
+      broken=true; // the client went away; drop its answers
+  }
+  if (broken)
+    out_buf.clear();
+  else
+    out_buf.erase(0,done);
+}
+
+/* Text queries are complete lines; "binary" switches the remainder of the
+   input to binary mode, and "quit" ends it. A line that fills |buffer_limit|
+   without ending is answered by an error, which also ends the input (once any
+   queries before it have been answered, to keep the answers in order). In
+   binary mode as many complete pairs as are present are taken, so that a large
+   request is answered in parts as it arrives.
+*/
+bool connection::next_job(job& j)
+{
+  j.fd=fd; j.lines.clear(); j.pairs.clear();
+  size_t pos=0;
+  while (true)
+    if (not binary)
+    {
+      size_t nl=in_buf.find('\n',pos);
+      if (nl==std::string::npos)
+	break;
+      std::string line=in_buf.substr(pos,nl-pos);
+      pos=nl+1;
+      if (not line.empty() and line.back()=='\r')
+	line.pop_back();
+      if (line=="quit")
+      {
+	input_done=true; pos=in_buf.size(); // ignore anything after it
+	break;
+      }
+      if (line=="binary")
+	binary=true;
+      else if (line.find_first_not_of(" \t")!=std::string::npos)
+	j.lines.push_back(std::move(line)); // ignore empty lines
+    }
+    else if (pairs_left==0)
+    {
+      if (in_buf.size()-pos<4)
+	break;
+      pairs_left=get_bytes<4>(reinterpret_cast<const unsigned char*>
+			      (in_buf.data()+pos));
+      pos+=4;
+    }
+    else
+    {
+      const ullong n=std::min<ullong>(pairs_left,(in_buf.size()-pos)/8);
+      if (n==0)
+	break;
+      j.pairs.append(in_buf,pos,8*n);
+      pos+=8*n; pairs_left-=n;
+    }
+  in_buf.erase(0,pos);
+  if (not binary and in_buf.size()>=buffer_limit and j.lines.empty())
+  { // no newline in a full buffer: refuse the line, after earlier answers
+    out_buf+="error line too long\n";
+    in_buf.clear(); input_done=true;
+  }
+  return not j.lines.empty() or not j.pairs.empty();
+}
+
+class query_handler
+{
+  matrix_info mi; // private to one thread
+  const polynomial_info& pol;
+  pol_cache& cache;
+
+public:
+  query_handler(const mapped_file& block_file, const mapped_file& matrix_file,
+		const polynomial_info& p, pol_cache& c)
+  : mi(block_file,matrix_file), pol(p), cache(c) {}
+
+  job_result handle(const job& j);
+
+private:
+  KLIndex index(BlockElt x, BlockElt y); // index of $P_{x,y}$, which is 0 if x>y
+  size_t mu(BlockElt x, BlockElt y, const std::vector<size_t>& P) const;
+  void answer(const std::string& line, std::string& out);
+  void answer_binary(const std::string& pairs, std::string& out);
+};
+
+KLIndex query_handler::index(BlockElt x, BlockElt y)
+{
+  if (x>=mi.block_size() or y>=mi.block_size())
+    throw std::runtime_error("block element out of range");
+  return x>y ? KLIndex(0) : mi.find_pol_nr(x,y);
+}
+
+// the coefficient of $q^{(l(y)-l(x)-1)/2}$ in |P|, which is $P_{x,y}$
+size_t query_handler::mu
+  (BlockElt x, BlockElt y, const std::vector<size_t>& P) const
+{
+  if (x>=y)
+    return 0;
+  size_t lx=mi.length(x), ly=mi.length(y);
+  if ((ly-lx)%2==0)
+    return 0;
+  size_t d=(ly-lx-1)/2;
+  return d<P.size() ? P[d] : 0;
+}
+
+void query_handler::answer(const std::string& line, std::string& answers)
+{
+  std::istringstream in(line);
+  std::ostringstream out;
+  std::string command; in >> command;
+
+  if (command=="p" or command=="mu")
+  {
+    BlockElt x,y;
+    if (not (in >> x >> y))
+      throw std::runtime_error("two block elements expected");
+    KLIndex i=index(x,y);
+    coefficient_ptr P=cache.coefficients(i);
+    if (command=="mu")
+      out << mu(x,y,*P);
+    else
+    {
+      out << i;
+      for (size_t k=0; k<P->size(); ++k)
+	out << ' ' << (*P)[k];
+    }
+  }
+  else if (command=="i")
+  {
+    KLIndex i;
+    if (not (in >> i))
+      throw std::runtime_error("polynomial index expected");
+    if (i>=pol.n_polynomials())
+      throw std::runtime_error("polynomial index out of range");
+    coefficient_ptr P=cache.coefficients(i);
+    for (size_t k=0; k<P->size(); ++k)
+      out << (k==0 ? "" : " ") << (*P)[k];
+  }
+  else if (command=="stats")
+  {
+    std::pair<ullong,ullong> hm=cache.hits_and_misses();
+    out << "hits " << hm.first << " misses " << hm.second;
+  }
+  else
+    throw std::runtime_error("unknown command '"+command+"'");
+
+  out << '\n';
+  answers+=out.str();
+}
+
+job_result query_handler::handle(const job& j)
+{
+  job_result result { j.fd, std::string(), false };
+  for (const auto& line : j.lines)
+    try
+    {
+      answer(line,result.answers);
+    }
+    catch (std::exception& e) // for instance a bad query
+    {
+      result.answers+=std::string("error ")+e.what()+'\n';
+    }
+  try
+  {
+    answer_binary(j.pairs,result.answers);
+  }
+  catch (std::exception& e) // for instance a truncated file
+  {
+    result.answers+=std::string("error ")+e.what()+'\n';
+    result.close=true; // the binary protocol cannot continue after this
+  }
+  return result;
+}
+
+/* In binary mode a request is a 4-byte count n followed by n pairs of 4-byte
+   block elements x,y. The answer for each pair is the 4-byte index of
+   $P_{x,y}$, a 1-byte count of its coefficients, and the coefficients of 4
+   bytes each; all numbers are little-endian. A pair out of range is answered
+   by index 0xFFFFFFFF and no coefficients, and a polynomial that does not fit
+   this format (a coefficient of $2^{32}$ or more, or more than 255
+   coefficients) by index 0xFFFFFFFE and no coefficients; its coefficients can
+   then be obtained in text mode. The mode lasts until the connection is
+   closed.
+*/
+void query_handler::answer_binary(const std::string& pairs, std::string& out)
+{
+  const unsigned char* p=reinterpret_cast<const unsigned char*>(pairs.data());
+  for (size_t n=pairs.size()/8; n>0; --n,p+=8)
+  {
+    BlockElt x=get_bytes<4>(p), y=get_bytes<4>(p+4);
+    if (x>=mi.block_size() or y>=mi.block_size())
+    {
+      put_bytes(out,0xFFFFFFFF,4); put_bytes(out,0,1);
+      continue;
+    }
+    KLIndex i=index(x,y);
+    coefficient_ptr P=cache.coefficients(i);
+    if (P->size()>0xFF or i>=0xFFFFFFFE or
+	std::any_of(P->begin(),P->end(),[](size_t c) { return c>0xFFFFFFFF; }))
+    {
+      put_bytes(out,0xFFFFFFFE,4); put_bytes(out,0,1);
+      continue;
+    }
+    put_bytes(out,i,4); put_bytes(out,P->size(),1);
+    for (size_t k=0; k<P->size(); ++k)
+      put_bytes(out,(*P)[k],4);
+  }
+}
+
+bool set_nonblocking(int fd)
+{
+  int flags=::fcntl(fd,F_GETFL,0);
+  return flags>=0 and ::fcntl(fd,F_SETFL,flags|O_NONBLOCK)==0;
+}
+
+// read decimal option value |s| into |n|, provided it lies in $[low,high]$
+bool get_option_value(const char* s, unsigned long low, unsigned long high,
+		      unsigned long& n)
+{
+  if (*s<'0' or *s>'9') // |strtoul| would accept spaces and signs
+    return false;
+  char* end;
+  errno=0;
+  unsigned long v=std::strtoul(s,&end,10);
+  if (*end!='\0' or errno==ERANGE or v<low or v>high)
+    return false;
+  n=v;
+  return true;
+}
+
+  } // namespace filekl
+} // namespace atlas
+
+int main(int argc, char** argv)
+{
+  using namespace atlas::filekl;
+
+  --argc; ++argv; // read and skip program name
+
+  unsigned int n_threads=std::thread::hardware_concurrency();
+  size_t cache_size=1<<16;
+  while (argc>0 and (*argv)[0]=='-')
+    if (std::string(*argv)=="-q")
+      { verbose=false; --argc; ++argv; }
+    else if (argc>1 and std::string(*argv)=="-j")
+    {
+      unsigned long n;
+      if (not get_option_value(argv[1],1,1023,n))
+      {
+	std::cerr << "Number of threads should be from 1 to 1023, not "
+		  << argv[1] << ".\n";
+	exit(1);
+      }
+      n_threads=n; argc-=2; argv+=2;
+    }
+    else if (argc>1 and std::string(*argv)=="-c")
+    {
+      unsigned long n;
+      if (not get_option_value(argv[1],0,~0ul,n))
+      {
+	std::cerr << "Cache size should be a nonnegative number, not "
+		  << argv[1] << ".\n";
+	exit(1);
+      }
+      cache_size=n; argc-=2; argv+=2;
+    }
+    else
+      break;
+  if (n_threads==0)
+    n_threads=1;
+
+  if (argc!=4)
+  {
+    std::cerr << "Usage: KLserve [-q] [-j threads] [-c cache-size]"
+      " socket-file block-file matrix-file coefficient-file\n";
+    exit(1);
+  }
+
+  std::unique_ptr<mapped_file> block_file,matrix_file,coef_file;
+  std::unique_ptr<polynomial_info> pol;
+  std::vector<std::unique_ptr<query_handler> > handler;
+  std::unique_ptr<pol_cache> cache;
+  try
+  {
+    block_file.reset(new mapped_file(argv[1]));
+    matrix_file.reset(new mapped_file(argv[2]));
+    coef_file.reset(new mapped_file(argv[3]));
+    pol.reset(new polynomial_info(*coef_file));
+    cache.reset(new pol_cache(*pol,cache_size));
+    for (unsigned int t=0; t<n_threads; ++t)
+      handler.emplace_back
+	(new query_handler(*block_file,*matrix_file,*pol,*cache));
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Failure reading file(s): " << e.what() << ".\n";
+    exit(1);
+  }
+
+  sockaddr_un address;
+  std::memset(&address,0,sizeof(address));
+  address.sun_family=AF_UNIX;
+  if (std::strlen(argv[0])>=sizeof(address.sun_path))
+  {
+    std::cerr << "Socket file name too long: " << argv[0] << ".\n";
+    exit(1);
+  }
+  std::strcpy(address.sun_path,argv[0]);
+
+  { // remove a socket left by a previous server, but never any other file
+    struct stat status;
+    if (::lstat(argv[0],&status)==0)
+    {
+      if (not S_ISSOCK(status.st_mode))
+      {
+	std::cerr << "Not replacing " << argv[0]
+		  << ", which exists and is not a socket.\n";
+	exit(1);
+      }
+      ::unlink(argv[0]);
+    }
+  }
+
+  int listener=::socket(AF_UNIX,SOCK_STREAM,0);
+  int wake[2]; // workers write a byte to |wake[1]| when a result is ready
+  if (listener<0
+      or ::bind(listener,reinterpret_cast<sockaddr*>(&address),sizeof(address))<0
+      or ::listen(listener,SOMAXCONN)<0
+      or not set_nonblocking(listener)
+      or ::pipe(wake)<0
+      or not set_nonblocking(wake[0]) or not set_nonblocking(wake[1]))
+  {
+    std::cerr << "Cannot listen on " << argv[0] << ": "
+	      << std::strerror(errno) << ".\n";
+    exit(1);
+  }
+
+  work_queue<job> jobs;
+  work_queue<job_result> results;
+  for (unsigned int t=0; t<n_threads; ++t)
+  {
+    query_handler* h=handler[t].get();
+    const int wake_fd=wake[1];
+    std::thread([h,wake_fd,&jobs,&results]
+    {
+      while (true)
+      {
+	results.push(h->handle(jobs.pop()));
+	const char byte=0;
+	while (::write(wake_fd,&byte,1)<0 and errno==EINTR)
+	  {} // if the pipe is full, the main thread is woken anyway
+      }
+    }).detach();
+  }
+
+  if (verbose)
+    std::cerr << "Serving " << pol->n_polynomials() << " polynomials on "
+	      << argv[0] << " with " << n_threads << " threads.\n";
+
+  std::unordered_map<int,std::unique_ptr<connection> > clients; // by |fd|
+  std::vector<pollfd> watch;
+  while (true)
+  {
+    watch.clear();
+    watch.push_back(pollfd { listener, POLLIN, 0 });
+    watch.push_back(pollfd { wake[0], POLLIN, 0 });
+    for (const auto& entry : clients)
+    {
+      const connection& c=*entry.second;
+      short events=(c.wants_input() ? POLLIN : 0)
+	| (c.out_buf.empty() ? 0 : POLLOUT);
+      if (events!=0) // otherwise a hung-up client would wake us continually
+	watch.push_back(pollfd { c.fd, events, 0 });
+    }
+
+    if (::poll(watch.data(),watch.size(),-1)<0)
+    {
+      if (errno==EINTR)
+	continue;
+      std::cerr << "Failure polling connections: "
+		<< std::strerror(errno) << ".\n";
+      exit(1);
+    }
+
+    if ((watch[0].revents&POLLIN)!=0)
+      while (true)
+      {
+	int fd=::accept(listener,nullptr,nullptr);
+	if (fd>=0)
+	{
+	  if (set_nonblocking(fd))
+	    clients[fd].reset(new connection(fd));
+	  else
+	    ::close(fd);
+	}
+	else if (errno==EAGAIN or errno==EWOULDBLOCK)
+	  break;
+	else if (errno!=EINTR and errno!=ECONNABORTED)
+	{
+	  std::cerr << "Failure accepting connections: "
+		    << std::strerror(errno) << ".\n";
+	  exit(1);
+	}
+      }
+
+    if ((watch[1].revents&POLLIN)!=0)
+    {
+      char buf[256];
+      while (::read(wake[0],buf,sizeof(buf))>0)
+	{}
+    }
+    job_result r;
+    while (results.try_pop(r))
+    {
+      connection& c=*clients.at(r.fd); // is not closed while busy
+      c.busy=false;
+      if (c.broken)
+	continue;
+      c.out_buf+=r.answers;
+      if (r.close)
+	c.input_done=true;
+    }
+
+    for (size_t k=2; k<watch.size(); ++k)
+    {
+      connection& c=*clients.at(watch[k].fd); // none are erased before this
+      if ((watch[k].revents&POLLOUT)!=0)
+	c.write_output();
+      if ((watch[k].revents&(POLLIN|POLLHUP|POLLERR))!=0 and c.wants_input())
+	c.read_input();
+    }
+
+    for (auto it=clients.begin(); it!=clients.end(); )
+    {
+      connection& c=*it->second;
+      job j;
+      if (not c.busy and not c.broken
+	  and c.out_buf.size()<connection::buffer_limit and c.next_job(j))
+      {
+	c.busy=true;
+	jobs.push(std::move(j));
+      }
+      if (not c.busy and not c.out_buf.empty())
+	c.write_output(); // send promptly; |poll| handles what remains
+      if (c.finished())
+	it=clients.erase(it);
+      else
+	++it;
+    }
+  }
+}
@@ -5,6 +5,10 @@
 #include  <fstream>
 #include  <stdexcept>
 #include  <iomanip>
+#include  <algorithm>
+#include  <chrono>
+#include  <thread>
+#include  <utility>
 #include  <sstream>
 
 
@@ -143,6 +147,14 @@ public:
     // coefficients of polynomial |i|
 };
 
+struct slice_result
+{ std::ostringstream bytes; // the lifted coefficients, in output format
+  std::vector<std::pair<ulong,ulong> > records;
+   // polynomial number and value of successive maximal coefficients
+  bool failed; // whether an incompatibility was found
+  ulong bad_pol, bad_coef; // if so, where it was found
+};
+
 const std::ios_base::openmode binary_out=
 			    std::ios_base::out
 			  | std::ios_base::trunc
@@ -388,61 +400,104 @@ file_pos write_indices
   return index;
 }
 
-ulong write_coefficients
- (ulong coefficient_size,
-  const std::vector<modulus_info*>& mod_info,
-  const std::vector<ChineseBox*>& box,
-  std::ostream& out,
-  bool verbose, bool output)
-// return value is maximum of lifted coefficients
-{ ulong nr_pols=mod_info[0]->nr_pol();
-  ulong n=mod_info.size(); // number of moduli
-  ulong max=0;
+void lift_slice
+  (const std::vector<ChineseBox*>& box, ulong coefficient_size, bool output,
+   const std::vector<std::vector<ulong> >& modular_pol, // for the chunk
+   ulong first, ulong begin, ulong end, slice_result& result)
+{ ulong n=box.size()+1; // number of moduli
+  result.bytes.str(""); result.records.clear(); result.failed=false;
+  ulong max=0; // maximum within this slice
   std::vector<ulong> rem(2*n-1);
       // remainders for |n| original and |n-1| derived moduli
-  std::vector<std::vector<ulong> > modular_pol(n);
-   // polynomials from the base moduli
-
-  for (ulong i=0; i<nr_pols; ++i)
-  { if (verbose and (i&0xFFF)==0)
-      std::cerr << "Polynomial: " << std::setw(10) << i << '\r';
+  for (ulong i=begin; i<end; ++i)
+  { const std::vector<ulong>* pol=&modular_pol[(i-first)*n];
     ulong len=0; // maximum of degree+1 of polynomials selected
-
-
-    
-    for (ulong j=0; j<mod_info.size(); ++j)
-    { modular_pol[j]=mod_info[j]->coefficients(i);
-      if (modular_pol[j].size()>len) len=modular_pol[j].size();
-    }
-    std::vector<ulong> lifted_pol(len);
-    // the polynomial modulo the lcm of the moduli
+    for (ulong j=0; j<n; ++j)
+      if (pol[j].size()>len) len=pol[j].size();
 
     for (ulong d=0; d<len; ++d)
     { for (ulong j=0; j<n; ++j) // install original remainders
-        rem[j]= d>=modular_pol[j].size() ? 0 : modular_pol[j][d];
+        rem[j]= d>=pol[j].size() ? 0 : pol[j][d];
        try
        { for (ulong j=0; j<n-1; ++j)
            rem[n+j]=box[j]->lift_remainders(rem[2*j],rem[2*j+1]);
            // it happens here!
          ulong c=rem.back();
-	 
-	 if (c>max)
-	 { max=c;
-	   std::cout << "Maximal coefficient so far: " 
-	             << max << ", in polynomial " << i << std::endl;
-	 }
-         if (output) write_bytes(c, coefficient_size, out);
+         if (c>max) { max=c; result.records.push_back(std::make_pair(i,c)); }
+         if (output) write_bytes(c, coefficient_size, result.bytes);
        }
        catch (bool)
        // incompatibility found during lift; details are already printed
-       { std::cerr << "In coefficient " << d
-		   << " of polynomial " << i << ".\n";
-         exit(1);
+       { result.failed=true; result.bad_pol=i; result.bad_coef=d;
+         return;
        }
     }
   }
-  if (verbose) // make final polynomial displayed look right, and stay visible
-    std::cerr << "Polynomial: " << std::setw(10) << nr_pols-1 << '\n';
+}
+ulong write_coefficients
+ (ulong coefficient_size,
+  const std::vector<modulus_info*>& mod_info,
+  const std::vector<ChineseBox*>& box,
+  std::ostream& out,
+  bool verbose, bool output, unsigned int n_threads)
+// return value is maximum of lifted coefficients
+{ const ulong chunk_size=0x10000; // number of polynomials read at once
+  ulong nr_pols=mod_info[0]->nr_pol();
+  ulong n=mod_info.size(); // number of moduli
+  ulong max=0;
+  std::vector<std::vector<ulong> > modular_pol(chunk_size*n);
+   // polynomials from the base moduli, for the current chunk
+  std::vector<slice_result> slice(n_threads);
+  auto start=std::chrono::steady_clock::now();
+
+  for (ulong first=0; first<nr_pols; first+=chunk_size)
+  { ulong last=std::min(first+chunk_size,nr_pols); // end of this chunk
+    
+    for (ulong i=first; i<last; ++i)
+      for (ulong j=0; j<n; ++j)
+        modular_pol[(i-first)*n+j]=mod_info[j]->coefficients(i);
+    
+    { ulong slice_size=(last-first+n_threads-1)/n_threads;
+      std::vector<std::thread> threads;
+      for (unsigned int t=1; t<n_threads; ++t)
+      { ulong begin=std::min(first+t*slice_size,last),
+          end=std::min(begin+slice_size,last);
+        threads.emplace_back(lift_slice,std::cref(box),coefficient_size,output,
+                             std::cref(modular_pol),first,begin,end,
+                             std::ref(slice[t]));
+      }
+      lift_slice(box,coefficient_size,output,modular_pol,
+                 first,first,std::min(first+slice_size,last),slice[0]);
+      for (ulong t=0; t<threads.size(); ++t)
+        threads[t].join();
+    }
+    
+    for (unsigned int t=0; t<n_threads; ++t)
+    { for (ulong k=0; k<slice[t].records.size(); ++k)
+        if (slice[t].records[k].second>max)
+        { max=slice[t].records[k].second;
+          std::cout << "Maximal coefficient so far: " 
+                    << max << ", in polynomial " << slice[t].records[k].first
+                    << std::endl;
+        }
+      if (slice[t].failed)
+      { std::cerr << "In coefficient " << slice[t].bad_coef
+		  << " of polynomial " << slice[t].bad_pol << ".\n";
+        exit(1);
+      }
+      if (output) out << slice[t].bytes.str();
+    }
+    if (verbose)
+      
+      { double seconds = std::chrono::duration<double>
+          (std::chrono::steady_clock::now()-start).count();
+        std::cerr << "Polynomial: " << std::setw(10) << last-1 << ", "
+                  << std::setw(8) << (seconds>0 ? ulong(last/seconds) : 0ul)
+                  << " polynomials/s\r";
+      }
+  }
+  if (verbose) // make final display stay visible
+    std::cerr << '\n';
   return max;
 }
 
@@ -492,6 +547,13 @@ int main(int argc, char** argv)
     { double_tables=true; --argc; ++argv;}
   if (argc>0 and std::string(*argv)=="-nowrite")
     { output=false; --argc; ++argv;}
+  unsigned int n_threads=1;
+  if (argc>1 and std::string(*argv)=="-j")
+  { n_threads=std::atoi(argv[1]);
+    if (n_threads==0) n_threads=std::thread::hardware_concurrency();
+    if (n_threads==0) n_threads=1; // when concurrency cannot be determined
+    argc-=2; argv+=2;
+  }
 
   std::string mat_base,coef_base;
   // base names for renumbering and coefficient files
@@ -611,7 +673,8 @@ int main(int argc, char** argv)
               << nr_c << " coefficient bytes." << std::endl;
     ulong max_coef=
        write_coefficients
-         (coefficient_size,mod_info,box,coefficient_file,verbose,output);
+         (coefficient_size,mod_info,box,coefficient_file,verbose,output,
+          n_threads);
     std::cout << "Maximal coefficient found: "
               << max_coef << "." << std::endl;
   }
@@ -806,80 +806,171 @@ method |lift_remainders| will be properly called. Lifting is performed in a
 bottom-up tree-like pattern, which tries to combine moduli that have the same
 distance from the original moduli, and therefore approximately the same size.
 
+Lifting is independent for different polynomials, so it can be done by
+several threads. The polynomials are handled in chunks of |chunk_size|; the
+modular coefficients of a chunk are read by the main thread (the
+|modulus_info| objects access their files in an order that is not sequential,
+and cannot be shared between threads), after which the chunk is cut into
+|n_threads| consecutive slices that are lifted concurrently, each slice into a
+buffer of its own. Finally the buffers are written out in order. In this way
+memory use is bounded independently of the number of polynomials, and the
+output is the same as when lifting is done by a single thread.
+
 @h <iomanip>
+@h <algorithm>
+@h <chrono>
+@h <thread>
 
 @< Function definitions @>=
+@< Definition of |lift_slice| @>@;
 ulong write_coefficients
  (ulong coefficient_size,
   const std::vector<modulus_info*>& mod_info,
   const std::vector<ChineseBox*>& box,
   std::ostream& out,
-  bool verbose, bool output)
+  bool verbose, bool output, unsigned int n_threads)
 @/// return value is maximum of lifted coefficients
-{ ulong nr_pols=mod_info[0]->nr_pol();
+{ const ulong chunk_size=0x10000; // number of polynomials read at once
+  ulong nr_pols=mod_info[0]->nr_pol();
   ulong n=mod_info.size(); // number of moduli
   ulong max=0;
+  std::vector<std::vector<ulong> > modular_pol(chunk_size*n);
+   // polynomials from the base moduli, for the current chunk
+  std::vector<slice_result> slice(n_threads);
+  auto start=std::chrono::steady_clock::now();
+@)
+  for (ulong first=0; first<nr_pols; first+=chunk_size)
+  { ulong last=std::min(first+chunk_size,nr_pols); // end of this chunk
+    @< Read polynomial coefficients for polynomials |first<=i<last|
+       into |modular_pol| @>
+    @< Lift the polynomials of the chunk in |n_threads| slices @>
+    @< Write out the |slice| buffers in order, tracking the maximal
+       coefficient @>
+    if (verbose)
+      @< Show progress and throughput after |last| polynomials @>
+  }
+  if (verbose) // make final display stay visible
+    std::cerr << '\n';
+  return max;
+}
+
+@ The modular polynomial coefficients are extracted one polynomial at a time
+via the |coefficients| method of the |mod_info| elements, and collected in the
+vector |modular_pol|, which holds |n| polynomials for each polynomial of the
+chunk (and which is re-used for every chunk).
+
+@< Read polynomial coefficients... @>=
+for (ulong i=first; i<last; ++i)
+  for (ulong j=0; j<n; ++j)
+    modular_pol[(i-first)*n+j]=mod_info[j]->coefficients(i);
+
+@ A slice records the bytes to be written for its polynomials, and also every
+coefficient that exceeds all previous ones in the slice, together with the
+number of its polynomial; this suffices to reproduce the messages about the
+maximal coefficient that a sequential computation would have printed. If
+lifting fails, the slice records where this happened and stops.
+
+@h <utility>
+@< Type definitions @>=
+struct slice_result
+{ std::ostringstream bytes; // the lifted coefficients, in output format
+  std::vector<std::pair<ulong,ulong> > records;
+   // polynomial number and value of successive maximal coefficients
+  bool failed; // whether an incompatibility was found
+  ulong bad_pol, bad_coef; // if so, where it was found
+};
+
+@ The function |lift_slice| lifts the polynomials |begin<=i<end|. The length of
+a lifted polynomial is the maximal length of its modular polynomials, which
+need not be the same for all moduli. Each thread needs its own vector |rem| of
+remainders; the Chinese boxes themselves are only read.
+
+@< Definition of |lift_slice| @>=
+void lift_slice
+  (const std::vector<ChineseBox*>& box, ulong coefficient_size, bool output,
+   const std::vector<std::vector<ulong> >& modular_pol, // for the chunk
+   ulong first, ulong begin, ulong end, slice_result& result)
+{ ulong n=box.size()+1; // number of moduli
+  result.bytes.str(""); result.records.clear(); result.failed=false;
+  ulong max=0; // maximum within this slice
   std::vector<ulong> rem(2*n-1);
       // remainders for |n| original and |n-1| derived moduli
-  std::vector<std::vector<ulong> > modular_pol(n);
-   // polynomials from the base moduli
-@)
-  for (ulong i=0; i<nr_pols; ++i)
-  { if (verbose and (i&0xFFF)==0)
-      std::cerr << "Polynomial: " << std::setw(10) << i << '\r';
+  for (ulong i=begin; i<end; ++i)
+  { const std::vector<ulong>* pol=&modular_pol[(i-first)*n];
     ulong len=0; // maximum of degree+1 of polynomials selected
-
-@)
-    @< Read polynomial coefficients into |modular_pol|,
-       and compute their maximal length in |len| @>
-    std::vector<ulong> lifted_pol(len);
-    // the polynomial modulo the lcm of the moduli
+    for (ulong j=0; j<n; ++j)
+      if (pol[j].size()>len) len=pol[j].size();
 @)
     for (ulong d=0; d<len; ++d)
     { for (ulong j=0; j<n; ++j) // install original remainders
-        rem[j]= d>=modular_pol[j].size() ? 0 : modular_pol[j][d];
+        rem[j]= d>=pol[j].size() ? 0 : pol[j][d];
        try
        { for (ulong j=0; j<n-1; ++j)
            rem[n+j]=box[j]->lift_remainders(rem[2*j],rem[2*j+1]);
            // it happens here!
          ulong c=rem.back();
-	 @< Track maximal coefficient and show progress @>
-         if (output) write_bytes(c, coefficient_size, out);
+         if (c>max) {@; max=c; result.records.push_back(std::make_pair(i,c)); }
+         if (output) write_bytes(c, coefficient_size, result.bytes);
        }
        catch (bool)
        // incompatibility found during lift; details are already printed
-       { std::cerr << "In coefficient " << d
-		   << " of polynomial " << i << ".\n";
-         exit(1);
+       {@; result.failed=true; result.bad_pol=i; result.bad_coef=d;
+         return;
        }
     }
   }
-  if (verbose) // make final polynomial displayed look right, and stay visible
-    std::cerr << "Polynomial: " << std::setw(10) << nr_pols-1 << '\n';
-  return max;
 }
 
-@ The modular polynomial coefficients are extracted one polynomial at a time
-via the |coefficients| method of the |mod_info| elements, and collected in the
-vector |modular_pol| of polynomials (which is re-used repeatedly). Their
-length need no be the same for all moduli, so we take for |len| the maximal
-length.
+@ The slices are nearly equal in size. The calling thread takes the first slice
+itself, and there is no need to create any threads if |n_threads==1|.
+
+@< Lift the polynomials of the chunk in |n_threads| slices @>=
+{ ulong slice_size=(last-first+n_threads-1)/n_threads;
+  std::vector<std::thread> threads;
+  for (unsigned int t=1; t<n_threads; ++t)
+  { ulong begin=std::min(first+t*slice_size,last),
+      end=std::min(begin+slice_size,last);
+    threads.emplace_back(lift_slice,std::cref(box),coefficient_size,output,
+                         std::cref(modular_pol),first,begin,end,
+                         std::ref(slice[t]));
+  }
+  lift_slice(box,coefficient_size,output,modular_pol,
+             first,first,std::min(first+slice_size,last),slice[0]);
+  for (ulong t=0; t<threads.size(); ++t)
+    threads[t].join();
+}
 
-@< Read polynomial coefficients... @>=
-for (ulong j=0; j<mod_info.size(); ++j)
-{ modular_pol[j]=mod_info[j]->coefficients(i);
-  if (modular_pol[j].size()>len) len=modular_pol[j].size();
+@ Keeping track of the maximal coefficient is done by going through the
+records of the slices in order; each time it increases we print a line. This
+line is rarely printed and rather informative, so we print it even in quiet
+mode. Failure of a slice is reported only after the preceding slices have
+been handled, so that the output is as it would be without threads.
+
+@< Write out the |slice| buffers in order... @>=
+for (unsigned int t=0; t<n_threads; ++t)
+{ for (ulong k=0; k<slice[t].records.size(); ++k)
+    if (slice[t].records[k].second>max)
+    { max=slice[t].records[k].second;
+      std::cout << "Maximal coefficient so far: " @|
+                << max << ", in polynomial " << slice[t].records[k].first
+                << std::endl;
+    }
+  if (slice[t].failed)
+  { std::cerr << "In coefficient " << slice[t].bad_coef
+	      << " of polynomial " << slice[t].bad_pol << ".\n";
+    exit(1);
+  }
+  if (output) out << slice[t].bytes.str();
 }
 
-@ Keeping track of the maximal coefficient is trivial; each time it increases
-we update the current display line. This line is rarely printed and rather
-informative, so we print it even in quiet mode.
+@ The progress display gives the rate over the whole computation so far.
 
-@< Track maximal coefficient and show progress @>=
-if (c>max)
-{ max=c;
-  std::cout << "Maximal coefficient so far: " @|
-            << max << ", in polynomial " << i << std::endl;
+@< Show progress and throughput... @>=
+{ double seconds = std::chrono::duration<double>
+    (std::chrono::steady_clock::now()-start).count();
+  std::cerr << "Polynomial: " << std::setw(10) << last-1 << ", "
+            << std::setw(8) << (seconds>0 ? ulong(last/seconds) : 0ul)
+            << " polynomials/s\r";
 }
 
 
@@ -900,6 +991,13 @@ int main(int argc, char** argv)
     {@; double_tables=true; --argc; ++argv;}
   if (argc>0 and std::string(*argv)=="-nowrite")
     {@; output=false; --argc; ++argv;}
+  unsigned int n_threads=1;
+  if (argc>1 and std::string(*argv)=="-j")
+  { n_threads=std::atoi(argv[1]);
+    if (n_threads==0) n_threads=std::thread::hardware_concurrency();
+    if (n_threads==0) n_threads=1; // when concurrency cannot be determined
+    argc-=2; argv+=2;
+  }
 @)
   std::string mat_base,coef_base;
   // base names for renumbering and coefficient files
@@ -932,7 +1030,8 @@ int main(int argc, char** argv)
               << nr_c << " coefficient bytes." << std::endl;
     ulong max_coef=
        write_coefficients
-         (coefficient_size,mod_info,box,coefficient_file,verbose,output);
+         (coefficient_size,mod_info,box,coefficient_file,verbose,output,
+          n_threads);
     std::cout << "Maximal coefficient found: "
               << max_coef << "." << std::endl;
   }
@@ -1,5 +1,6 @@
 #include <iostream>
-#include <fstream>
+#include <memory>
+#include <stdexcept>
 #include <cstdlib> // for |exit|
 #include "filekl_in.h"
 
@@ -15,14 +16,18 @@ int main(int argc, char** argv)
     exit(1);
   }
 
-  std::ifstream pol_file(argv[0]);
-  if (not pol_file.is_open())
+  std::unique_ptr<atlas::filekl::mapped_file> pol_file;
+  try
   {
-    std::cerr << "Failure opening file.\n";
+    pol_file.reset(new atlas::filekl::mapped_file(argv[0]));
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Failure opening file: " << e.what() << ".\n";
     exit(1);
   }
 
-  atlas::filekl::polynomial_info pi(pol_file);
+  atlas::filekl::polynomial_info pi(*pol_file);
 
   for (size_t i=0; i<pi.n_polynomials(); ++i)
     if (pi.degree(i)==1)
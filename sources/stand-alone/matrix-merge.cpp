@@ -3,9 +3,12 @@
 #include  <iostream>
 #include  <stdexcept>
 #include  "../utilities/bitmap.h"
+#include  <atomic>
+#include  <thread>
 #include  <string>
 #include  <fstream>
 #include  <sstream>
+#include  <chrono>
 #include  <cstdlib>
 #include  "../utilities/arithmetic.h"
 #include  <iomanip>
@@ -35,6 +38,15 @@ template<unsigned int n>
 
 typedef std::vector<std::pair<unsigned int,unsigned int> > coord_vector;
 
+template<unsigned int n>
+  struct merged_row
+  { unsigned int y, nr_prim;
+    std::vector<unsigned int> bitmap; // merged bitmap, as it will be written
+    std::vector<unsigned int> position; // bit positions in |bitmap|
+    std::vector<tuple_entry<n> > tuple; // modular numbers at those positions
+    std::vector<unsigned int> code; // their sequence numbers, once known
+  };
+
 const std::ios_base::openmode binary_out=
 			    std::ios_base::out
 			  | std::ios_base::trunc
@@ -68,12 +80,9 @@ void write_int(unsigned int n, std::ostream& out)
   out.put(char(n));
 }
 template<unsigned int n>
-  void combine_rows
-    (unsigned int y,
-     atlas::hashtable::HashTable<tuple_entry<n>,unsigned int>& hash,
-     std::vector<std::istream*>in, std::ostream& out,
-     std::vector<unsigned int>& lim,
-     coord_vector* first_use)
+  void read_row
+    (unsigned int y, std::vector<std::istream*>in,
+     std::vector<unsigned int>& lim, merged_row<n>& row)
   { for (unsigned int i=0; i<n; ++i)
       if (read_int(*in[i])!=y) 
                             { std::cerr << "y=" << y << ", i=" << i << ":\n";
@@ -86,7 +95,8 @@ template<unsigned int n>
         { std::cerr << "y=" << y << ", i=" << i << ":\n";
           throw std::runtime_error("Primitive count mismatch in source files");
         }
-    write_int(y,out); write_int(nr_prim,out); // reproduce info in output
+    row.y=y; row.nr_prim=nr_prim;
+    row.bitmap.clear(); row.position.clear(); row.tuple.clear();
 
     
     typedef atlas::bitmap::BitMap bit_map;
@@ -100,7 +110,7 @@ template<unsigned int n>
       { unsigned int bj=read_int(*in[j]); in_map[j].setRange(i,32,bj);
         b |= bj;
       }
-      out_map.setRange(i,32,b); write_int(b,out);
+      out_map.setRange(i,32,b); row.bitmap.push_back(b);
     }
     
     for (bit_map::iterator it=out_map.begin(); it(); ++it)
@@ -112,11 +122,48 @@ template<unsigned int n>
             // keep track of limit for modular numbers
         }
         else {} // |tuple[j]| stays 0; and nothing is read from |*in[j]|
-      tuple_entry<n> e(tuple);
-      unsigned int size=hash.size();
-      unsigned int code=hash.match(e);
-      if (first_use!=NULL and code==size)
-        first_use->push_back(std::make_pair(*it,y));
+      row.position.push_back(*it);
+      row.tuple.push_back(tuple_entry<n>(tuple));
+    }
+  }
+
+template<unsigned int n>
+  void look_up_rows
+    (const atlas::hashtable::HashTable<tuple_entry<n>,unsigned int>& hash,
+     std::vector<merged_row<n> >& rows, size_t n_rows, unsigned int n_threads)
+  { std::atomic<size_t> next(0);
+    auto worker = [&hash,&rows,&next,n_rows] ()
+    { for (size_t r; (r=next++)<n_rows; )
+      { merged_row<n>& row=rows[r];
+        row.code.resize(row.tuple.size());
+        for (size_t k=0; k<row.tuple.size(); ++k)
+          row.code[k]=hash.find(row.tuple[k]);
+      }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned int t=1; t<n_threads; ++t)
+      threads.emplace_back(worker);
+    worker(); // the calling thread participates as well
+    for (auto& t : threads)
+      t.join();
+  }
+
+template<unsigned int n>
+  void write_row
+    (atlas::hashtable::HashTable<tuple_entry<n>,unsigned int>& hash,
+     merged_row<n>& row, std::ostream& out, coord_vector* first_use)
+  { typedef atlas::hashtable::HashTable<tuple_entry<n>,unsigned int> table;
+    write_int(row.y,out); write_int(row.nr_prim,out);
+    for (size_t i=0; i<row.bitmap.size(); ++i)
+      write_int(row.bitmap[i],out);
+    for (size_t k=0; k<row.tuple.size(); ++k)
+    { unsigned int code=row.code[k];
+      if (code==table::empty)
+      { unsigned int size=hash.size();
+        code=hash.match(row.tuple[k]);
+        if (first_use!=NULL and code==size)
+          first_use->push_back(std::make_pair(row.position[k],row.y));
+      }
       write_int(code,out);
     }
   }
@@ -125,14 +172,19 @@ template<unsigned int n>
 void do_work
   (std::string name_base,
    std::vector<unsigned int>& modulus,
-   coord_vector* first_use)
+   coord_vector* first_use, unsigned int n_threads)
 { 
-  std::vector<std::ifstream*>in_file(n,NULL);
+  const size_t buffer_size=1<<22;
+    std::vector<std::vector<char> > in_buffer(n,std::vector<char>(buffer_size));
+    std::vector<char> out_buffer(buffer_size);
+    std::vector<std::ifstream*>in_file(n,NULL);
     std::vector<std::istream*>in_stream(n,NULL);
     for (unsigned int i=0; i<n; ++i)
     { std::ostringstream name;
       name << name_base << "-mod" << modulus[i];
-      in_file[i]=new std::ifstream(name.str().c_str(),binary_in);
+      in_file[i]=new std::ifstream;
+      in_file[i]->rdbuf()->pubsetbuf(&in_buffer[i][0],buffer_size);
+      in_file[i]->open(name.str().c_str(),binary_in);
       if (in_file[i]->is_open())
         in_stream[i]=in_file[i]; // get stream underlying file stream
       else
@@ -154,7 +206,9 @@ void do_work
         if (out_modulus==modulus[i]) write_protect=true;
       if (write_protect) name << '+'; // avoid overwriting file for one modulus
     }
-    std::ofstream out_file(name.str().c_str(),binary_out);
+    std::ofstream out_file;
+    out_file.rdbuf()->pubsetbuf(&out_buffer[0],buffer_size);
+    out_file.open(name.str().c_str(),binary_out);
     if (out_file.is_open())
       std::cout << "Output to file: " << name.str() << '\n';
     else
@@ -170,13 +224,31 @@ void do_work
   std::vector<unsigned int> words_for_row;
   std::streamoff position=out_file.tellp(); // this should be |0|
 
+  const size_t chunk_entries=1<<20; // tuples per chunk
+  std::vector<merged_row<n> > chunk;
+  auto start=std::chrono::steady_clock::now();
   unsigned int n_rows=0; // at end of loop this number will count the rows
-  for (unsigned int y=0; in_stream[0]->peek()!=EOF; n_rows=++y)
-     // something remains to read
-  { std::cerr << y << '\r';
-    combine_rows<n>(y,hash,in_stream,out_file,limits,first_use);
-    std::streamoff new_pos=out_file.tellp(); // output position after row |y|
-    words_for_row.push_back((new_pos-position)/4); position=new_pos;
+  while (in_stream[0]->peek()!=EOF) // something remains to read
+  { size_t n_chunk=0, entries=0;
+    for (; entries<chunk_entries and in_stream[0]->peek()!=EOF; ++n_chunk)
+    { if (n_chunk==chunk.size())
+        chunk.push_back(merged_row<n>());
+      read_row<n>(n_rows+n_chunk,in_stream,limits,chunk[n_chunk]);
+      entries+=chunk[n_chunk].tuple.size();
+    }
+    look_up_rows<n>(hash,chunk,n_chunk,n_threads);
+    for (size_t r=0; r<n_chunk; ++r)
+    { write_row<n>(hash,chunk[r],out_file,first_use);
+      std::streamoff new_pos=out_file.tellp(); // output position after row
+      words_for_row.push_back((new_pos-position)/4); position=new_pos;
+    }
+    n_rows+=n_chunk;
+    
+    { double seconds = std::chrono::duration<double>
+        (std::chrono::steady_clock::now()-start).count();
+      std::cerr << n_rows << " rows, " << std::setw(8)
+                << (seconds>0 ? unsigned(n_rows/seconds) : 0u) << " rows/s\r";
+    }
   }
   std::cerr << "\ndone!\n";
   for (unsigned int i=0; i<n; ++i) delete in_file[i]; // close files
@@ -232,6 +304,14 @@ int main(int argc,char** argv)
       argc-=2; argv+=2;
     }
 
+  unsigned int n_threads=1;
+  if (argc>1 and std::string(*argv)=="-j")
+  { n_threads=std::atoi(argv[1]);
+    if (n_threads==0) n_threads=std::thread::hardware_concurrency();
+    if (n_threads==0) n_threads=1; // when concurrency cannot be determined
+    argc-=2; argv+=2;
+  }
+
   std::string base;
   if (argc>0) { base=*argv++; --argc; }
   else
@@ -263,12 +343,12 @@ int main(int argc,char** argv)
 
 
   switch (moduli.size())
-  { case 1: do_work<1>(base,moduli,uses); break;
-    case 2: do_work<2>(base,moduli,uses); break;
-    case 3: do_work<3>(base,moduli,uses); break;
-    case 4: do_work<4>(base,moduli,uses); break;
-    case 5: do_work<5>(base,moduli,uses); break;
-    case 6: do_work<6>(base,moduli,uses); break;
+  { case 1: do_work<1>(base,moduli,uses,n_threads); break;
+    case 2: do_work<2>(base,moduli,uses,n_threads); break;
+    case 3: do_work<3>(base,moduli,uses,n_threads); break;
+    case 4: do_work<4>(base,moduli,uses,n_threads); break;
+    case 5: do_work<5>(base,moduli,uses,n_threads); break;
+    case 6: do_work<6>(base,moduli,uses,n_threads); break;
     default: std::cout << "I cannot handle " << moduli.size()
 		       << " moduli, sorry.\n";
   }
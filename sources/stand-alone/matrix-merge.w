@@ -124,30 +124,50 @@ not know here, but its position in bitmap of the ``row'' of the matrix
 written, in other words within the list of weakly primitive elements for (the
 descent set of) this~$y$.
 
+For large blocks the hash table lookups dominate the running time, so we
+process rows in chunks: a chunk of rows is read in sequentially, then the
+tuples of the chunk are looked up in the hash table by several threads at
+once, and finally the rows are written out in order. Lookups that fail
+because the tuple is new are repeated in the final sequential phase, which
+assigns the new sequence numbers; since this phase handles the tuples in the
+same order as before, the output does not depend on the number of threads.
+The following structure holds one row of the merged matrix between the
+phases.
+
+@< Type definitions @>=
+template<unsigned int n>
+  struct merged_row
+  { unsigned int y, nr_prim;
+    std::vector<unsigned int> bitmap; // merged bitmap, as it will be written
+    std::vector<unsigned int> position; // bit positions in |bitmap|
+    std::vector<tuple_entry<n> > tuple; // modular numbers at those positions
+    std::vector<unsigned int> code; // their sequence numbers, once known
+  };
+
+@ Reading a row fills a |merged_row| structure, checking that the row headers
+in the various input files agree.
+
 @h <iostream>
 @h <stdexcept>
 
 @< Function definitions @>=
 @< Auxiliary functions @>
 template<unsigned int n>
-  void combine_rows
-    (unsigned int y,
-     atlas::hashtable::HashTable<tuple_entry<n>,unsigned int>& hash,
-     std::vector<std::istream*>in, std::ostream& out,
-     std::vector<unsigned int>& lim,
-     coord_vector* first_use)
+  void read_row
+    (unsigned int y, std::vector<std::istream*>in,
+     std::vector<unsigned int>& lim, merged_row<n>& row)
   { for (unsigned int i=0; i<n; ++i)
       if (read_int(*in[i])!=y) @< Report alignment problem and abort @>
     unsigned int nr_prim=read_int(*in[0]);
     for (unsigned int i=1; i<n; ++i)
       if (read_int(*in[i])!=nr_prim)
         @< Report primitive count problem and abort @>
-    write_int(y,out); write_int(nr_prim,out); // reproduce info in output
+    row.y=y; row.nr_prim=nr_prim;
+    row.bitmap.clear(); row.position.clear(); row.tuple.clear();
 @)
-    @< Read and merge bitmaps from the input file,
-       writing the merged bitmap to |out| @>
+    @< Read and merge bitmaps from the input files into |row.bitmap| @>
     @< Traverse primitive elements with nonzero polynomial,
-       looking up and writing the corresponding sequence number to |out| @>
+       collecting their positions and tuples of modular numbers in |row| @>
   }
 
 @ Since the bitmaps from the various files have the same capacity and
@@ -157,7 +177,7 @@ taking the bitwise logical~``or''. Since we shall need the merged sequence and
 the individual modular bitmaps in the next phase, we store them in variables.
 
 @h "../utilities/bitmap.h"
-@< Read and merge bitmaps from the input file,... @>=
+@< Read and merge bitmaps from the input files into |row.bitmap| @>=
 
 typedef atlas::bitmap::BitMap bit_map;
 
@@ -170,14 +190,14 @@ for (size_t i=0; i<nr_prim; i+=32)
   @/{@; unsigned int bj=read_int(*in[j]); in_map[j].setRange(i,32,bj);
     b |= bj;
   }
-  out_map.setRange(i,32,b); write_int(b,out);
+  out_map.setRange(i,32,b); row.bitmap.push_back(b);
 }
 
 @ Here we can use a bitmap-iterator over |out_map|. For each position produced
 by this iterator, we read the corresponding number from the file~|in[j]| if
 the corresponding bit of |in_map[j]| is set; if not we take the index~|0|
-associated to the zero polynomial. Note the use of |tuple_entry<n>| below is
-the sole reason that our current function is a template function.
+associated to the zero polynomial. The tuples are only stored here; looking
+them up is left to the functions below.
 
 @< Traverse primitive elements with nonzero polynomial,... @>=
 
@@ -190,14 +210,67 @@ for (bit_map::iterator it=out_map.begin(); it(); ++it)
         // keep track of limit for modular numbers
     }
     else {} // |tuple[j]| stays 0; and nothing is read from |*in[j]|
-  tuple_entry<n> e(tuple);
-  unsigned int size=hash.size();
-  unsigned int code=hash.match(e);
-  if (first_use!=NULL and code==size)
-    first_use->push_back(std::make_pair(*it,y));
-  write_int(code,out);
+  row.position.push_back(*it);
+  row.tuple.push_back(tuple_entry<n>(tuple));
 }
 
+@ The parallel phase only uses the |const| method |find| of the hash table,
+which does not modify anything, so that it is safe to call it from several
+threads as long as no thread calls |match|. Rows are handed out to the threads
+one at a time using an atomic counter, as they vary a lot in size. When |find|
+fails it returns |HashTable::empty|, which is recorded as code for now.
+
+@h <atomic>
+@h <thread>
+
+@< Function definitions @>=
+template<unsigned int n>
+  void look_up_rows
+    (const atlas::hashtable::HashTable<tuple_entry<n>,unsigned int>& hash,
+     std::vector<merged_row<n> >& rows, size_t n_rows, unsigned int n_threads)
+  { std::atomic<size_t> next(0);
+    auto worker = [&hash,&rows,&next,n_rows] ()
+    { for (size_t r; (r=next++)<n_rows; )
+      { merged_row<n>& row=rows[r];
+        row.code.resize(row.tuple.size());
+        for (size_t k=0; k<row.tuple.size(); ++k)
+          row.code[k]=hash.find(row.tuple[k]);
+      }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned int t=1; t<n_threads; ++t)
+      threads.emplace_back(worker);
+    worker(); // the calling thread participates as well
+    for (auto& t : threads)
+      t.join();
+  }
+
+@ In the final phase each row is written out, after replacing the failed
+lookups by calls of |match|. Only the first of those will in fact add a new
+tuple to the table; if the same new tuple occurs again in the same chunk, the
+second call of |match| will find it.
+
+@< Function definitions @>=
+template<unsigned int n>
+  void write_row
+    (atlas::hashtable::HashTable<tuple_entry<n>,unsigned int>& hash,
+     merged_row<n>& row, std::ostream& out, coord_vector* first_use)
+  { typedef atlas::hashtable::HashTable<tuple_entry<n>,unsigned int> table;
+    write_int(row.y,out); write_int(row.nr_prim,out);
+    for (size_t i=0; i<row.bitmap.size(); ++i)
+      write_int(row.bitmap[i],out);
+    for (size_t k=0; k<row.tuple.size(); ++k)
+    { unsigned int code=row.code[k];
+      if (code==table::empty)
+      { unsigned int size=hash.size();
+        code=hash.match(row.tuple[k]);
+        if (first_use!=NULL and code==size)
+          first_use->push_back(std::make_pair(row.position[k],row.y));
+      }
+      write_int(code,out);
+    }
+  }
+
 @ When we cannot recognise the start of a row, we say which one it is and
 quit.
 @< Report alignment problem and abort @>=
@@ -233,18 +306,23 @@ void write_int(unsigned int n, std::ostream& out)
 }
 
 @ Here is a function that will set up the hash table and the I/O streams, and
-repeatedly call |combine rows|. Again it must be a template function depending
-on~|n|.
+repeatedly process chunks of rows. Again it must be a template function
+depending on~|n|. A chunk is ended once it holds |chunk_entries| tuples, which
+bounds the memory used independently of the size of the matrix. The row
+structures are reused from one chunk to the next, so that their vectors need
+not be reallocated. During the computation we show the number of rows done
+and the rate at which they are processed.
 
 @h <string>
 @h <fstream>
 @h <sstream>
+@h <chrono>
 @< Function definitions @>=
 template<unsigned int n>
 void do_work
   (std::string name_base,
    std::vector<unsigned int>& modulus,
-   coord_vector* first_use)
+   coord_vector* first_use, unsigned int n_threads)
 { @< Open input and output files @>
 @)
   std::vector<tuple_entry<n> > pool;
@@ -255,13 +333,26 @@ void do_work
   std::vector<unsigned int> words_for_row;
   std::streamoff position=out_file.tellp(); // this should be |0|
 @)
+  const size_t chunk_entries=1<<20; // tuples per chunk
+  std::vector<merged_row<n> > chunk;
+  auto start=std::chrono::steady_clock::now();
   unsigned int n_rows=0; // at end of loop this number will count the rows
-  for (unsigned int y=0; in_stream[0]->peek()!=EOF; n_rows=++y)
-     // something remains to read
-  {@; std::cerr << y << '\r';
-    combine_rows<n>(y,hash,in_stream,out_file,limits,first_use);
-    std::streamoff new_pos=out_file.tellp(); // output position after row |y|
-    words_for_row.push_back((new_pos-position)/4); position=new_pos;
+  while (in_stream[0]->peek()!=EOF) // something remains to read
+  { size_t n_chunk=0, entries=0;
+    for (; entries<chunk_entries and in_stream[0]->peek()!=EOF; ++n_chunk)
+    { if (n_chunk==chunk.size())
+        chunk.push_back(merged_row<n>());
+      read_row<n>(n_rows+n_chunk,in_stream,limits,chunk[n_chunk]);
+      entries+=chunk[n_chunk].tuple.size();
+    }
+    look_up_rows<n>(hash,chunk,n_chunk,n_threads);
+    for (size_t r=0; r<n_chunk; ++r)
+    { write_row<n>(hash,chunk[r],out_file,first_use);
+      std::streamoff new_pos=out_file.tellp(); // output position after row
+      words_for_row.push_back((new_pos-position)/4); position=new_pos;
+    }
+    n_rows+=n_chunk;
+    @< Show progress after |n_rows| rows @>
   }
   std::cerr << "\ndone!\n";
   for (unsigned int i=0; i<n; ++i) delete in_file[i]; // close files
@@ -272,6 +363,16 @@ void do_work
   @< Write files recording the renumbering performed @>
 }
 
+@ The rate is computed over the whole computation so far, which smooths out
+the variation between chunks.
+
+@< Show progress after |n_rows| rows @>=
+{ double seconds = std::chrono::duration<double>
+    (std::chrono::steady_clock::now()-start).count();
+  std::cerr << n_rows << " rows, " << std::setw(8)
+            << (seconds>0 ? unsigned(n_rows/seconds) : 0u) << " rows/s\r";
+}
+
 @ For opening files in binary modes the following constants are useful.
 @s openmode int
 @< Constant definitions @>=
@@ -285,16 +386,23 @@ const std::ios_base::openmode binary_in=
 			  | std::ios_base::binary;
 
 @ Opening files is easy and a bit repetitive. For input files we need pointers
-in order to store them in a vector.
+in order to store them in a vector. All files are read and written strictly
+sequentially, so we give them buffers much larger than the default ones; this
+must be done before the files are opened.
 
 @h <cstdlib>
 @< Open input and output files @>=
-std::vector<std::ifstream*>in_file(n,NULL);
+const size_t buffer_size=1<<22;
+  std::vector<std::vector<char> > in_buffer(n,std::vector<char>(buffer_size));
+  std::vector<char> out_buffer(buffer_size);
+  std::vector<std::ifstream*>in_file(n,NULL);
   std::vector<std::istream*>in_stream(n,NULL);
   for (unsigned int i=0; i<n; ++i)
   { std::ostringstream name;
     name << name_base << "-mod" << modulus[i];
-    in_file[i]=new std::ifstream(name.str().c_str(),binary_in);
+    in_file[i]=new std::ifstream;
+    in_file[i]->rdbuf()->pubsetbuf(&in_buffer[i][0],buffer_size);
+    in_file[i]->open(name.str().c_str(),binary_in);
     if (in_file[i]->is_open())
       in_stream[i]=in_file[i]; // get stream underlying file stream
     else
@@ -311,7 +419,9 @@ std::vector<std::ifstream*>in_file(n,NULL);
   name << name_base << "-mod" << out_modulus;
   @< Modify |name| if it coincides with that of one of the input files @>
 
-  std::ofstream out_file(name.str().c_str(),binary_out);
+  std::ofstream out_file;
+  out_file.rdbuf()->pubsetbuf(&out_buffer[0],buffer_size);
+  out_file.open(name.str().c_str(),binary_out);
   if (out_file.is_open())
     std::cout << "Output to file: " << name.str() << '\n';
   else
@@ -415,6 +525,14 @@ int main(int argc,char** argv)
       }
       argc-=2; argv+=2;
     }
+@)
+  unsigned int n_threads=1;
+  if (argc>1 and std::string(*argv)=="-j")
+  { n_threads=std::atoi(argv[1]);
+    if (n_threads==0) n_threads=std::thread::hardware_concurrency();
+    if (n_threads==0) n_threads=1; // when concurrency cannot be determined
+    argc-=2; argv+=2;
+  }
 @)
   std::string base;
   if (argc>0) {@; base=*argv++; --argc; }
@@ -447,12 +565,12 @@ int main(int argc,char** argv)
 
 
   switch (moduli.size())
-  { case 1: do_work<1>(base,moduli,uses); break;
-    case 2: do_work<2>(base,moduli,uses); break;
-    case 3: do_work<3>(base,moduli,uses); break;
-    case 4: do_work<4>(base,moduli,uses); break;
-    case 5: do_work<5>(base,moduli,uses); break;
-    case 6: do_work<6>(base,moduli,uses); break;
+  { case 1: do_work<1>(base,moduli,uses,n_threads); break;
+    case 2: do_work<2>(base,moduli,uses,n_threads); break;
+    case 3: do_work<3>(base,moduli,uses,n_threads); break;
+    case 4: do_work<4>(base,moduli,uses,n_threads); break;
+    case 5: do_work<5>(base,moduli,uses,n_threads); break;
+    case 6: do_work<6>(base,moduli,uses,n_threads); break;
     default: std::cout << "I cannot handle " << moduli.size()
 		       << " moduli, sorry.\n";
   }
@@ -4,8 +4,14 @@
 #include <fstream>
 #include <sstream>
 #include <map>
+#include <memory>
 #include <cassert>
 #include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <thread>
 
 #include "../Atlas.h"
 #include "filekl_in.h"
@@ -42,15 +48,121 @@ prim_multiplicities(matrix_info& m,BlockElt y)
 }
 
 
-void scan_matrix(matrix_info& m, size_t n_pol, bool with_multiplicities,
+// what is recorded for each row during the parallel scan
+struct row_record
+{
+  ullong n_sp, n_nonzero; // strongly primitives, and nonzero polynomials
+  KLIndex max_pol; // largest polynomial index found in the row, or 0
+};
+
+/* Scan the rows |y| handed out by |next| (in chunks of consecutive rows)
+   using the matrix information |m| private to this thread, tallying into |t|
+   and filling |rec[y]|. Thread number 0 also shows the progress.
+*/
+void scan_rows(matrix_info& m, bool with_multiplicities, tally_vec& t,
+	       std::vector<row_record>& rec,
+	       std::atomic<BlockElt>& next, std::atomic<BlockElt>& done,
+	       unsigned int thread,
+	       std::chrono::steady_clock::time_point start)
+{
+  const BlockElt chunk=64;
+  for (BlockElt y0; (y0=next.fetch_add(chunk))<m.block_size(); )
+  {
+    BlockElt y1=std::min<BlockElt>(y0+chunk,m.block_size());
+    for (BlockElt y=y0; y<y1; ++y)
+    {
+      const strong_prim_list& spy=m.strongly_primitives(y);
+      std::vector<unsigned int> mu =prim_multiplicities(m,y);
+
+      row_record& r=rec[y];
+      r.n_sp=spy.size(); r.n_nonzero=0; r.max_pol=0;
+      for (size_t i=0; i<spy.size(); ++i)
+      {
+	r.n_nonzero+=mu[i];
+	KLIndex k=m.find_pol_nr(spy[i],y);
+	if (with_multiplicities) t.tally(k,mu[i]);
+	else t.tally(k);
+	if (k>r.max_pol) r.max_pol=k;
+      }
+    }
+
+    BlockElt n_done = done+=y1-y0;
+    if (verbose and thread==0)
+    {
+      double seconds=std::chrono::duration<double>
+	(std::chrono::steady_clock::now()-start).count();
+      std::cerr << n_done << " rows, "
+		<< (seconds>0 ? ullong(n_done/seconds) : 0) << " rows/s  \r";
+    }
+  }
+}
+
+/* The rows are scanned by |n_threads| threads, each with its own matrix
+   information (which caches the current row) and its own tally; the tallies
+   grow on demand, up to one byte for each polynomial index met, so each
+   thread can use up to |n_pol| bytes (and typically does). The tallies are merged afterwards,
+   and the per-row output is produced from |rec| in a final sequential pass;
+   since polynomials are numbered in order of first occurrence, the number of
+   distinct polynomials seen up to a row is one more than the largest index
+   seen so far. The output is therefore the same for any number of threads.
+*/
+void scan_matrix(const mapped_file& block_file, const mapped_file& matrix_file,
+		 size_t n_pol, bool with_multiplicities, unsigned int n_threads,
 		 std::ostream& y_out,
 		 std::ostream& tally_out,
 		 std::ostream& length_out)
 {
-  tally_vec t(n_pol);
+  std::vector<std::unique_ptr<matrix_info> > mi;
+  std::vector<std::unique_ptr<tally_vec> > part;
+  for (unsigned int i=0; i<n_threads; ++i)
+  {
+    mi.emplace_back(new matrix_info(block_file,matrix_file));
+    part.emplace_back(new tally_vec(n_pol));
+  }
+  matrix_info& m=*mi[0];
+
+  std::vector<row_record> rec(m.block_size());
+  std::atomic<BlockElt> next(0), done(0);
+  std::vector<std::exception_ptr> error(n_threads);
+  auto start=std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads;
+  for (unsigned int i=0; i<n_threads; ++i)
+    threads.emplace_back([&,i]
+    {
+      try
+      {
+	scan_rows(*mi[i],with_multiplicities,*part[i],rec,next,done,i,start);
+      }
+      catch (...)
+      {
+	error[i]=std::current_exception();
+	next=m.block_size(); // make the other threads stop soon
+      }
+    });
+  for (unsigned int i=0; i<n_threads; ++i)
+    threads[i].join();
+  for (unsigned int i=0; i<n_threads; ++i)
+    if (error[i]!=nullptr)
+      std::rethrow_exception(error[i]);
+
+  if (verbose)
+  {
+    double seconds=std::chrono::duration<double>
+      (std::chrono::steady_clock::now()-start).count();
+    std::cerr << "Scanned " << m.block_size() << " rows in " << seconds
+	      << " s with " << n_threads << " threads.\n";
+  }
+
+  tally_vec& t=*part[0];
   t.tally(0); // tally the zero polynomial, else it would be found missing
-  ullong nr_sp=0,nr_nonzero=0;
-  ullong last_nr_sp=0, last_nr_nonzero=0, last_npol=0;
+  for (unsigned int i=1; i<n_threads; ++i)
+  {
+    t.merge(*part[i]);
+    part[i].reset(); // free memory as soon as possible
+  }
+
+  ullong nr_sp=0,nr_nonzero=0,npol=0; // |npol| includes the zero polynomial
   ullong prev_l_nr_sp=0, prev_l_nr_nonzero=0, prev_l_npol=0;
   size_t l=0;
 
@@ -62,27 +174,18 @@ void scan_matrix(matrix_info& m, size_t n_pol, bool with_multiplicities,
 		 << " (+" << y-m.first_of_length(l) << "), sp: "
 		 << nr_sp-prev_l_nr_sp << ", nonzero: "
 		 << nr_nonzero-prev_l_nr_nonzero
-		 << ", new polys: " << t.size()-prev_l_npol << std::endl;
-      prev_l_nr_sp=nr_sp; prev_l_nr_nonzero=nr_nonzero; prev_l_npol=t.size();
+		 << ", new polys: " << npol-prev_l_npol << std::endl;
+      prev_l_nr_sp=nr_sp; prev_l_nr_nonzero=nr_nonzero; prev_l_npol=npol;
       ++l;
     }
 
-    if (verbose) std::cerr << y << '\r';
-
-    const strong_prim_list& spy=m.strongly_primitives(y);
-    std::vector<unsigned int> mu =prim_multiplicities(m,y);
-
-    nr_sp+=spy.size();
-    for (size_t i=0; i<spy.size(); ++i)
-    {
-      nr_nonzero+=mu[i];
-      if (with_multiplicities) t.tally(m.find_pol_nr(spy[i],y),mu[i]);
-      else t.tally(m.find_pol_nr(spy[i],y));
-    }
-    basic_io::put_int(nr_sp-last_nr_sp,y_out);    // strongly primitives seen
-    basic_io::put_int(nr_nonzero-last_nr_nonzero,y_out); // nonzero pols seen
-    basic_io::put_int(t.size()-last_npol,y_out); // distinct polynomials seen
-    last_nr_sp=nr_sp; last_nr_nonzero=nr_nonzero; last_npol=t.size();
+    const row_record& r=rec[y];
+    nr_sp+=r.n_sp; nr_nonzero+=r.n_nonzero;
+    ullong new_npol=std::max<ullong>(npol,r.max_pol+1);
+    basic_io::put_int(r.n_sp,y_out);      // strongly primitives seen
+    basic_io::put_int(r.n_nonzero,y_out); // nonzero pols seen
+    basic_io::put_int(new_npol-npol,y_out); // distinct polynomials seen
+    npol=new_npol;
   } // for(y)
 
   // summary of final level
@@ -155,26 +258,37 @@ int main(int argc, char** argv)
 
   if (argc>0 and std::string(*argv)=="-q") { verbose=false; --argc; ++argv;}
   if (argc>0 and std::string(*argv)=="-w") { with_mu=true; --argc; ++argv;}
+  unsigned int n_threads=1;
+  if (argc>1 and std::string(*argv)=="-j")
+  {
+    n_threads=std::atoi(argv[1]); argc-=2; argv+=2;
+    if (n_threads==0) n_threads=std::thread::hardware_concurrency();
+    if (n_threads==0) n_threads=1;
+  }
 
   //  atlas::constants::initConstants();
   if (argc!=5)
   {
     std::cerr <<
-      "Usage: matstat [-q] [-w] block-file matrix-file count"
-      " row-file tally-file\n";
+      "Usage: matstat [-q] [-w] [-j threads] block-file matrix-file count"
+      " row-file tally-file\n"
+      "(-j 0 uses all hardware threads; each thread needs up to count bytes\n"
+      " for its tally)\n";
     exit(1);
   }
 
-  std::ifstream block_file(argv[0]);
-  std::ifstream matrix_file(argv[1]);
-  if (not  block_file.is_open() or not matrix_file.is_open())
+  std::unique_ptr<atlas::filekl::mapped_file> block_file,matrix_file;
+  try
+  {
+    block_file.reset(new atlas::filekl::mapped_file(argv[0]));
+    matrix_file.reset(new atlas::filekl::mapped_file(argv[1]));
+  }
+  catch (std::exception& e)
   {
-    std::cerr << "Failure opening file(s).\n";
+    std::cerr << "Failure opening file(s): " << e.what() << ".\n";
     exit(1);
   }
 
-  atlas::filekl::matrix_info mi(block_file,matrix_file);
-
   // test last argument before opening output file
   std::istringstream s(argv[2]);
   unsigned long long int limit=0; s>>limit;
@@ -199,7 +313,8 @@ int main(int argc, char** argv)
     exit(1);
   }
 
-  atlas::filekl::scan_matrix(mi,limit,with_mu,row_out,tally_out,std::cout);
+  atlas::filekl::scan_matrix(*block_file,*matrix_file,limit,with_mu,n_threads,
+			     row_out,tally_out,std::cout);
 
 
 }
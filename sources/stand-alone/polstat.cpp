@@ -4,8 +4,15 @@
 #include <string>
 #include <fstream>
 #include <map>
+#include <memory>
 #include <iostream>
 #include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 #include "filekl_in.h"
 #include "basic_io.h"
@@ -18,100 +25,258 @@ namespace atlas {
 
 typedef tally::TallyVec<unsigned char> tally_vec;
 
-void scan_polynomials
-    (const atlas::filekl::block_info& bi
-    ,const atlas::filekl::polynomial_info& pi
-    ,const atlas::filekl::progress_info& ri
-    ,const tally_vec& prim_mu
-    ,const tally_vec& total_mu
-    ,const std::string file_name_base)
+size_t gcd(size_t a,size_t b);
+
+// the data of a nonzero polynomial that go into the statistics
+struct pol_summary
 {
-  const size_t deg_limit=(bi.max_length+1)/2; // this is |(max_length-1)/2+1|
+  size_t degree, val, lead;
+  tally_vec::Index at_0, at_1, contents;
 
-  tally_vec deg_val(deg_limit*(deg_limit+1)/2);
-                              // degree-valuation joint distribution
-  tally_vec q_is_1(65000000); // distribution of specialisation at 1
-  tally_vec q_is_0(9);        // distribution of specialisation at 0
-  //  tally_vec q_is_2(1ul<<31);  // distribution of specialisation at 2
-  //  tally_vec q_min_1_pos(25000); // non-negative values at q=-1
-  //  tally_vec q_min_1_neg(25000); // negative values at q=-1
-  tally_vec leading(65536);   // distribution of leading coefficients
-  tally_vec coeff(11808808);  // distribution of all coefficients
-
-  tally_vec deg_val_t(deg_limit*(deg_limit+1)/2);
-                              // degree-valuation joint distribution
-  tally_vec q_is_1_t(65000000); // distribution of specialisation at 1
-  tally_vec q_is_0_t(9);        // distribution of specialisation at 0
-  tally_vec leading_t(65536);   // distribution of leading coefficients
-  tally_vec coeff_t(11808808);  // distribution of all coefficients
-
-  unsigned int deg_max=0,val_max=0; // maxmial degree, valuation found;
+  pol_summary(const std::vector<size_t>& coeffs) // |coeffs| must be nonempty
+  : degree(coeffs.size()-1), val(0), lead(coeffs[degree])
+  , at_0(coeffs[0]), at_1(lead), contents(lead)
+  {
+    while (coeffs[val]==0) ++val;
+    for (size_t j=degree; j-->0;)
+    {
+      at_1+=coeffs[j];
+      contents=gcd(contents,coeffs[j]);
+    }
+  }
+};
 
+// maximal degree, valuation and value at $q=1$ found in some range
+struct maxima
+{
+  size_t deg_max, val_max; tally_vec::Index at_1_max;
+  maxima() : deg_max(0), val_max(0), at_1_max(0) {}
+  void add(const pol_summary& s)
+  {
+    deg_max=std::max(deg_max,s.degree);
+    val_max=std::max(val_max,s.val);
+    at_1_max=std::max(at_1_max,s.at_1);
+  }
+  void add(const maxima& m)
+  {
+    deg_max=std::max(deg_max,m.deg_max);
+    val_max=std::max(val_max,m.val_max);
+    at_1_max=std::max(at_1_max,m.at_1_max);
+  }
+};
+
+/* Scan the polynomials by ranges of indices, in |n_threads| threads. Each
+   thread obtains its own statistics accumulator from |make|, and these are
+   merged into the first one, which is returned. The polynomials are those
+   first found in rows of increasing length; ranges never straddle lengths, so
+   that the maxima can be reported per length as before. Since tallies can be
+   merged exactly, the result does not depend on the number of threads.
+
+   The tallies grow on demand, so an accumulator only takes memory for the
+   values it actually meets; in the worst case (values near the limits given
+   below) each thread can use up to about 154 MB with multiplicity files, and
+   77 MB without them.
+*/
+template<typename Stats, typename Make>
+  std::unique_ptr<Stats> parallel_scan
+    (const block_info& bi, const polynomial_info& pi, const progress_info& ri,
+     unsigned int n_threads, Make make)
+{
+  struct range { KLIndex begin, end; size_t l; };
+  const KLIndex chunk=1<<14;
+  std::vector<range> ranges;
   for (size_t l=0; l<=bi.max_length; ++l)
   {
-    for (BlockElt y=bi.start_length[l]; y<bi.start_length[l+1]; ++y)
+    KLIndex end=ri.first_new_in_row(bi.start_length[l+1]);
+    for (KLIndex i=ri.first_new_in_row(bi.start_length[l]); i<end; i+=chunk)
+      ranges.push_back(range { i, std::min(i+chunk,end), l });
+  }
+
+  std::vector<std::unique_ptr<Stats> > part;
+  for (unsigned int t=0; t<n_threads; ++t)
+    part.emplace_back(make());
+  std::vector<maxima> length_max(bi.max_length+1);
+  std::mutex length_max_lock;
+  std::atomic<size_t> next(0);
+  std::atomic<KLIndex> done(0);
+  std::vector<std::exception_ptr> error(n_threads);
+  auto start=std::chrono::steady_clock::now();
+
+  auto worker=[&](unsigned int t)
+  {
+    try
     {
-      if (verbose)
-	std::cerr << y << ", #" << ri.first_new_in_row(y) << '\r'
-		  << std::flush;
-      for (filekl::KLIndex i=ri.first_new_in_row(y);
-	   i<ri.first_new_in_row(y+1); ++i)
+      for (size_t r; (r=next++)<ranges.size(); )
       {
-        unsigned long long int mu=prim_mu.multiplicity(i);
-        unsigned long long int tot_mu=total_mu.multiplicity(i);
-	if (mu>tot_mu)
+	maxima m;
+	for (KLIndex i=ranges[r].begin; i<ranges[r].end; ++i)
 	{
-	  std::cerr << i << ": " << mu << '>' << tot_mu << ". \n";
-	  throw std::runtime_error("inconsistent multiplicities");
+	  std::vector<size_t> coeffs=pi.coefficients(i);
+	  if (coeffs.empty()) continue; // skip zero polynomial
+	  pol_summary s(coeffs);
+	  part[t]->add(i,coeffs,s);
+	  m.add(s);
 	}
-
-	std::vector<size_t> coeffs=pi.coefficients(i);
-	if (coeffs.empty()) continue; // skip zero polynomial
-	size_t degree=coeffs.size()-1;
-	size_t val=0; while (coeffs[val]==0) ++val;
-	size_t lead=coeffs[degree];
-
-	if (degree>deg_max) deg_max=degree;
-	if (val>val_max) val_max=val;
-	deg_val.tally(degree*(degree+1)/2+val,mu);
-	deg_val_t.tally(degree*(degree+1)/2+val,tot_mu);
-	if (deg_val.multiplicity(degree*(degree+1)/2)
-	    > deg_val_t.multiplicity(degree*(degree+1)/2))
 	{
-	  std::cerr << "Problem at " << i << ", ("
-		    << degree << ',' << val << "), (" << mu << "<=" << tot_mu
-		    << "): "
-		    << deg_val.multiplicity(degree*(degree+1)/2) << '>'
-		    << deg_val_t.multiplicity(degree*(degree+1)/2)
-		    << std::endl;
-	  throw std::runtime_error("Tally inversion");
+	  std::lock_guard<std::mutex> guard(length_max_lock);
+	  length_max[ranges[r].l].add(m);
 	}
-
-	tally_vec::Index at_1=lead,at_0=coeffs[0];
-	coeff.tally(lead,mu);
-	coeff_t.tally(lead,tot_mu);
-        for (size_t j=degree; j-->0;)
+	KLIndex n_done = done+=ranges[r].end-ranges[r].begin;
+	if (verbose and t==0)
 	{
-	  size_t c=coeffs[j];
-	  coeff.tally(c,mu);
-	  coeff_t.tally(c,tot_mu);
-	  at_1+=c;
+	  double seconds=std::chrono::duration<double>
+	    (std::chrono::steady_clock::now()-start).count();
+	  std::cerr << '#' << n_done << ", "
+		    << (seconds>0 ? KLIndex(n_done/seconds) : 0)
+		    << " polynomials/s  \r" << std::flush;
 	}
+      }
+    }
+    catch (...)
+    {
+      error[t]=std::current_exception();
+      next=ranges.size(); // make the other threads stop soon
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned int t=1; t<n_threads; ++t)
+    threads.emplace_back(worker,t);
+  worker(0);
+  for (size_t t=0; t<threads.size(); ++t)
+    threads[t].join();
+  for (unsigned int t=0; t<n_threads; ++t)
+    if (error[t]!=nullptr)
+      std::rethrow_exception(error[t]);
+
+  for (unsigned int t=1; t<n_threads; ++t)
+  {
+    part[0]->merge(*part[t]);
+    part[t].reset(); // free memory as soon as possible
+  }
 
-	q_is_0.tally(at_0,mu);
-	q_is_0_t.tally(at_0,tot_mu);
-	q_is_1.tally(at_1,mu);
-	q_is_1_t.tally(at_1,tot_mu);
-	leading.tally(lead,mu);
-	leading_t.tally(lead,tot_mu);
-
-      } // for (i)
-    } // for(y)
-    if (verbose)
+  if (verbose)
+  {
+    double seconds=std::chrono::duration<double>
+      (std::chrono::steady_clock::now()-start).count();
+    std::cerr << "Scanned " << done << " polynomials in " << seconds
+	      << " s with " << n_threads << " threads.\n";
+    maxima so_far;
+    for (size_t l=0; l<=bi.max_length; ++l)
+    {
+      so_far.add(length_max[l]);
       std::cout<< "Completed l=" << l << " @y=" << bi.start_length[l+1]
-	       << ", maximal deg, val, q=1: " << deg_max << ", "
-	       << val_max <<  ", " << q_is_1.size()-1 << '.' << std::endl;
-  } // for (l)
+	       << ", maximal deg, val, q=1: " << so_far.deg_max << ", "
+	       << so_far.val_max <<  ", " << so_far.at_1_max << '.' << std::endl;
+    }
+  }
+  return std::move(part[0]);
+}
+
+// statistics weighted by the multiplicities of the polynomials
+struct weighted_stats
+{
+  const tally_vec& prim_mu;
+  const tally_vec& total_mu;
+
+  tally_vec deg_val; // degree-valuation joint distribution
+  tally_vec q_is_1;  // distribution of specialisation at 1
+  tally_vec q_is_0;  // distribution of specialisation at 0
+  tally_vec leading; // distribution of leading coefficients
+  tally_vec coeff;   // distribution of all coefficients
+
+  tally_vec deg_val_t; // same, weighted by total multiplicities
+  tally_vec q_is_1_t;
+  tally_vec q_is_0_t;
+  tally_vec leading_t;
+  tally_vec coeff_t;
+
+  weighted_stats(size_t deg_limit,
+		 const tally_vec& prim_mu, const tally_vec& total_mu)
+  : prim_mu(prim_mu), total_mu(total_mu)
+  , deg_val(deg_limit*(deg_limit+1)/2), q_is_1(65000000), q_is_0(9)
+  , leading(65536), coeff(11808808)
+  , deg_val_t(deg_limit*(deg_limit+1)/2), q_is_1_t(65000000), q_is_0_t(9)
+  , leading_t(65536), coeff_t(11808808)
+  {}
+
+  void add(KLIndex i, const std::vector<size_t>& coeffs, const pol_summary& s);
+  void merge(const weighted_stats& other);
+};
+
+void weighted_stats::add
+  (KLIndex i, const std::vector<size_t>& coeffs, const pol_summary& s)
+{
+  unsigned long long int mu=prim_mu.multiplicity(i);
+  unsigned long long int tot_mu=total_mu.multiplicity(i);
+  if (mu>tot_mu)
+  {
+    std::cerr << i << ": " << mu << '>' << tot_mu << ". \n";
+    throw std::runtime_error("inconsistent multiplicities");
+  }
+
+  size_t degree=s.degree;
+  deg_val.tally(degree*(degree+1)/2+s.val,mu);
+  deg_val_t.tally(degree*(degree+1)/2+s.val,tot_mu);
+  if (deg_val.multiplicity(degree*(degree+1)/2)
+      > deg_val_t.multiplicity(degree*(degree+1)/2))
+  {
+    std::cerr << "Problem at " << i << ", ("
+	      << degree << ',' << s.val << "), (" << mu << "<=" << tot_mu
+	      << "): "
+	      << deg_val.multiplicity(degree*(degree+1)/2) << '>'
+	      << deg_val_t.multiplicity(degree*(degree+1)/2)
+	      << std::endl;
+    throw std::runtime_error("Tally inversion");
+  }
+
+  for (size_t j=degree+1; j-->0;)
+  {
+    coeff.tally(coeffs[j],mu);
+    coeff_t.tally(coeffs[j],tot_mu);
+  }
+
+  q_is_0.tally(s.at_0,mu);
+  q_is_0_t.tally(s.at_0,tot_mu);
+  q_is_1.tally(s.at_1,mu);
+  q_is_1_t.tally(s.at_1,tot_mu);
+  leading.tally(s.lead,mu);
+  leading_t.tally(s.lead,tot_mu);
+}
+
+void weighted_stats::merge(const weighted_stats& other)
+{
+  deg_val.merge(other.deg_val); deg_val_t.merge(other.deg_val_t);
+  q_is_1.merge(other.q_is_1);   q_is_1_t.merge(other.q_is_1_t);
+  q_is_0.merge(other.q_is_0);   q_is_0_t.merge(other.q_is_0_t);
+  leading.merge(other.leading); leading_t.merge(other.leading_t);
+  coeff.merge(other.coeff);     coeff_t.merge(other.coeff_t);
+}
+
+void scan_polynomials
+    (const atlas::filekl::block_info& bi
+    ,const atlas::filekl::polynomial_info& pi
+    ,const atlas::filekl::progress_info& ri
+    ,const tally_vec& prim_mu
+    ,const tally_vec& total_mu
+    ,unsigned int n_threads
+    ,const std::string file_name_base)
+{
+  const size_t deg_limit=(bi.max_length+1)/2; // this is |(max_length-1)/2+1|
+
+  std::unique_ptr<weighted_stats> stats = parallel_scan<weighted_stats>
+    (bi,pi,ri,n_threads,
+     [&] { return new weighted_stats(deg_limit,prim_mu,total_mu); });
+  const tally_vec& deg_val=stats->deg_val;
+  const tally_vec& q_is_1=stats->q_is_1;
+  const tally_vec& q_is_0=stats->q_is_0;
+  const tally_vec& leading=stats->leading;
+  const tally_vec& coeff=stats->coeff;
+  const tally_vec& deg_val_t=stats->deg_val_t;
+  const tally_vec& q_is_1_t=stats->q_is_1_t;
+  const tally_vec& q_is_0_t=stats->q_is_0_t;
+  const tally_vec& leading_t=stats->leading_t;
+  const tally_vec& coeff_t=stats->coeff_t;
 
   std::ofstream stat_out;
   stat_out.open((file_name_base+"-deg_val").c_str());
@@ -200,70 +365,59 @@ size_t gcd(size_t a,size_t b)
 
 }
 
+// statistics of the distinct polynomials
+struct unique_stats
+{
+  tally_vec deg_val; // degree-valuation joint distribution
+  tally_vec q_is_1;  // distribution of specialisation at 1
+  tally_vec q_is_0;  // distribution of specialisation at 0
+  tally_vec leading; // distribution of leading coefficients
+  tally_vec coeff;   // distribution of all coefficients
+  tally_vec cont;    // distribution of contents (=gcd(coefficients))
+
+  unique_stats(size_t deg_limit)
+  : deg_val(deg_limit*(deg_limit+1)/2), q_is_1(65000000), q_is_0(9)
+  , leading(65536), coeff(11808808), cont(256)
+  {}
+
+  void add(KLIndex, const std::vector<size_t>& coeffs, const pol_summary& s)
+  {
+    deg_val.tally(s.degree*(s.degree+1)/2+s.val);
+    for (size_t j=s.degree+1; j-->0;)
+      coeff.tally(coeffs[j]);
+    q_is_0.tally(s.at_0);
+    q_is_1.tally(s.at_1);
+    leading.tally(s.lead);
+    cont.tally(s.contents);
+  }
+  void merge(const unique_stats& other)
+  {
+    deg_val.merge(other.deg_val);
+    q_is_1.merge(other.q_is_1);
+    q_is_0.merge(other.q_is_0);
+    leading.merge(other.leading);
+    coeff.merge(other.coeff);
+    cont.merge(other.cont);
+  }
+};
+
 void scan_polynomials
     (const atlas::filekl::block_info& bi
     ,const atlas::filekl::polynomial_info& pi
     ,const atlas::filekl::progress_info& ri
+    ,unsigned int n_threads
     ,const std::string file_name_base)
 {
   const size_t deg_limit=(bi.max_length+1)/2; // this is |(max_length-1)/2+1|
 
-  tally_vec deg_val(deg_limit*(deg_limit+1)/2);
-                              // degree-valuation joint distribution
-  tally_vec q_is_1(65000000); // distribution of specialisation at 1
-  tally_vec q_is_0(9);        // distribution of specialisation at 0
-  //  tally_vec q_is_2(1ul<<31);  // distribution of specialisation at 2
-  //  tally_vec q_min_1_pos(25000); // non-negative values at q=-1
-  //  tally_vec q_min_1_neg(25000); // negative values at q=-1
-  tally_vec leading(65536);   // distribution of leading coefficients
-  tally_vec coeff(11808808);  // distribution of all coefficients
-  tally_vec cont(256);        // distribution of contents (=gcd(coefficients))
-
-  unsigned int deg_max=0,val_max=0; // maxmial degree, valuation found;
-
-  for (size_t l=0; l<=bi.max_length; ++l)
-  {
-    for (BlockElt y=bi.start_length[l]; y<bi.start_length[l+1]; ++y)
-    {
-      if (verbose)
-	std::cerr << y << ", #" << ri.first_new_in_row(y) << '\r'
-		  << std::flush;
-      for (filekl::KLIndex i=ri.first_new_in_row(y);
-	   i<ri.first_new_in_row(y+1); ++i)
-      {
-	std::vector<size_t> coeffs=pi.coefficients(i);
-	if (coeffs.empty()) continue; // skip zero polynomial
-	size_t degree=coeffs.size()-1;
-	size_t val=0; while (coeffs[val]==0) ++val;
-	size_t lead=coeffs[degree];
-
-	if (degree>deg_max) deg_max=degree;
-	if (val>val_max) val_max=val;
-	deg_val.tally(degree*(degree+1)/2+val);
-
-	tally_vec::Index at_1=lead, contents=lead;
-	tally_vec::Index at_0=coeffs[0];
-	coeff.tally(lead);
-        for (size_t j=degree; j-->0;)
-	{
-	  size_t c=coeffs[j];
-	  coeff.tally(c);
-	  at_1+=c;
-	  contents=gcd(contents,c);
-	}
-
-	q_is_0.tally(at_0);
-	q_is_1.tally(at_1);
-	leading.tally(lead);
-	cont.tally(contents);
-
-      } // for (i)
-    } // for(y)
-    if (verbose)
-      std::cout<< "Completed l=" << l << " @y=" << bi.start_length[l+1]
-	       << ", maximal deg, val, q=1: " << deg_max << ", "
-	       << val_max <<  ", " << q_is_1.size()-1 << '.' << std::endl;
-  } // for (l)
+  std::unique_ptr<unique_stats> stats = parallel_scan<unique_stats>
+    (bi,pi,ri,n_threads,[deg_limit] { return new unique_stats(deg_limit); });
+  const tally_vec& deg_val=stats->deg_val;
+  const tally_vec& q_is_1=stats->q_is_1;
+  const tally_vec& q_is_0=stats->q_is_0;
+  const tally_vec& leading=stats->leading;
+  const tally_vec& coeff=stats->coeff;
+  const tally_vec& cont=stats->cont;
 
   std::ofstream stat_out;
 
@@ -331,36 +485,47 @@ int main(int argc, char** argv)
 
   if (argc>0 and std::string(*argv)=="-q")
     { verbose=false; --argc; ++argv;}
+  unsigned int n_threads=1;
+  if (argc>1 and std::string(*argv)=="-j")
+  {
+    n_threads=std::atoi(argv[1]); argc-=2; argv+=2;
+    if (n_threads==0) n_threads=std::thread::hardware_concurrency();
+    if (n_threads==0) n_threads=1;
+  }
 
   if (argc!=3 and argc!=5)
   {
     std::cerr <<
-      "Usage: polstat [-q] block-file poly-file row-file "
-      "[tally-prim-file tally-mult-prim]\n";
+      "Usage: polstat [-q] [-j threads] block-file poly-file row-file "
+      "[tally-prim-file tally-mult-prim]\n"
+      "(-j 0 uses all hardware threads; each thread may need up to 154 MB\n"
+      " for its tallies with tally files given, 77 MB without)\n";
     exit(1);
   }
 
-  std::ifstream block_file(argv[0]);
-  std::ifstream pol_file(argv[1]);
-  std::ifstream row_file(argv[2]);
-  if (not block_file.is_open()
-      or not pol_file.is_open()
-      or not row_file.is_open())
+  std::unique_ptr<atlas::filekl::mapped_file> block_file,pol_file,row_file;
+  try
+  {
+    block_file.reset(new atlas::filekl::mapped_file(argv[0]));
+    pol_file.reset(new atlas::filekl::mapped_file(argv[1]));
+    row_file.reset(new atlas::filekl::mapped_file(argv[2]));
+  }
+  catch (std::exception& e)
   {
-    std::cerr << "Failure opening file(s).\n";
+    std::cerr << "Failure opening file(s): " << e.what() << ".\n";
     exit(1);
   }
 
   std::string file_name_base= getFileName
     ("Base file name for statistics output: ");
 
-  atlas::filekl::block_info bi(block_file);
-  atlas::filekl::polynomial_info pi(pol_file);
-  atlas::filekl::progress_info ri(row_file);
+  atlas::filekl::block_info bi(*block_file);
+  atlas::filekl::polynomial_info pi(*pol_file);
+  atlas::filekl::progress_info ri(*row_file);
 
   if (argc==3)
   {
-    atlas::filekl::scan_polynomials(bi,pi,ri,file_name_base);
+    atlas::filekl::scan_polynomials(bi,pi,ri,n_threads,file_name_base);
   }
   else
   {
@@ -375,7 +540,8 @@ int main(int argc, char** argv)
     atlas::filekl::tally_vec prim_mu(tally_file);
     atlas::filekl::tally_vec tot_mu(tally_mu_file);
 
-    atlas::filekl::scan_polynomials(bi,pi,ri,prim_mu,tot_mu,file_name_base);
+    atlas::filekl::scan_polynomials
+      (bi,pi,ri,prim_mu,tot_mu,n_threads,file_name_base);
   }
 
 
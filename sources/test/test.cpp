@@ -36,6 +36,7 @@
 #include <cassert>
 #include <iostream>
 #include <fstream>
+#include <cstdio> // for |std::remove|
 #include <map>
 
 #include "../Atlas.h" // here to preempt double inclusion of _fwd files
@@ -113,6 +114,8 @@ namespace {
   void qbranch_f();
   void srtest_f();
   void testrun_f();
+  void polytest_f();
+  void checkpointtest_f();
   void exam_f();
 
   void X_f();
@@ -155,6 +158,9 @@ void addTestCommands<commands::EmptymodeTag> (commands::CommandNode& mode)
   mode.add("testrun",testrun_f,
 	   "iterates over root data of given rank, calling examine",
 	   commands::use_tag);
+  mode.add("polytest",polytest_f,
+	   "checks sparse polynomial arithmetic against a map based version",
+	   commands::use_tag);
 
   if (testMode == EmptyMode)
     mode.add("test",test_f,test_tag);
@@ -223,6 +229,9 @@ void addTestCommands<commands::BlockmodeTag> (commands::CommandNode& mode)
   mode.add("bbraid",block_braid_f,
 	   "tests braid relations on an extended block",commands::use_tag);
 #endif
+  mode.add("checkpointtest",checkpointtest_f,
+	   "checks reading KL checkpoint files truncated in their last record",
+	   commands::use_tag);
 
   if (testMode == BlockMode)
     mode.add("test",test_f,test_tag);
@@ -293,6 +302,79 @@ void testrun_f()
 
 }
 
+/*
+  Check |Free_Abelian_light|, on which |SR_poly| and |K_type_poly| are based,
+  against the map based |Free_Abelian|, on pseudo-random sequences of operations
+  that include adding multiples of a polynomial to itself.
+*/
+using light_poly = free_abelian::Free_Abelian_light<int>; // |long| coefficients
+using map_poly = free_abelian::Free_Abelian<int>;
+
+bool same_terms(const light_poly& a, const map_poly& b)
+{
+  auto it = b.begin();
+  for (const auto& term : a)
+  {
+    while (it!=b.end() and it->second==0) // |Free_Abelian| may hold zeros
+      ++it;
+    if (it==b.end() or it->first!=term.first or it->second!=term.second)
+      return false;
+    ++it;
+  }
+  while (it!=b.end() and it->second==0)
+    ++it;
+  return it==b.end();
+}
+
+void polytest_f()
+{
+  unsigned long long seed=1;
+  auto random = [&seed] (unsigned int n) // linear congruential, value in [0,n)
+  { seed = seed*6364136223846793005ull+1442695040888963407ull;
+    return static_cast<unsigned int>((seed>>33)%n);
+  };
+
+  light_poly a,b; map_poly ref_a, ref_b; // should have the terms of |a|, |b|
+  unsigned int checks=0;
+  for (unsigned int step=0; step<100000; ++step)
+  {
+    const long m = static_cast<long>(random(5))-2; // multiplier in [-2,2]
+    const long self_m = m<0 ? m : -m; // in [-2,0]: do not let coefficients grow
+    switch (random(7))
+    {
+    case 0: case 1: // add a term to |a|, usually a new one which is postponed
+      { const int e=random(200); a.add_term(e,m); ref_a.add_term(e,m); }
+      break;
+    case 2: a.add_multiple(b,m); ref_a.add_multiple(ref_b,m);
+      break;
+    case 3: a.add_multiple(a,self_m);
+      ref_a.add_multiple(map_poly(ref_a),self_m);
+      break;
+    case 4: a.add_multiple(std::move(a),self_m);
+      ref_a.add_multiple(map_poly(ref_a),self_m);
+      break;
+    case 5:
+      if (m<0)
+	a -= a, ref_a.clear();
+      else
+	a += a, ref_a.add_multiple(map_poly(ref_a),1);
+      break;
+    case 6: std::swap(a,b); std::swap(ref_a,ref_b);
+      break;
+    }
+    if (random(8)==0) // check now and then, so that terms can remain postponed
+    {
+      ++checks;
+      if (not same_terms(a,ref_a) or not same_terms(b,ref_b))
+      {
+	std::cout << "polytest: wrong result at step " << step << std::endl;
+	return;
+      }
+    }
+  }
+  std::cout << "polytest: all " << checks << " checks passed" << std::endl;
+}
+
 
 // Main mode functions
 
@@ -997,6 +1079,85 @@ void repr_braid_f()
 
 // Block mode functions
 
+/*
+  Fill the KL table of the current block while saving a checkpoint after every
+  column (so the file gets many records), then check that reading the file cut
+  off anywhere inside its last record gives exactly the columns of the other
+  records, as when being killed while appending that record. Also check a last
+  record whose length field was never filled in, as older versions could leave.
+*/
+void checkpointtest_f()
+{
+  const Block& block = commands::currentBlock();
+  const std::string file_name = "checkpointtest.tmp";
+  {
+    kl::KL_table kl_tab(block);
+    kl_tab.set_checkpoint(file_name,0); // save after every column
+    kl_tab.fill();
+  }
+  std::string contents;
+  {
+    std::ifstream in(file_name.c_str(),std::ios_base::binary);
+    std::ostringstream buffer; buffer << in.rdbuf();
+    contents = buffer.str();
+  }
+  std::remove(file_name.c_str());
+
+  const auto columns_read = [&block] (const std::string& s) -> BlockElt
+  {
+    kl::KL_table kl_tab(block);
+    std::istringstream in(s);
+    return kl_tab.read_checkpoint(in);
+  };
+  const auto get = [&contents] (size_t pos) // little-endian 4-byte value
+  { unsigned int v=0;
+    for (unsigned int i=4; i-->0; )
+      v = (v<<8) | static_cast<unsigned char>(contents[pos+i]);
+    return v;
+  };
+
+  size_t last=28; // position of last record; the header has 7 values
+  while (last+8+get(last+4)<contents.size())
+    last += 8+get(last+4);
+  if (last+8+get(last+4)!=contents.size() or columns_read(contents)!=block.size())
+  {
+    std::cout << "checkpointtest: complete checkpoint not read correctly"
+	      << std::endl;
+    return;
+  }
+
+  const std::string before = contents.substr(0,last);
+  const BlockElt expected = columns_read(before);
+  unsigned int checks=0;
+  try
+  {
+    for (size_t end=last+1; end<contents.size(); ++end,++checks)
+      if (columns_read(contents.substr(0,end))!=expected)
+      {
+	std::cout << "checkpointtest: wrong column count when cut at byte "
+		  << end << " of " << contents.size() << std::endl;
+	return;
+      }
+    std::string old_style = contents.substr(0,last+4)+std::string(4,'\0')
+      +contents.substr(last+8,(contents.size()-last-8)/2);
+    ++checks;
+    if (columns_read(old_style)!=expected)
+    {
+      std::cout << "checkpointtest: wrong column count with length 0 record"
+		<< std::endl;
+      return;
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cout << "checkpointtest: " << e.what() << std::endl;
+    return;
+  }
+  std::cout << "checkpointtest: all " << checks << " truncations inside the "
+	    << "last record read correctly, giving " << expected << " of "
+	    << block.size() << " columns" << std::endl;
+}
+
 } // |namespace|
 
 
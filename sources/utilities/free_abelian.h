@@ -8,6 +8,8 @@
 */
 
 #include <map>
+#include <vector>
+#include <algorithm> // for |std::sort| and |std::lower_bound|
 
 #ifndef FREE_ABELIAN_H  /* guard against multiple inclusions */
 #define FREE_ABELIAN_H
@@ -122,31 +124,44 @@ template<typename T, typename C, typename Compare>
   This should save quite a bit of space when |T| is a small type, but costs a
   bit of complexity if small insertions are frequent. To alleviate this burden,
   term insertions that are not matched (so would produce a fresh term) are
-  stored in a temporary |containers::sl_list| that will be merge into to main
+  stored in a temporary vector |pending| that will be merged into the main
   vector once it gets large relative to the square root of the size of the main
   vector; thus insertion costs are amorised square root of the size per element
   at worst. Term deletions, assumed rare, are performed on the vector directly.
+  Any access to the terms first merges |pending| (which is why both vectors are
+  |mutable|), so that |main| is then sorted, and free of zero coefficients.
+
+  As a consequence, even |const| access modifies the object when |pending| is
+  nonempty, so it is not safe for several threads to read the same object
+  concurrently, unless it was accessed (for instance by |size()|) after its last
+  modification, before the threads were started. Since |SR_poly| and
+  |K_type_poly| are instances, this applies to them as well.
 */
 template<typename T, typename C, typename Compare>
   class Free_Abelian_light
 {
   using term_type = std::pair<T,C>;
   using self = Free_Abelian_light<T,C,Compare>;
-  std::vector<term_type> main;
+  mutable std::vector<term_type> main;
+  mutable std::vector<term_type> pending; // unsorted, may repeat monomials
   Compare cmp;
 
+  void flush() const { if (not pending.empty()) merge_pending(); }
+  void merge_pending() const; // sort |pending| and merge it into |main|
+
 public:
   Free_Abelian_light() // default |Compare| value for base
-  : main(), cmp(Compare()) {}
+  : main(), pending(), cmp(Compare()) {}
   Free_Abelian_light(Compare c) // here a specific |Compare| is used
-  : main(), cmp(c) {}
+  : main(), pending(), cmp(c) {}
 
   explicit Free_Abelian_light(const T& p, Compare c=Compare()) // monomial
-    : main(1,std::make_pair(p,C(1L))), cmp(c) {}
+    : main(1,std::make_pair(p,C(1L))), pending(), cmp(c) {}
   Free_Abelian_light(const T& p,C m, Compare c=Compare()) // mononomial
-    : main(1,std::make_pair(p,m)), cmp(c)
+    : main(1,std::make_pair(p,m)), pending(), cmp(c)
   { if (m==C(0)) main.clear(); } // ensure absence of terms with zero coefficient
 
+  // the terms in |vec| need not be sorted, and monomials may be repeated
   Free_Abelian_light(std::vector<term_type>&& vec, Compare c=Compare());
 
   // construct from another aggregate of (monomial,coefficient) pairs
@@ -176,10 +191,13 @@ public:
   self& operator-=(const self& p) { return add_multiple(p,C(-1)); }
   self& operator-=(self&& p) { return add_multiple(std::move(p),C(-1)); }
 
+  // multiply all coefficients by |m|, removing any terms that become zero
+  self& operator*=(C m);
+
   C operator[] (const T& t) const; // find coefficient of |t| in |*this|
 
   bool is_zero () const { return begin()==end(); } // this ignores zeros
-  size_t size() const { return main.size(); }
+  size_t size() const { flush(); return main.size(); }
 
   class const_iterator
   { const self* parent;
@@ -220,12 +238,19 @@ public:
   };
 
   const_iterator begin() const
-  { auto it = main.begin();
-    while (it!=main.end() and it->second==C(0)) // skip any leading zero term
+  { flush();
+    auto it = main.cbegin();
+    while (it!=main.cend() and it->second==C(0)) // skip any leading zero term
       ++it;
     return {this,it};
   }
-  const_iterator end() const { return {this,main.end()}; }
+  const_iterator end() const { flush(); return {this,main.cend()}; }
+
+  // after |flush| there are no zero terms, so plain vector iterators will do
+  using const_reverse_iterator =
+    typename std::vector<term_type>::const_reverse_iterator;
+  const_reverse_iterator rbegin() const { flush(); return main.crbegin(); }
+  const_reverse_iterator rend() const { flush(); return main.crend(); }
 
 }; // |class Free_Abelian_light|
 
@@ -98,34 +98,48 @@ Monoid_Ring<T,C,Compare>
 template<typename T, typename C, typename Compare>
   Free_Abelian_light<T,C,Compare>::Free_Abelian_light
     (std::vector<term_type>&& vec, Compare c)
-  : main(std::move(vec)), cmp(c)
-{
-  auto it = std::remove_if // squeeze out any terms with zero coefficients
-    (main.begin(),main.end(),[](term_type x){return x.second==C(0);});
-  main.erase(it,main.end()); // and collect the garbage
-  auto less = [this](const term_type& a, const term_type& b)
-		    { return cmp(a.first,b.first); };
-  std::sort(main.begin(),main.end(),less); // ensure elements are sorted by |cmp|
-}
+  : main(), pending(std::move(vec)), cmp(c)
+{ flush(); } // sort, combine terms with equal monomials, and drop zero terms
 
 template<typename T, typename C, typename Compare>
 template<typename InputIterator> // iterator over (T,coef_t) pairs
   Free_Abelian_light<T,C,Compare>::Free_Abelian_light
     (InputIterator first, InputIterator last, Compare c)
-  : main(first,last), cmp(c)
+  : main(), pending(first,last), cmp(c)
+{ flush(); }
+
+// sort |pending| and merge it into |main|, combining terms with equal monomial
+template<typename T, typename C, typename Compare>
+  void Free_Abelian_light<T,C,Compare>::merge_pending() const
 {
-  auto it = std::remove_if // squeeze out any terms with zero coefficients
-    (main.begin(),main.end(),[](const term_type& x){return x.second==C(0);});
-  main.erase(it,main.end()); // and collect the garbage
   auto less = [this](const term_type& a, const term_type& b)
 		    { return cmp(a.first,b.first); };
-  std::sort(main.begin(),main.end(),less); // ensure elements are sorted by |cmp|
+  std::sort(pending.begin(),pending.end(),less);
+
+  std::vector<term_type> result; result.reserve(main.size()+pending.size());
+  auto it0 = main.begin(), it1 = pending.begin();
+  while (it0!=main.end() or it1!=pending.end())
+    if (it1==pending.end() or (it0!=main.end() and cmp(it0->first,it1->first)))
+      result.push_back(std::move(*it0++));
+    else // |*it1| comes first, or has the same monomial as |*it0|
+    {
+      term_type term = std::move(*it1++);
+      while (it1!=pending.end() and not cmp(term.first,it1->first))
+	term.second += (it1++)->second; // combine repeated monomial in |pending|
+      if (it0!=main.end() and not cmp(term.first,it0->first))
+	term.second += (it0++)->second; // combine with term from |main|
+      if (term.second!=C(0))
+	result.push_back(std::move(term));
+    }
+  main.swap(result);
+  pending.clear();
 }
 
 // find coefficient of |e| in |*this|
 template<typename T, typename C, typename Compare>
   C Free_Abelian_light<T,C,Compare>::operator[] (const T& e) const
 {
+  flush();
   auto comp = [this](const term_type& t, const T& e){ return cmp(t.first,e); };
   auto it = std::lower_bound(main.begin(),main.end(),e,comp);
   if (it==main.cend() or cmp(e,it->first))
@@ -137,12 +151,31 @@ template<typename T, typename C, typename Compare>
   Free_Abelian_light<T,C,Compare>&
     Free_Abelian_light<T,C,Compare>::add_term(const T& e, C m)
 {
+  if (m==C(0))
+    return *this; // avoid useless work that might introduce null entries
   auto comp = [this](const term_type& t, const T& e){ return cmp(t.first,e); };
   auto it = std::lower_bound(main.begin(),main.end(),e,comp);
   if (it==main.cend() or cmp(e,it->first))
-    main.emplace(it,e,m);
-  else
-    it->second += m; // this can create a zero term in |main|; leave it for now
+  { // postpone insertion, until |pending| is large enough to merge into |main|
+    pending.emplace_back(e,m);
+    if (pending.size()*pending.size()>main.size())
+      merge_pending();
+  }
+  else if ((it->second += m)==C(0))
+    main.erase(it); // remove term whose coefficient has become $0$
+  return *this;
+}
+
+template<typename T, typename C, typename Compare>
+  Free_Abelian_light<T,C,Compare>&
+    Free_Abelian_light<T,C,Compare>::operator*=(C m)
+{
+  flush();
+  for (auto& term : main)
+    term.second *= m;
+  auto it = std::remove_if // squeeze out any terms that became zero
+    (main.begin(),main.end(),[](const term_type& x){return x.second==C(0);});
+  main.erase(it,main.end());
   return *this;
 }
 
@@ -150,6 +183,9 @@ template<typename T, typename C, typename Compare>
   Free_Abelian_light<T,C,Compare>&
   Free_Abelian_light<T,C,Compare>::add_multiple(const Free_Abelian_light& p, C m)
 {
+  if (&p==this) // then moving |main| away below would also empty |p.main|
+    return *this *= C(1)+m;
+  flush(); p.flush();
   std::vector<term_type> org(std::move(main));
   main.clear(); main.reserve(org.size()+p.main.size());
   auto it0 = org.begin();
@@ -181,6 +217,9 @@ template<typename T, typename C, typename Compare>
   Free_Abelian_light<T,C,Compare>&
   Free_Abelian_light<T,C,Compare>::add_multiple(Free_Abelian_light&& p, C m)
 {
+  if (&p==this) // as above; |std::move(*this)| could be passed
+    return *this *= C(1)+m;
+  flush(); p.flush();
   std::vector<term_type> org(std::move(main));
   main.clear(); main.reserve(org.size()+p.main.size());
   auto it0 = org.begin(), it1=p.main.begin();
@@ -271,7 +310,7 @@ template<typename T, typename C, typename Compare>
 		     { return cmp(*a.lead,*b.lead); };
 
   auto n=size(); // will be upper bound for total number of terms in result
-  auto org = std::move(*this); main.clear(); // transfer
+  auto org = std::move(*this); main.clear(); // transfer; |size| did |flush|
 
   std::vector<participant> heap; heap.reserve(1+L.size());
   {
@@ -57,8 +57,22 @@ namespace hashtable {
          size_t size() const;                         // returns nr of entries
          const_reference operator[] (Number i) const; // recalls entry i
 	 void swap(Pooltype& other);                  // usual swap method
+
+     When rehashing, stored entries are hashed by calling |hashCode| directly
+     on |Pooltype::const_reference| if that type has such a method (which
+     must then agree with that of |Entry|), and otherwise by first converting
+     them to |Entry|. This allows compact storage to avoid unpacking entries.
   */
 
+// hash code of stored entry |e|; see above for the choice made
+template <class Entry, typename Ref>
+  auto stored_hash(const Ref& e, size_t modulus, int)
+  -> decltype(e.hashCode(modulus))
+  { return e.hashCode(modulus); }
+template <class Entry, typename Ref>
+  size_t stored_hash(const Ref& e, size_t modulus, long)
+  { return Entry(e).hashCode(modulus); }
+
 template <class Entry, typename Number>
 class HashTable
 {
@@ -66,6 +80,7 @@ class HashTable
   size_t d_mod;  // hash modulus, the number of slots present
   std::vector<Number> d_hash;
   typename Entry::Pooltype& d_pool;
+  size_t d_lookups, d_grows; // statistics: calls of |match|, enlargements
 
   // interface
  public:
@@ -89,6 +104,8 @@ class HashTable
     { return d_pool[i]; }
   Number size() const { return Number(d_pool.size()); }
   size_t capacity () const { return d_mod; }
+  size_t lookups () const { return d_lookups; } // number of calls of |match|
+  size_t rehashes () const { return d_grows; } // times |d_hash| was enlarged
 
  private: // auxiliary functions
   void rehash();  // ensure d_hash is coherent with d_pool and d_mod
@@ -110,6 +127,8 @@ class HashTable
       std::swap(d_mod,other.d_mod);
       d_hash.swap(other.d_hash);
       d_pool.swap(other.d_pool);
+      std::swap(d_lookups,other.d_lookups);
+      std::swap(d_grows,other.d_grows);
 
     }
 
@@ -16,6 +16,7 @@ template <class Entry, typename Number>
 HashTable<Entry,Number>::HashTable(typename Entry::Pooltype& pool,
 				   unsigned int n)
     : d_mod(1UL<<n),d_hash(), d_pool(pool) // caller supplies pool reference
+    , d_lookups(0), d_grows(0)
     {
       reconstruct();
     }
@@ -29,7 +30,7 @@ template <class Entry, typename Number>
       // now rehash all old entries
       for (size_t i=0; i<d_pool.size(); ++i)
 	{
-	  size_t h=Entry(d_pool[i]).hashCode(d_mod);
+	  size_t h=stored_hash<Entry>(d_pool[i],d_mod,0);
 
 	  while (d_hash[h]!=empty)
 	    if (++h==d_mod) h=0; // find empty slot
@@ -69,6 +70,7 @@ template <class Entry, typename Number>
   Number HashTable<Entry,Number>::match (const Entry& x)
   { Number i;
     size_t h=x.hashCode(d_mod);
+    ++d_lookups;
 
     // the following loop terminates because empty slots are always present
     while ((i=d_hash[h])!=empty and x!=d_pool[i])
@@ -91,6 +93,7 @@ template <class Entry, typename Number>
     if (d_pool.size()>=max_fill()) // then we expand d_hash, and rehash
     {
       d_mod=d_mod<<1;  // keep it a power of 2
+      ++d_grows;
 
       rehash();
 
@@ -111,5 +114,6 @@ template <class Entry, typename Number>
     return d_hash[h];
   }
 
+
 } // |namespace hashtable|
 } // |namespace atlas|
@@ -15,6 +15,8 @@
 
 #include "polynomials_fwd.h"
 
+#include <cstdint>
+#include <initializer_list>
 #include <limits>
 #include <vector>
 #include <iostream>
@@ -178,16 +180,120 @@ template <typename C>
   Safe_Poly(Degree d, C c) : base(d,c) {}
 
   // unlike |operator+| etc., the following test for negative coefficients
-  void safeAdd(const Safe_Poly& p, Degree d, C c); // *this += c*q^d*p
-  void safeAdd(const Safe_Poly& p, Degree d = 0);  // *this += q^d*p
+  // argument |p| may be a |Safe_Poly|, or a |Packed_Poly| view of a stored one
+  template<typename P>
+    void safeAdd(const P& p, Degree d, C c); // *this += c*q^d*p
+  template<typename P>
+    void safeAdd(const P& p, Degree d = 0);  // *this += q^d*p
   void safeDivide(C c);  // *this = *this/c
   void safe_quotient_by_1_plus_q(Degree delta);  // *this = (*this + mq^d)/(q+1)
 
-  void safeSubtract(const Safe_Poly& p, Degree d, C c);
-  void safeSubtract(const Safe_Poly& p, Degree d = 0 );
+  template<typename P>
+    void safeSubtract(const P& p, Degree d, C c);
+  template<typename P>
+    void safeSubtract(const P& p, Degree d = 0 );
+
+  // variants that compute modulo |m| (coefficients being reduced modulo |m|)
+  // rather than testing for overflow; |m| should be odd, so 2 is invertible
+  template<typename P>
+    void modAdd(const P& p, Degree d, C c, C m); // *this += c*q^d*p mod m
+  template<typename P>
+    void modSubtract(const P& p, Degree d, C c, C m); // *this -= c*q^d*p mod m
+  void modDivide(C c, C m); // multiply by inverse of |c| modulo |m|
+  void mod_quotient_by_1_plus_q(Degree delta, C m);
 
 }; // |template <typename C> class Safe_Poly|
 
+/*
+  Compact storage for a large collection of polynomials with unsigned
+  coefficients, as needed for the KL polynomials of big blocks. Rather than
+  giving each polynomial its own |std::vector|, all coefficients are held in a
+  single byte arena, with a width of 1, 2, 4 or 8 bytes per coefficient chosen
+  for each polynomial as the smallest that holds its largest coefficient (most
+  KL coefficients fit in a byte). An index of 8 bytes per polynomial records
+  its offset into the arena and its width code; the number of coefficients is
+  deduced from the offset of the next polynomial (a sentinel follows the last).
+
+  Indexing the pool yields a |Packed_Poly|, a small view object offering those
+  accessors of |Polynomial| that are used on stored polynomials, and which
+  converts to |Safe_Poly| where an actual polynomial is needed. Like references
+  into a |std::vector|, such views are invalidated by |push_back|.
+*/
+template <typename C> class Packed_Poly
+{
+  const unsigned char* d_coef; // start of coefficients in arena
+  Degree d_size; // number of coefficients, 0 for the zero polynomial
+  unsigned char d_code; // coefficients occupy |1<<d_code| bytes each
+
+ public:
+  Packed_Poly(const unsigned char* coef, Degree size, unsigned char code)
+  : d_coef(coef), d_size(size), d_code(code) {}
+
+// accessors, as for |Polynomial|
+  C operator[] (Degree i) const; // get coefficient $X^i$
+  C coef (Degree i) const { return i>=d_size ? C(0) : (*this)[i]; }
+  Degree degree() const { return d_size-1; }
+  Degree size() const { return d_size; }
+  bool isZero() const { return d_size==0; }
+  bool degree_less_than (Degree d) const { return d_size<=d; }
+
+  operator Safe_Poly<C> () const; // unpack into an ordinary polynomial
+  std::ostream& print(std::ostream& strm, const char* x) const
+  { return Safe_Poly<C>(*this).print(strm,x); }
+
+  // call |f(src,size())|, where |src[i]| reads coefficient $X^i$ in its width
+  template<typename F> void apply(F& f) const;
+
+  // same value as |SafePolEntry<C>::hashCode|, but without unpacking
+  size_t hashCode(size_t modulus) const;
+
+}; // |template <typename C> class Packed_Poly|
+
+template <typename C> class Packed_Poly_pool
+{
+  std::vector<unsigned char> d_arena; // coefficients of all polynomials
+  std::vector<std::uint64_t> d_index; // |(offset<<2)+code|, then a sentinel
+
+ public:
+  using value_type = Safe_Poly<C>;
+  using const_reference = Packed_Poly<C>;
+
+  class const_iterator
+  {
+    const Packed_Poly_pool* pool; size_t i;
+  public:
+    const_iterator(const Packed_Poly_pool* pool, size_t i) : pool(pool), i(i) {}
+    const_reference operator* () const { return (*pool)[i]; }
+    const_iterator& operator++ () { ++i; return *this; }
+    bool operator== (const const_iterator& other) const { return i==other.i; }
+    bool operator!= (const const_iterator& other) const { return i!=other.i; }
+  }; // |class const_iterator|
+
+// constructors
+  Packed_Poly_pool() : d_arena(), d_index(1,0) {} // empty pool, just sentinel
+  Packed_Poly_pool(std::initializer_list<Polynomial<C> > polys);
+
+// accessors
+  size_t size() const { return d_index.size()-1; }
+  const_reference operator[] (size_t i) const
+  { const auto start = d_index[i]>>2; const unsigned char code = d_index[i]&3;
+    return const_reference
+      (d_arena.data()+start, Degree(((d_index[i+1]>>2)-start)>>code), code);
+  }
+  const_iterator begin() const { return const_iterator(this,0); }
+  const_iterator end() const { return const_iterator(this,size()); }
+
+  // bytes currently allocated by the pool, for statistics
+  size_t memory() const
+  { return d_arena.capacity()+d_index.capacity()*sizeof(std::uint64_t); }
+
+// manipulators
+  void push_back(const Polynomial<C>& p); // pack |p| and add it at the end
+  void swap(Packed_Poly_pool& other)
+  { d_arena.swap(other.d_arena); d_index.swap(other.d_index); }
+
+}; // |template <typename C> class Packed_Poly_pool|
+
 template <typename C> class PolEntry : public Polynomial<C>
 {
   using Pol = Polynomial<C>;
@@ -227,16 +333,17 @@ public:
   // constructors
   SafePolEntry() : SafePol() {} // default constructor builds zero polynomial
   SafePolEntry(const SafePol& p) : SafePol(p) {} // lift polynomial to this class
+  SafePolEntry(const Packed_Poly<U>& p) : SafePol(p) {} // unpack stored one
 
   // members required for an Entry parameter to the HashTable template
-  using Pooltype = std::vector<SafePol>;  // associated storage type
+  using Pooltype = Packed_Poly_pool<U>;  // associated (compact) storage type
   size_t hashCode(size_t modulus) const // hash function
   { const SafePol& P=*this;
     if (P.isZero()) return 0;
     Degree i=P.degree();
     size_t h=P[i]; // start with leading coefficient, converted to unsigned
     while (i-->0) h= (h<<21)+(h<<13)+(h<<8)+(h<<5)+h+P[i];
-    return h & (modulus-1);
+    return h & (modulus-1); // |Packed_Poly<U>::hashCode| must agree with this
   }
 
   // compare polynomial with one from storage
@@ -28,6 +28,7 @@
 
 #include <limits>
 #include <cassert>
+#include <cstring> // |std::memcpy|
 #include <sstream>
 #include <algorithm> // |std::fill| and |std::copy|
 #include <stdexcept>
@@ -382,76 +383,154 @@ template<typename C> void safe_divide(C& a, C b)
 }
 
 
+/*
+  Kernels for the |safeAdd| and |safeSubtract| methods below, for unsigned
+  coefficient types |C|. Rather than testing each operation for overflow and
+  throwing at once, as the functions above do, they accumulate a flag for the
+  whole call, leaving the loops without branches or divisions, so that the
+  compiler can vectorise them. Multiplication by |c| overflows exactly if some
+  coefficient exceeds |max/c|, which is tested once, for the largest of them.
+
+  The functor classes are called with an object |src| that can be subscripted
+  to read the coefficients of the polynomial added, which is either a pointer,
+  or for a |Packed_Poly| a reader of coefficients of the width used there. The
+  source must not overlap |dst|; the callers take care of the case of aliasing.
+*/
+
+template<typename C> struct Shifted_add // add |c| times |src| to |dst|
+{ C* dst; C c; bool overflow;
+  Shifted_add(C* dst, C c) : dst(dst), c(c), overflow(false) {}
+
+  template<typename Src> void operator() (Src src, size_t n)
+  {
+    C flags = 0;
+    if (c==C(1))
+      for (size_t j=0; j<n; ++j)
+      { const C a = src[j], s = dst[j]+a;
+	flags |= C(s<a); // carry out
+	dst[j] = s;
+      }
+    else
+    {
+      C max = 0; // largest coefficient of |src|
+      for (size_t j=0; j<n; ++j)
+      { const C b = src[j], a = b*c, s = dst[j]+a;
+	max = b>max ? b : max;
+	flags |= C(s<a);
+	dst[j] = s;
+      }
+      flags |= C(max>std::numeric_limits<C>::max()/c);
+    }
+    overflow = flags!=0;
+  }
+}; // |Shifted_add|
+
+// subtract |c| times |src| from |dst|; only the multiplication can overflow
+template<typename C> struct Shifted_subtract
+{ C* dst; C c; bool overflow;
+  Shifted_subtract(C* dst, C c) : dst(dst), c(c), overflow(false) {}
+
+  template<typename Src> void operator() (Src src, size_t n)
+  {
+    C max = 0; // largest coefficient of |src|
+#ifndef NDEBUG
+    C borrow = 0; // what |safe_subtract| asserts against, accumulated
+#endif
+    for (size_t j=0; j<n; ++j)
+    { const C b = src[j], a = b*c;
+      max = b>max ? b : max;
+#ifndef NDEBUG
+      borrow |= C(dst[j]<a);
+#endif
+      dst[j] -= a;
+    }
+    overflow = max>std::numeric_limits<C>::max()/c;
+    assert(borrow==0 or overflow); // after overflow, |dst| is garbage anyway
+  }
+}; // |Shifted_subtract|
+
+// apply a kernel to the coefficients of an ordinary polynomial
+template<typename C, typename F>
+  void apply_to_coefficients(const Polynomial<C>& q, F& f)
+{ f(&q[0],q.size()); }
+
+// apply a kernel to the coefficients of a packed polynomial
+template<typename C, typename F>
+  void apply_to_coefficients(const Packed_Poly<C>& q, F& f)
+{ q.apply(f); }
+
 
 /*
   Add $x^d.c.q$, to |*this|, watching for overflow, assuming |c>0|.
 
-  We need to be careful in the case where |q| aliasses |*this|, but we can
-  avoid making a copy, by doing the addition top-to-bottom.
+  The kernel used requires that |q| does not overlap |*this|, so in the rare
+  case that |q| aliasses |*this| we operate with a copy of |q| instead.
 */
-template<typename C>
-void Safe_Poly<C>::safeAdd(const Safe_Poly& q, Degree d, C c)
+template<typename C> template<typename P>
+void Safe_Poly<C>::safeAdd(const P& q, Degree d, C c)
 {
   if (q.isZero() or c==C(0))
     return; // do nothing
+  if (static_cast<const void*>(&q)==this)
+    return safeAdd(Safe_Poly(q),d,c); // operate with a copy
 
-  const auto qs = q.size();   // save the original size of q, it might change
+  const auto qs = q.size();
 
   // ensure sufficient room for result
   if (qs+d > base::size())
     base::resize(qs+d);
 
   auto* shift_base = &(*this)[d]; // pointer to lowest coefficient affected
-  for (size_t j = qs; j-->0;) // loop must be backwards if |&q == this|
-  {
-    C a = q[j]; // need a copy for the multiplication
-    polynomials::safe_multiply(a,c);        // this may throw
-    polynomials::safe_add(shift_base[j],a); // this may throw
-  }
+  Shifted_add<C> kernel(shift_base,c);
+  apply_to_coefficients(q,kernel);
+  if (kernel.overflow)
+    throw error::NumericOverflow();
 } // |safeAdd|
 
 /* A simplified version avoiding multiplication in the common case |c==1| */
 
-template<typename C>
-void Safe_Poly<C>::safeAdd(const Safe_Poly& q, Degree d)
+template<typename C> template<typename P>
+void Safe_Poly<C>::safeAdd(const P& q, Degree d)
 {
   if (q.isZero()) // do nothing
     return;
+  if (static_cast<const void*>(&q)==this)
+    return safeAdd(Safe_Poly(q),d); // operate with a copy
 
-  const auto qs = q.size();   // save the original size of q, it might change
+  const auto qs = q.size();
 
   // find degree
   if (qs+d > base::size())
     base::resize(qs+d);
 
   auto* shift_base = &(*this)[d]; // pointer to lowest coefficient affected
-  for (size_t j = qs; j-->0; ) // loop must be backwards if |&q == this|
-    polynomials::safe_add(shift_base[j],q[j]); // this may throw
+  Shifted_add<C> kernel(shift_base,C(1));
+  apply_to_coefficients(q,kernel);
+  if (kernel.overflow)
+    throw error::NumericOverflow();
 } // |safeAdd|
 
 /*
   Subtract $x^d.c.q$ from |*this|, asserting no underflow, assuming |c>0|
 
-  We need to be careful in the case where |q| aliasses |*this|, but we can
-  avoid making a copy, by doing the addition top-to-bottom.
+  The kernel used requires that |q| does not overlap |*this|, so in the rare
+  case that |q| aliasses |*this| we operate with a copy of |q| instead.
 */
-template<typename C>
-void Safe_Poly<C>::safeSubtract(const Safe_Poly& q, Degree d, C c)
+template<typename C> template<typename P>
+void Safe_Poly<C>::safeSubtract(const P& q, Degree d, C c)
 {
   if (q.isZero() or c==C(0))
     return; // do nothing
+  if (static_cast<const void*>(&q)==this)
+    return safeSubtract(Safe_Poly(q),d,c); // operate with a copy
 
-  const auto qs = q.size();   // save the original size of q, it might change
-
-  assert(qs+d<=base::size()); // if not, leading coefficient would get negative
+  assert(q.size()+d<=base::size()); // else leading coefficient would be negative
 
   auto* shift_base = &(*this)[d]; // pointer to lowest coefficient affected
-  for (size_t j = qs; j-->0; ) // loop must be backwards if |&q == this|
-  {
-    C a = q[j]; // need a copy for the multiplication
-    polynomials::safe_multiply(a,c);        // this may throw
-    polynomials::safe_subtract(shift_base[j],a);
-  }
+  Shifted_subtract<C> kernel(shift_base,c);
+  apply_to_coefficients(q,kernel);
+  if (kernel.overflow)
+    throw error::NumericOverflow();
 
   // set degree
   base::adjustSize();
@@ -459,25 +538,27 @@ void Safe_Poly<C>::safeSubtract(const Safe_Poly& q, Degree d, C c)
 
 /* Again a simplified version deals with the common case |c==1| */
 
-template<typename C>
-void Safe_Poly<C>::safeSubtract(const Safe_Poly& q, Degree d)
+template<typename C> template<typename P>
+void Safe_Poly<C>::safeSubtract(const P& q, Degree d)
 {
   if (q.isZero()) // do nothing
     return;
+  if (static_cast<const void*>(&q)==this)
+    return safeSubtract(Safe_Poly(q),d); // operate with a copy
 
-  const auto qs = q.size();   // save the original size of q, it might change
-
-  assert(qs+d<=base::size()); // if not, leading coefficient would get negative
+  assert(q.size()+d<=base::size()); // else leading coefficient would be negative
 
   auto* shift_base = &(*this)[d]; // pointer to lowest coefficient affected
-  for (size_t j = qs; j-->0;)
-    polynomials::safe_subtract(shift_base[j],q[j]);
+  Shifted_subtract<C> kernel(shift_base,C(1)); // cannot overflow
+  apply_to_coefficients(q,kernel);
 
   // set degree
   base::adjustSize();
  } // |safeSubtract|
 
-// Divide polynomial by scalar |c|, throwing an error is division is inexact
+/*
+  Divide polynomial by scalar |c|, asserting that division is exact.
+*/
 template<typename C>
 void Safe_Poly<C>::safeDivide(C c)
 {
@@ -527,6 +608,191 @@ void Safe_Poly<C>::safe_quotient_by_1_plus_q(Degree delta)
 } // |safe_quotient_by_1_plus_q|
 
 
+/*
+  The modular variants. Here no overflow can occur, but the degree of the
+  result cannot be predicted from those of the operands, since coefficients
+  may become $0$ modulo |m|; so we resize as needed and call |adjustSize|.
+  Intermediate values are formed in |std::uint64_t|, so that any modulus |m|
+  representable in |C| can be used, even one beyond $2^{31}$. The
+  coefficients are traversed downwards, so that if |q| aliases |*this| each of
+  its coefficients is read before it can have been overwritten.
+*/
+template<typename C> template<typename P>
+void Safe_Poly<C>::modAdd(const P& q, Degree d, C c, C m)
+{
+  if (q.isZero() or c%m==C(0))
+    return; // do nothing
+  const auto qs = q.size();
+  if (qs+d > base::size())
+    base::resize(qs+d);
+  for (size_t j=qs; j-->0; ) // downwards, in case |q| aliases |*this|
+    (*this)[j+d] = ((*this)[j+d]+std::uint64_t(q[j])*c)%m;
+  base::adjustSize(); // leading coefficient might have become $0$
+} // |modAdd|
+
+template<typename C> template<typename P>
+void Safe_Poly<C>::modSubtract(const P& q, Degree d, C c, C m)
+{
+  if (q.isZero() or c%m==C(0))
+    return; // do nothing
+  const auto qs = q.size();
+  if (qs+d > base::size()) // |*this| can be of lower degree than |q| here
+    base::resize(qs+d);
+  for (size_t j=qs; j-->0; ) // downwards, in case |q| aliases |*this|
+    (*this)[j+d] = (std::uint64_t((*this)[j+d])+m-std::uint64_t(q[j])*c%m)%m;
+  base::adjustSize();
+} // |modSubtract|
+
+// Multiply by the inverse of |c| modulo |m|, which must exist
+template<typename C>
+void Safe_Poly<C>::modDivide(C c, C m)
+{
+  std::int64_t a=c%m, b=m, u=1, v=0; // invariant |a==u*c| modulo |m|
+  while (b!=0) // extended Euclidean algorithm
+  {
+    std::int64_t q=a/b, t=a-q*b; a=b; b=t;
+    t=u-q*v; u=v; v=t;
+  }
+  if (a!=1)
+    throw std::runtime_error("Division by non-invertible modular coefficient");
+  const std::uint64_t inv = u<0 ? u+m : u;
+  for (C& cur_coef : *this)
+    cur_coef = cur_coef*inv%m;
+  base::adjustSize(); // not really needed, as |inv| is invertible modulo |m|
+} // |modDivide|
+
+/*
+  Modular version of |safe_quotient_by_1_plus_q|. Reduction modulo |m| may make
+  the degree of |*this| smaller than that of the exact polynomial it stands for,
+  so we cannot tell as above whether the imagined leading term is present; nor
+  can we check that the division is exact. We just do the upward division by
+  $q+1$ through degree $d=(delta-1)/2$, the maximal degree of the quotient,
+  adding zero coefficients as needed. Terms of degree beyond $d$ are ignored;
+  when the exact polynomial satisfies the precondition of the exact version,
+  there are none, and so there are none after reduction either.
+*/
+template<typename C>
+void Safe_Poly<C>::mod_quotient_by_1_plus_q(Degree delta, C m)
+{
+  if (base::isZero())
+    return; // quotient is $0$; no unknown leading term can be recovered
+  const Degree d = (delta-1)/2; // quotient has degree at most $d$
+  if (base::size()<d+1)
+    base::resize(d+1);
+  for (size_t j = 1; j <= d; ++j)
+    (*this)[j] = (std::uint64_t((*this)[j])+m-(*this)[j-1])%m;
+  base::resize(d+1); // drop any remainder terms above degree $d$
+  base::adjustSize();
+} // |mod_quotient_by_1_plus_q|
+
+/*****************************************************************************
+
+        Chapter III -- Compact polynomial storage
+
+ *****************************************************************************/
+
+// Coefficients are stored with |memcpy| to avoid any alignment requirements
+
+template<typename C>
+C Packed_Poly<C>::operator[] (Degree i) const
+{
+  assert(i<d_size);
+  switch (d_code)
+  {
+  case 0: return d_coef[i];
+  case 1: { std::uint16_t c; std::memcpy(&c,d_coef+2*i,2); return c; }
+  case 2: { std::uint32_t c; std::memcpy(&c,d_coef+4*i,4); return c; }
+  default: { std::uint64_t c; std::memcpy(&c,d_coef+8*i,8); return c; }
+  }
+}
+
+// read coefficients of type |T| from possibly unaligned memory
+template<typename T> struct Unaligned_reader
+{ const unsigned char* base;
+  Unaligned_reader(const unsigned char* base) : base(base) {}
+  T operator[] (size_t i) const
+  { T c; std::memcpy(&c,base+sizeof(T)*i,sizeof(T)); return c; }
+};
+
+template<typename C> template<typename F>
+void Packed_Poly<C>::apply(F& f) const
+{
+  switch (d_code) // select the width once, rather than for every coefficient
+  {
+  case 0: f(d_coef,d_size); break;
+  case 1: f(Unaligned_reader<std::uint16_t>(d_coef),d_size); break;
+  case 2: f(Unaligned_reader<std::uint32_t>(d_coef),d_size); break;
+  default: f(Unaligned_reader<std::uint64_t>(d_coef),d_size);
+  }
+}
+
+// compute the hash value of |SafePolEntry|, reading coefficients in place
+struct Poly_hasher
+{ size_t h;
+  Poly_hasher() : h(0) {}
+  template<typename Src> void operator() (Src src, size_t n)
+  { if (n==0) return;
+    h=src[--n]; // start with leading coefficient
+    while (n-->0) h= (h<<21)+(h<<13)+(h<<8)+(h<<5)+h+src[n];
+  }
+};
+
+template<typename C>
+size_t Packed_Poly<C>::hashCode(size_t modulus) const
+{ Poly_hasher f; apply(f); return f.h & (modulus-1); }
+
+template<typename C>
+Packed_Poly<C>::operator Safe_Poly<C> () const
+{
+  if (isZero())
+    return Safe_Poly<C>();
+  Safe_Poly<C> result(degree(),(*this)[degree()]); // sets leading term
+  for (Degree i=0; i<degree(); ++i)
+    result[i] = (*this)[i];
+  return result;
+}
+
+template<typename C>
+Packed_Poly_pool<C>::Packed_Poly_pool
+  (std::initializer_list<Polynomial<C> > polys)
+: Packed_Poly_pool()
+{
+  for (const auto& p : polys)
+    push_back(p);
+}
+
+/*
+  Add |p| at the end of the pool, using the narrowest coefficient width that
+  can hold all of its coefficients. The sentinel at the end of |d_index| holds
+  the current arena size, which is where the coefficients of |p| will start;
+  it becomes the index entry of |p| once its width code is added.
+*/
+template<typename C>
+void Packed_Poly_pool<C>::push_back(const Polynomial<C>& p)
+{
+  std::uint64_t max=0;
+  for (C c : p)
+    if (c>max)
+      max=c;
+  const unsigned char code = max>>8==0 ? 0 : max>>16==0 ? 1 : max>>32==0 ? 2 : 3;
+
+  const size_t start = d_arena.size();
+  d_arena.resize(start+(size_t(p.size())<<code));
+  unsigned char* dst = d_arena.data()+start;
+  for (C c : p)
+    switch (code)
+    {
+    case 0: *dst++ = c; break;
+    case 1: { std::uint16_t v=c; std::memcpy(dst,&v,2); dst+=2; } break;
+    case 2: { std::uint32_t v=c; std::memcpy(dst,&v,4); dst+=4; } break;
+    default: { std::uint64_t v=c; std::memcpy(dst,&v,8); dst+=8; }
+    }
+
+  d_index.back() |= code; // sentinel becomes index entry for |p|
+  d_index.push_back(std::uint64_t(d_arena.size())<<2); // and a new sentinel
+}
+
+
 } // |namespace polynomials|
 
 } // |namespace atlas|
@@ -18,6 +18,8 @@ template<typename C> class Polynomial; // |C| can be any arithmetic type
 template<typename u> class Safe_Poly;  // here |C| must be unsigned integral
 template<typename C> class PolEntry;
 template<typename U> class SafePolEntry;
+template<typename C> class Packed_Poly;      // read-only view into pool
+template<typename C> class Packed_Poly_pool; // compact polynomial storage
 
 // template<typename C> class LaurentPolynomial;
 
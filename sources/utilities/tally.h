@@ -48,14 +48,15 @@ class TallyVec
 
   static const Count maxCount; // limit of |Count| type
 
-  std::vector<Count> count; // primary histogram
-  map_type overflow; // for multiplicities >=256
+  std::vector<Count> count; // primary histogram, grown on demand up to |limit|
+  map_type overflow; // for multiplicities >=256, and for indices >=|limit|
+  size_t limit;      // indices below this are counted in |count|
   Index max;         // maximal index seen
   ullong total;      // grans total
 
  public:
-  TallyVec(size_t limit) : count(0), overflow(), max(0), total(0)
-  { count.reserve(limit); }
+  TallyVec(size_t limit) : count(0), overflow(), limit(limit), max(0), total(0)
+  {}
   TallyVec (std::istream& file); // recover table dumped to file
 
   // same specifying width of keys and values in overflow table explicitly
@@ -63,6 +64,7 @@ class TallyVec
 
   bool tally (Index i); // increase count for i by 1; tell whether new
   bool tally (Index i,ullong multiplicity); // same with multiplicity
+  void merge (const TallyVec& other); // add tallies of |other|, same |limit|
   Index size() const { return max+1; } // size of collection now tallied
   inline ullong multiplicity (Index i) const;
   ullong sum() const { return total; }
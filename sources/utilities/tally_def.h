@@ -35,14 +35,14 @@ template <typename Count>
       return false;
     }
     if (i>max) max=i; // only need to check this if |i>=count.size()|
-    if (i<count.capacity()) // then slot for |i| can be created
+    if (i<limit) // then slot for |i| can be created
     {
       while (count.size()<i) count.push_back(0); // clear new counters skipped
       count.push_back(1); // install first tally for this counter
       return true;
     }
 
-    // now |i>=count.capacity()|, it must be added to overflow
+    // now |i>=limit|, it must be added to overflow
     std::pair<map_type::iterator,bool> p =overflow.insert(std::make_pair(i,1));
     if (not p.second) ++p.first->second; // if already recorded, increase tally
     return p.second;
@@ -70,7 +70,7 @@ template <typename Count>
       return false;
     }
     if (i>max) max=i;
-    if (i<count.capacity()) // then slot for |i| can be created
+    if (i<limit) // then slot for |i| can be created
     {
       while (count.size()<i) count.push_back(0);
       if (multiplicity>=maxCount) // then |count[i]| saturated
@@ -82,7 +82,7 @@ template <typename Count>
       return true;
     }
 
-    // now |i>=count.capacity()|, it must be added to overflow
+    // now |i>=limit|, it must be added to overflow
     std::pair<map_type::iterator,bool> p
       =overflow.insert(std::make_pair(i,multiplicity));
     if (not p.second) // then it was already recorded
@@ -90,6 +90,27 @@ template <typename Count>
     return p.second; // return whether |i| was previously unrecorded
   }
 
+/*
+  Merging adds all tallies of |other| to ours. The result is the same as if
+  all calls of |tally| for |other| had been made for |*this| instead, provided
+  both were constructed with the same |limit|. This includes the slots that
+  were created by tallying with multiplicity 0, so all indices present in
+  |other| are tallied, even those with zero multiplicity.
+*/
+template <typename Count>
+  void TallyVec<Count>::merge(const TallyVec& other)
+  {
+    for (Index i=0; i<other.count.size(); ++i)
+      if (other.count[i]!=0)
+	tally(i,other.multiplicity(i));
+    if (not other.count.empty())
+      tally(other.count.size()-1,0); // ensure |count| is at least as long
+
+    for (map_type::const_iterator it=other.overflow.lower_bound
+	   (other.count.size()); it!=other.overflow.end(); ++it)
+      tally(it->first,it->second); // those not in |other.count|
+  }
+
 template <typename Count>
   void TallyVec<Count>::advance(Index& i) const
   {
@@ -142,10 +163,10 @@ template <typename Count>
 
 template <typename Count>
   TallyVec<Count>::TallyVec (std::istream& file)
-  : count(0), overflow(), max(0), total(0)
+  : count(0), overflow(), limit(0), max(0), total(0)
   {
     file.seekg(0,std::ios_base::beg);
-    count.resize(basic_io::read_bytes<4>(file));
+    count.resize(limit=basic_io::read_bytes<4>(file));
     if (not count.empty()) max=count.size()-1;
     size_t ovf_size=basic_io::read_bytes<4>(file);
     for (size_t i=0; i<count.size(); ++i)
@@ -161,10 +182,10 @@ template <typename Count>
 
 template <typename Count>
   TallyVec<Count>::TallyVec (std::istream& file, size_t w_key, size_t w_val)
-  : count(0), overflow(), max(0), total(0)
+  : count(0), overflow(), limit(0), max(0), total(0)
   {
     file.seekg(0,std::ios_base::beg);
-    count.resize(basic_io::read_bytes<4>(file));
+    count.resize(limit=basic_io::read_bytes<4>(file));
     if (not count.empty()) max=count.size()-1;
     size_t ovf_size=basic_io::read_bytes<4>(file);
     for (size_t i=0; i<count.size(); ++i)